@@ -0,0 +1,170 @@
+/**
+* @file async_writer.h
+*
+* @brief A background writer of particle states, fed by a lock-free single
+* producer, single consumer ring of preallocated frames
+*
+* @author Pavlo Vlastos
+*/
+
+#ifndef ASYNC_WRITER_H
+#define ASYNC_WRITER_H
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "tensor.h"
+#include "particle_system.h"
+#include "trajectory.h"
+#include "dat_emitter.h"
+#include <atomic>
+#include <functional>
+#include <thread>
+
+/******************************************************************************
+ * DEFINES
+ *****************************************************************************/
+#define ASYNC_WRITER_FRAMES 64  /* Default ring size, rounded up to 2^k */
+#define ASYNC_WRITER_IDLE_US 50 /* Writer's sleep while the ring is empty */
+#define ASYNC_WRITER_SPINS 64   /* Yields before the writer sleeps */
+
+/******************************************************************************
+ * GLOBAL VARIABLES AND DATATYPES
+ *****************************************************************************/
+/* What push() does when the ring is full, or filling up */
+enum class backpressure
+{
+    BLOCK = 0, /* Wait for a free frame: nothing is lost */
+    DROP,      /* Drop the new frame */
+    DECIMATE   /* Keep fewer frames the fuller the ring, drop if full */
+};
+
+/* The states of every particle at one time, column by column */
+struct state_frame
+{
+    double t;
+    unsigned int count;                /* Particles in the frame */
+    const double *columns[STATE_SIZE]; /* Each component [count] */
+};
+
+/**
+ * @brief A destination of frames, called on the writer thread in frame
+ * order. A failure is remembered and reported by stop().
+ */
+typedef function<tensor_status(const state_frame &frame)> frame_sink;
+
+/******************************************************************************
+ * CLASS DEFINITION AND FUNCTION DECLARATIONS
+ *****************************************************************************/
+/**
+ * @brief Moves the formatting and I/O of recorded states off the stepping
+ * thread. push() copies a system's state arrays into the next free frame of
+ * a ring and returns; a writer thread hands the frames to the sinks in
+ * order. The ring's frames are allocated up front, and the two threads only
+ * share two atomic indices, so pushing costs a memcpy per state component.
+ *
+ * One thread pushes, and stop() (or the destructor) returns only once every
+ * accepted frame has reached the sinks.
+ */
+class async_writer
+{
+private:
+    unsigned int particles;
+    backpressure policy;
+    size_t mask; /* Frames in the ring - 1 */
+
+    vector<aligned_buffer> frames; /* [STATE_SIZE * particles] each */
+    vector<double> times;
+    vector<frame_sink> sinks;
+
+    /* head is the next frame to fill, tail the next to write; each on its
+     * own cache line, so the threads do not contend over one line */
+    alignas(TENSOR_ALIGNMENT) atomic<size_t> head{0};
+    alignas(TENSOR_ALIGNMENT) atomic<size_t> tail{0};
+    alignas(TENSOR_ALIGNMENT) atomic<bool> stopping{false};
+    atomic<bool> failed{false};
+
+    thread writer;
+    bool running = false;
+
+    /* Counters of the pushing thread */
+    unsigned long pushed = 0;
+    unsigned long dropped = 0;
+    unsigned long decimated = 0;
+
+    /* The writer thread: drain the ring until stopped and empty */
+    void drain(void);
+
+public:
+    /**
+     * @brief Async writer class constructor
+     * @param particles_in The particles in each frame
+     * @param frames_in The frames of the ring, rounded up to a power of two
+     * @param policy_in What push() does when the ring is full
+     */
+    async_writer(unsigned int particles_in,
+                 unsigned int frames_in = ASYNC_WRITER_FRAMES,
+                 backpressure policy_in = backpressure::BLOCK);
+
+    /* Async writer class destructor, flushing every frame pushed */
+    ~async_writer(void);
+
+    async_writer(const async_writer &) = delete;
+    async_writer &operator=(const async_writer &) = delete;
+
+    /**
+     * @brief Add a sink, before start()
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status add_sink(frame_sink sink);
+
+    /**
+     * @brief Start the writer thread
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status start(void);
+
+    /**
+     * @brief Queue the states of a system's particles at time t. Only ever
+     * call this from one thread.
+     * @return tensor_status SUCCESS, also when the policy let the frame go,
+     * or FAILURE
+     */
+    tensor_status push(double t, const particle_system &system);
+
+    /**
+     * @brief Write out every queued frame and stop the writer thread
+     * @return tensor_status SUCCESS, or FAILURE if a sink failed
+     */
+    tensor_status stop(void);
+
+    /**************************************************************************
+     * Getters
+    **************************************************************************/
+    inline unsigned long get_pushed(void) const { return pushed; }
+    inline unsigned long get_dropped(void) const { return dropped; }
+    inline unsigned long get_decimated(void) const { return decimated; }
+
+    /**
+     * @brief The frames the sinks have been handed so far
+     */
+    inline unsigned long get_written(void) const
+    {
+        return tail.load(memory_order_acquire);
+    }
+};
+
+/**
+ * @brief A sink recording every frame to a trajectory file
+ * @param writer An open trajectory writer, closed by its owner after stop()
+ */
+frame_sink binary_sink(shared_ptr<trajectory_writer> writer);
+
+/**
+ * @brief A sink writing the positions of every frame in the .dat dots layout
+ * of simulation/gnuplot_dot
+ * @param dat An open emitter, closed by its owner after stop()
+ */
+frame_sink gnuplot_sink(shared_ptr<dat_emitter> dat);
+
+#endif /* ASYNC_WRITER_H */
@@ -0,0 +1,165 @@
+/**
+* @file barnes_hut.h
+*
+* @brief Mutual gravity between particles in O(N log N) by a Barnes-Hut octree
+* over Morton (Z-order) sorted positions
+*
+* @author Pavlo Vlastos
+*/
+
+#ifndef BARNES_HUT_H
+#define BARNES_HUT_H
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "tensor.h"
+#include "particle_system.h"
+#include "thread_pool.h"
+#include "constants.h"
+#include <stdint.h>
+
+/******************************************************************************
+ * DEFINES
+ *****************************************************************************/
+#define MORTON_BITS 21 /* Bits per axis, 3 * 21 = 63 bit codes */
+
+#define BARNES_HUT_DEFAULT_THETA 0.5
+#define BARNES_HUT_LEAF_SIZE 8 /* Most bodies summed directly in a leaf */
+#define BARNES_HUT_GRAIN 512   /* Bodies per stolen chunk of the force pass */
+
+/* When re-sorting the previous step's order moves bodies further than this
+ * many times the body count in total, the order is sorted from scratch */
+#define BARNES_HUT_RESORT_LIMIT 8
+
+/******************************************************************************
+ * CLASS DEFINITION AND FUNCTION DECLARATIONS
+ *****************************************************************************/
+/**
+ * @brief Gravity between N bodies by the Barnes-Hut approximation: a node of
+ * the octree whose size s is small against its distance d from a body
+ * (s / d < theta) acts on it as a point mass at its center of mass; nodes
+ * seen wider than that are opened. theta = 0 is the exact pairwise sum.
+ *
+ * Each call rebuilds the tree from the current positions. The bodies are
+ * kept in Morton order between calls, so when they have moved little the
+ * re-sort is nearly linear, and the tree and scratch storage are reused.
+ * Forces are computed per body in Morton order, independently of one
+ * another, so the result is the same for any number of threads.
+ */
+class barnes_hut
+{
+private:
+    /* A cube of the tree over the sorted bodies [begin, end) */
+    struct node
+    {
+        double x, y, z; /* Center of mass */
+        double mass;
+        double size; /* Edge length of the cube */
+        unsigned int begin;
+        unsigned int end;
+        unsigned int first_child; /* Children are consecutive nodes */
+        unsigned int children;    /* Zero for a leaf */
+    };
+
+    double theta = BARNES_HUT_DEFAULT_THETA;
+    double softening = 0.0; /* Plummer softening length, in meters */
+    double g = GRAVITATIONAL_CONSTANT;
+
+    vector<unsigned int> order;    /* Bodies in Morton order */
+    vector<uint64_t> codes;        /* Morton codes, in that order */
+    aligned_buffer sx, sy, sz, sm; /* Positions and masses in that order */
+    vector<node> nodes;            /* nodes[0] is the root */
+    double root_size = 0.0;        /* Edge length of the root cube */
+
+    /* Scratch of a sort from scratch, (code, body) */
+    vector<pair<uint64_t, unsigned int>> keys;
+
+    unsigned long last_resort_moves = 0;
+
+    /* Sort order by the codes of the current positions, starting from the
+     * previous order */
+    void sort_bodies(const double *x, const double *y, const double *z,
+                     unsigned int n);
+
+    /* Copy the positions and masses into Morton order */
+    void gather_bodies(const double *x, const double *y, const double *z,
+                       const double *m, unsigned int n);
+
+    /* Build the subtree of node i, a cube at depth level */
+    void build(unsigned int i, unsigned int level);
+
+    /* The acceleration on the sorted body b */
+    void accelerate(unsigned int b, double &ax, double &ay,
+                    double &az) const;
+
+public:
+    /* Barnes-Hut class constructor */
+    barnes_hut(void) {}
+
+    /**
+     * @brief The gravitational forces between n bodies
+     * @param x The x-coordinates [n], in meters
+     * @param y The y-coordinates [n], in meters
+     * @param z The z-coordinates [n], in meters
+     * @param m The masses [n], in kg
+     * @param n The number of bodies
+     * @param fx The x-components of the force on each body [n], in N
+     * @param fy The y-components of the force on each body [n], in N
+     * @param fz The z-components of the force on each body [n], in N
+     * @param pool Threads for the force pass, or nullptr to run serially
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status compute(const double *x, const double *y, const double *z,
+                          const double *m, unsigned int n, double *fx,
+                          double *fy, double *fz, thread_pool *pool = nullptr);
+
+    /**
+     * @brief Write the mutual gravity of a system's particles into their
+     * normal-force inputs (overwriting them; the tangent forces are left
+     * alone), ready for particle_system::update()
+     * @param system The particles
+     * @param pool Threads for the force pass, or nullptr to run serially
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status compute(particle_system &system,
+                          thread_pool *pool = nullptr);
+
+    /**************************************************************************
+     * Setters
+    **************************************************************************/
+    /**
+     * @brief Set the opening angle, 0 for the exact sum; about 0.5 is usual
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status set_theta(double theta_new);
+
+    /**
+     * @brief Set the softening length, which bounds the force between close
+     * bodies to that of masses a softening length apart
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status set_softening(double softening_new);
+
+    /**
+     * @brief Set the gravitational constant, e.g. 1 for model units
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status set_gravitational_constant(double g_new);
+
+    /**************************************************************************
+     * Getters
+    **************************************************************************/
+    inline unsigned int get_node_count(void) const { return nodes.size(); }
+
+    /**
+     * @brief How far the last re-sort moved bodies in total, a measure of
+     * how much the Morton order changed since the previous call
+     */
+    inline unsigned long get_resort_moves(void) const
+    {
+        return last_resort_moves;
+    }
+};
+
+#endif /* BARNES_HUT_H */
@@ -8,6 +8,7 @@
 #ifdef TESTING_TENSOR
 
 #define TEST_TENSOR_CLASS_CONSTRUCTOR
+#define TEST_TENSOR_STORAGE
 #define TEST_TENSOR_MULTIPLICATION
 #define TEST_TENSOR_ADD
 #define TEST_TENSOR_COPY
@@ -17,9 +18,13 @@
 #define TEST_TENSOR_AUGMENT_HEIGHT
 #define TEST_TENSOR_EYE
 #define TEST_TENSOR_INVERT
+#define TEST_TENSOR_EXPM
 #define TEST_TENSOR_NORM
 #define TEST_TENSOR_TO_GNUPLOT_DOT
 #define TEST_TENSOR_DCM
+#define TEST_TENSOR_FIXED
+#define TEST_TENSOR_GEMM
+#define TEST_TENSOR_IN_PLACE
 
 #endif
 
@@ -28,6 +33,168 @@
 
 #define TEST_PARTICLE_PRINT
 #define TEST_PARTICLE_UPDATE
+#define TEST_PARTICLE_DISCRETIZATION
+#define TEST_PARTICLE_QUATERNION
+#define TEST_PARTICLE_JUMP
+#define TEST_PARTICLE_ALLOCATIONS
+
+#endif
+
+// #define TESTING_PARTICLE_SYSTEM
+#ifdef TESTING_PARTICLE_SYSTEM
+
+#define TEST_PARTICLE_SYSTEM_UPDATE
+#define TEST_PARTICLE_SYSTEM_THROUGHPUT
+#define TEST_PARTICLE_SYSTEM_JUMP
+
+#endif
+
+// #define TESTING_THREAD_POOL
+#ifdef TESTING_THREAD_POOL
+
+#define TEST_THREAD_POOL_PARALLEL_FOR
+
+#endif
+
+// #define TESTING_PARALLEL_STEPPER
+#ifdef TESTING_PARALLEL_STEPPER
+
+#define TEST_PARALLEL_STEPPER_DETERMINISM
+#define TEST_PARALLEL_STEPPER_SCALING
+
+#endif
+
+// #define TESTING_SPARSE_TENSOR
+#ifdef TESTING_SPARSE_TENSOR
+
+#define TEST_SPARSE_TENSOR_CONVERSION
+#define TEST_SPARSE_TENSOR_MULTIPLY
+
+#endif
+
+// #define TESTING_FACTORIZATION
+#ifdef TESTING_FACTORIZATION
+
+#define TEST_LU_FACTORIZATION
+#define TEST_QR_FACTORIZATION
+#define TEST_CHOLESKY_FACTORIZATION
+
+#endif
+
+// #define TESTING_ROTATION
+#ifdef TESTING_ROTATION
+
+#define TEST_ROTATION_SINCOS
+#define TEST_ROTATION_DCM_BATCH
+#define TEST_ROTATION_POINTS
+
+#endif
+
+// #define TESTING_QUATERNION
+#ifdef TESTING_QUATERNION
+
+#define TEST_QUATERNION_ALGEBRA
+#define TEST_QUATERNION_CONVERSIONS
+#define TEST_QUATERNION_SLERP
+#define TEST_QUATERNION_BATCH
+
+#endif
+
+// #define TESTING_DYNAMICS_MODEL
+#ifdef TESTING_DYNAMICS_MODEL
+
+#define TEST_DYNAMICS_MODEL_INTERN
+#define TEST_DYNAMICS_MODEL_SHARING
+
+#endif
+
+// #define TESTING_INTEGRATOR
+#ifdef TESTING_INTEGRATOR
+
+#define TEST_INTEGRATOR_ACCURACY
+#define TEST_INTEGRATOR_DENSE_OUTPUT
+#define TEST_INTEGRATOR_PARTICLE
+
+#endif
+
+// #define TESTING_ORBIT
+#ifdef TESTING_ORBIT
+
+#define TEST_ORBIT_GRAVITY
+#define TEST_ORBIT_ENERGY
+
+#endif
+
+// #define TESTING_LAUNCH_SIM
+#ifdef TESTING_LAUNCH_SIM
+
+#define TEST_LAUNCH_SIM_PROTOTYPE
+#define TEST_LAUNCH_SIM_ORBIT
+
+#endif
+
+// #define TESTING_BARNES_HUT
+#ifdef TESTING_BARNES_HUT
+
+#define TEST_BARNES_HUT_ACCURACY
+#define TEST_BARNES_HUT_INCREMENTAL
+#define TEST_BARNES_HUT_PARALLEL
+
+#endif
+
+// #define TESTING_SPATIAL_HASH
+#ifdef TESTING_SPATIAL_HASH
+
+#define TEST_SPATIAL_HASH_CORRECTNESS
+#define TEST_SPATIAL_HASH_THROUGHPUT
+
+#endif
+
+// #define TESTING_FORCE_SCHEDULE
+#ifdef TESTING_FORCE_SCHEDULE
+
+#define TEST_FORCE_SCHEDULE_IMPULSE
+#define TEST_FORCE_SCHEDULE_RAMP
+
+#endif
+
+// #define TESTING_TRAJECTORY
+#ifdef TESTING_TRAJECTORY
+
+#define TEST_TRAJECTORY_ROUNDTRIP
+#define TEST_TRAJECTORY_THROUGHPUT
+
+#endif
+
+// #define TESTING_ASYNC_WRITER
+#ifdef TESTING_ASYNC_WRITER
+
+#define TEST_ASYNC_WRITER_BLOCK
+#define TEST_ASYNC_WRITER_POLICIES
+
+#endif
+
+// #define TESTING_DAT_EMITTER
+#ifdef TESTING_DAT_EMITTER
+
+#define TEST_DAT_EMITTER_FORMAT
+#define TEST_DAT_EMITTER_THROUGHPUT
+
+#endif
+
+// #define TESTING_DECIMATION
+#ifdef TESTING_DECIMATION
+
+#define TEST_DECIMATION_DOUGLAS_PEUCKER
+#define TEST_DECIMATION_LOD
+
+#endif
+
+// #define TESTING_MATRIX_FILE
+#ifdef TESTING_MATRIX_FILE
+
+#define TEST_MATRIX_FILE_ROUNDTRIP
+#define TEST_MATRIX_FILE_STARTUP
 
 #endif
 
@@ -0,0 +1,46 @@
+/**
+* @file constants.h
+*
+* @brief Physical and scenario constants of the rail-accelerator launch, as in
+* the Python prototype (python_prototyping/RailAcceleration/Constants)
+*
+* @author Pavlo Vlastos
+*/
+
+#ifndef CONSTANTS_H
+#define CONSTANTS_H
+
+/******************************************************************************
+ * DEFINES
+ *****************************************************************************/
+/* Planet */
+#define RADIUS_EARTH 6371000.0 /* radiusEarth, Earth's radius in meters */
+#define MASS_EARTH 5.972e24    /* massEarth, Earth's mass in kg */
+#define GRAVITATIONAL_CONSTANT 6.67408e-11 /* G, in m^3 / (kg s^2) */
+
+/* Earth's gravitational parameter, G * massEarth, in m^3 / s^2 */
+#define MU_EARTH (GRAVITATIONAL_CONSTANT * MASS_EARTH)
+
+/* Second zonal harmonic of Earth's gravity field (oblateness), taken with
+ * RADIUS_EARTH as the reference radius */
+#define J2_EARTH 1.08262668e-3
+
+/* Timing */
+#define SIM_DT 0.025    /* dt, sample time in seconds */
+#define SIM_T0 -10.0    /* t0, start time of simulation in seconds */
+#define SIM_TL 0.0      /* tl, launch time in seconds */
+#define SIM_TF 30000.0  /* tf, stop time of simulation in seconds */
+
+/* Projectile */
+#define MASS_PROJECTILE 1252.0 /* massProjectile, projectile mass in kg */
+
+/* Accelerator */
+#define INIT_FORCE 10000.0 /* initforce, force of the accelerator in N */
+#define RAIL_LENGTH 10.0   /* railLength, meters */
+
+/* Initial Earth-Centered Earth-Fixed (ECEF) coordinates of the projectile */
+#define LAUNCH_X0 RADIUS_EARTH
+#define LAUNCH_Y0 0.0
+#define LAUNCH_Z0 0.0
+
+#endif /* CONSTANTS_H */
@@ -0,0 +1,124 @@
+/**
+* @file dat_emitter.h
+*
+* @brief Batched writing of gnuplot .dat files: whole point and vector sets
+* formatted by to_chars into a reusable buffer, written in large blocks
+*
+* @author Pavlo Vlastos
+*/
+
+#ifndef DAT_EMITTER_H
+#define DAT_EMITTER_H
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "tensor.h"
+
+/******************************************************************************
+ * DEFINES
+ *****************************************************************************/
+#define DAT_EMITTER_SHORTEST 0      /* Precision of shortest round trip */
+#define DAT_EMITTER_BATCH (1 << 20) /* Bytes gathered before each write */
+#define DAT_EMITTER_VALUE_CHARS 32  /* Room for any one formatted value */
+
+/******************************************************************************
+ * CLASS DEFINITION AND FUNCTION DECLARATIONS
+ *****************************************************************************/
+/**
+ * @brief Writes rows of numbers in the layout of tensor_to_gnuplot_dot():
+ * each value followed by a space, each row by "\r\n". Dots are rows of
+ * x y z (simulation/gnuplot_dot), vectors rows of x y z dx dy dz
+ * (simulation/gnuplot_vector).
+ *
+ * Values are formatted by to_chars, which is locale independent and does not
+ * allocate: by default as the shortest text that reads back as the same
+ * double, or to a set number of significant digits. The text is gathered in
+ * a buffer kept from batch to batch, and goes to the file in one write() per
+ * DAT_EMITTER_BATCH bytes.
+ */
+class dat_emitter
+{
+private:
+    int fd = -1;
+    unsigned int precision = DAT_EMITTER_SHORTEST;
+    vector<char> buffer;
+    size_t used = 0; /* Bytes of buffer holding text not yet written */
+    unsigned long rows = 0;
+
+    /* Append a row of n values */
+    void append_row(const double *values, unsigned int n);
+
+    /* Write the buffer once it holds a batch */
+    tensor_status flush_if_full(void);
+
+public:
+    /* Dat emitter class constructor */
+    dat_emitter(void) {}
+
+    /* Dat emitter class destructor, closing the file */
+    ~dat_emitter(void);
+
+    dat_emitter(const dat_emitter &) = delete;
+    dat_emitter &operator=(const dat_emitter &) = delete;
+
+    /**
+     * @brief Create (or truncate) a .dat file
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status open(const char *path);
+
+    /**
+     * @brief Write out the buffer and close the file
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status close(void);
+
+    /**
+     * @brief Write out whatever the buffer holds
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status flush(void);
+
+    /**
+     * @brief Emit n dots, (x[i], y[i], z[i])
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status emit_dots(const double *x, const double *y, const double *z,
+                            unsigned int n);
+
+    /**
+     * @brief Emit the dots of a tensor, either one per row [n x 3] or one
+     * per column [3 x n]
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status emit_dots(const tensor &points);
+
+    /**
+     * @brief Emit n vectors from (x[i], y[i], z[i]) along (dx[i], dy[i],
+     * dz[i])
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status emit_vectors(const double *x, const double *y,
+                               const double *z, const double *dx,
+                               const double *dy, const double *dz,
+                               unsigned int n);
+
+    /**************************************************************************
+     * Setters
+    **************************************************************************/
+    /**
+     * @brief Set the significant digits of each value, or
+     * DAT_EMITTER_SHORTEST for the shortest exact text
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status set_precision(unsigned int digits);
+
+    /**************************************************************************
+     * Getters
+    **************************************************************************/
+    inline unsigned long get_rows(void) const { return rows; }
+    inline bool is_open(void) const { return fd >= 0; }
+};
+
+#endif /* DAT_EMITTER_H */
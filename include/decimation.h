@@ -0,0 +1,184 @@
+/**
+* @file decimation.h
+*
+* @brief Error-bounded simplification of 3D trajectories, by Douglas-Peucker
+* or by streaming max-deviation decimation, and a level-of-detail exporter of
+* .dat files built on the latter while a simulation runs
+*
+* @author Pavlo Vlastos
+*/
+
+#ifndef DECIMATION_H
+#define DECIMATION_H
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "tensor.h"
+#include "dat_emitter.h"
+#include "async_writer.h"
+
+/******************************************************************************
+ * DEFINES
+ *****************************************************************************/
+#define LOD_MAX_LEVELS 8
+#define LOD_RATIO 4.0 /* Tolerance of each level over that of the one before */
+
+/******************************************************************************
+ * CLASS DEFINITION AND FUNCTION DECLARATIONS
+ *****************************************************************************/
+/**
+ * @brief Simplify a polyline by Douglas-Peucker: keep its ends, and
+ * recursively the point farthest from the segment between two kept points
+ * while that is farther than the tolerance. Every point left out is within
+ * the tolerance of the segment between the kept points around it.
+ * @param x, y, z The points [n]
+ * @param n The number of points
+ * @param tolerance The largest distance of a point left out
+ * @param kept The indices of the points kept, in order
+ * @return tensor_status SUCCESS or FAILURE
+ */
+tensor_status douglas_peucker(const double *x, const double *y,
+                              const double *z, unsigned int n,
+                              double tolerance, vector<unsigned int> &kept);
+
+/**
+ * @brief Decimates a stream of points as they come: points are held back
+ * while one segment from the last kept point can pass within the tolerance
+ * of them all, and the last point held is kept once none can. Each point
+ * held farther than the tolerance allows the segment a cone of directions,
+ * so the decimator only keeps the intersection of the cones (as a cone
+ * inside it) and the distance of the farthest point: each point costs the
+ * same, however many are held. Every point left out is within the tolerance
+ * of the segment between the kept points around it, as with Douglas-Peucker,
+ * if with more points kept.
+ */
+class stream_decimator
+{
+private:
+    double tolerance;
+    double anchor[3]; /* The last point kept */
+    double last[3];   /* The last point held */
+    bool holding = false;
+    bool constrained = false; /* Whether any cone applies yet */
+    double axis[3];           /* The cone the directions must lie in */
+    double half_angle = 0.0;
+    double reach = 0.0; /* Distance of the farthest point held */
+    unsigned long seen = 0;
+    unsigned long kept = 0;
+    unsigned long anchor_index = 0;
+
+    /* Hold a point, narrowing the cone, if the segment to it passes within
+     * the tolerance of every point held */
+    bool hold(const double *point);
+
+public:
+    /**
+     * @brief Stream decimator class constructor
+     * @param tolerance_in The largest distance of a point left out
+     */
+    stream_decimator(double tolerance_in) : tolerance(tolerance_in) {}
+
+    /**
+     * @brief Take the next point
+     * @param point x y z
+     * @param out x y z of a point kept, when one is
+     * @return true if a point was kept, into out
+     */
+    bool push(const double *point, double *out);
+
+    /**
+     * @brief Keep the last point of the stream, and start over
+     * @param out x y z of the last point, when not already kept
+     * @return true if a point was kept, into out
+     */
+    bool finish(double *out);
+
+    /**************************************************************************
+     * Getters
+    **************************************************************************/
+    inline unsigned long get_seen(void) const { return seen; }
+    inline unsigned long get_kept(void) const { return kept; }
+
+    /**
+     * @brief The index in the stream of the last point kept
+     */
+    inline unsigned long get_kept_index(void) const { return anchor_index; }
+};
+
+/**
+ * @brief Writes a trajectory as it is simulated to a set of .dat files in
+ * the dots layout of simulation/gnuplot_dot, one per level of detail. Level
+ * 0 is within the base tolerance of the trajectory, and each coarser level
+ * within LOD_RATIO times the tolerance of the one before, so a plot can load
+ * the finest level it can afford. The size of each file follows how much the
+ * trajectory bends, not how many steps it took.
+ *
+ * Each level decimates the whole trajectory on its own, at a fixed cost per
+ * point and level.
+ */
+class lod_exporter
+{
+private:
+    unsigned int levels = 0;
+    vector<stream_decimator> decimators;
+    dat_emitter files[LOD_MAX_LEVELS];
+    unsigned long points = 0;
+
+public:
+    /* Level of detail exporter class constructor */
+    lod_exporter(void) {}
+
+    /* Level of detail exporter class destructor, closing the files */
+    ~lod_exporter(void);
+
+    lod_exporter(const lod_exporter &) = delete;
+    lod_exporter &operator=(const lod_exporter &) = delete;
+
+    /**
+     * @brief Create (or truncate) the file of each level, prefix_lod<l>.dat
+     * @param prefix The path of the files, up to the level
+     * @param levels_in The number of levels, up to LOD_MAX_LEVELS
+     * @param tolerance The tolerance of level 0
+     * @param ratio The tolerance of each level over that of the one before
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status open(const char *prefix, unsigned int levels_in,
+                       double tolerance, double ratio = LOD_RATIO);
+
+    /**
+     * @brief Write the last point of each level, and close the files
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status close(void);
+
+    /**
+     * @brief Take the next point of the trajectory
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status push(double x, double y, double z);
+
+    /**************************************************************************
+     * Getters
+    **************************************************************************/
+    inline unsigned int get_levels(void) const { return levels; }
+    inline unsigned long get_points(void) const { return points; }
+
+    /**
+     * @brief The points written to the file of level l
+     */
+    inline unsigned long get_rows(unsigned int l) const
+    {
+        return files[l].get_rows();
+    }
+};
+
+/**
+ * @brief A sink feeding the position of one particle of every frame to a
+ * level of detail exporter
+ * @param lod An open exporter, closed by its owner after stop()
+ * @param id The particle
+ */
+frame_sink lod_sink(shared_ptr<lod_exporter> lod, unsigned int id);
+
+#endif /* DECIMATION_H */
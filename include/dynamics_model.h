@@ -0,0 +1,118 @@
+/**
+* @file dynamics_model.h
+*
+* @brief Immutable, shared discrete dynamics models of a particle. Particles
+* with the same sample-time, mass, radius and moment of inertia point at one
+* interned model instead of each carrying its own phi and gamma.
+*
+* @author Pavlo Vlastos
+*/
+
+#ifndef DYNAMICS_MODEL_H
+#define DYNAMICS_MODEL_H
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "tensor.h"
+#include "sparse_tensor.h"
+#include <memory>
+#include <mutex>
+
+/******************************************************************************
+ * DEFINES
+ *****************************************************************************/
+#define STATE_SIZE 12
+#define INPUT_SIZE 6
+
+/* Most recently interned models kept alive even when no particle uses them,
+ * so a variable-rate run switching between a few sample-times reuses them */
+#define DYNAMICS_MODEL_RETAINED 16
+
+/* Levels of cached jumps, 2^0 .. 2^63 steps, enough for any unsigned long */
+#define DYNAMICS_MODEL_JUMP_LEVELS 64
+
+/******************************************************************************
+ * GLOBAL VARIABLES AND DATATYPES
+ *****************************************************************************/
+/* 2^j steps of a model under a constant input u, in one:
+ * x = phi^(2^j) x + (phi^0 + ... + phi^(2^j - 1)) gamma u */
+struct dynamics_jump
+{
+    tensor phi;   /* phi^(2^j) */
+    tensor gamma; /* The input matrix accumulated over the 2^j steps */
+
+    sparse_tensor sparse_phi;
+    sparse_tensor sparse_gamma;
+};
+
+/******************************************************************************
+ * CLASS DEFINITION AND FUNCTION DECLARATIONS
+ *****************************************************************************/
+/**
+ * @brief The exact zero-order hold discretization of a particle's continuous
+ * dynamics, a double integrator per axis with the normal forces accelerating
+ * the position by 1 / mass and the tangent forces the attitude by
+ * radius / moi. Computed as e^([A B; 0 0] dt) = [phi gamma; 0 I] by expm().
+ *
+ * Models are only made through intern(), which hands out the live model for
+ * a set of parameters if there is one. A model is never modified, so a
+ * particle whose parameters change (copy-on-write) simply interns another.
+ */
+class dynamics_model
+{
+private:
+    /* Dynamics model class constructor, discretizing right away */
+    dynamics_model(double dt_in, double mass_in, double radius_in,
+                   double moi_in);
+
+    bool valid = false; /* Whether the discretization succeeded */
+
+    /* jumps[j] is 2^j steps, squared from jumps[j - 1] when first asked for.
+     * A jump never moves once made, so references to it stay valid. */
+    mutable mutex jump_mutex;
+    mutable vector<unique_ptr<const dynamics_jump>> jumps;
+
+public:
+    const double dt;
+    const double mass;
+    const double radius;
+    const double moi; /* Moment of inertia */
+
+    tensor phi;   /* State transition, e^(A dt) */
+    tensor gamma; /* Input matrix, the integral of e^(A t) B over dt */
+
+    /* Non-zeros of phi and gamma, which is all a step needs to visit */
+    sparse_tensor sparse_phi;
+    sparse_tensor sparse_gamma;
+
+    /**
+     * @brief 2^level steps of the model under a constant input, by repeated
+     * squaring of phi: jump j + 1 is phi_j^2 and gamma_j + phi_j gamma_j.
+     * Each level is computed once per model and kept. Safe to call from
+     * several threads.
+     * @param level The base two logarithm of the step count, below
+     * DYNAMICS_MODEL_JUMP_LEVELS
+     * @return The jump, or nullptr if level is out of range
+     */
+    const dynamics_jump *jump(unsigned int level) const;
+
+    /**
+     * @brief The shared model for a set of parameters, discretized only if
+     * no live model has them. Safe to call from several threads.
+     * @param dt The sample-time
+     * @param mass The mass of the particle
+     * @param radius The radius of the particle
+     * @param moi The moment of inertia of the particle
+     * @return The model, or nullptr if it could not be computed
+     */
+    static shared_ptr<const dynamics_model> intern(double dt, double mass,
+                                                   double radius, double moi);
+
+    /**
+     * @brief The number of distinct models currently alive
+     */
+    static unsigned int live_models(void);
+};
+
+#endif /* DYNAMICS_MODEL_H */
@@ -0,0 +1,232 @@
+/**
+* @file factorization.h
+*
+* @brief Matrix factorizations that are computed once and then reused to
+* solve against many right-hand sides
+*
+* @author Pavlo Vlastos
+*/
+
+#ifndef FACTORIZATION_H
+#define FACTORIZATION_H
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "tensor.h"
+
+/******************************************************************************
+ * DEFINES
+ *****************************************************************************/
+#define FACTORIZATION_BLOCK 32 /* Panel width of the blocked factorizations */
+
+/******************************************************************************
+ * CLASS DEFINITION AND FUNCTION DECLARATIONS
+ *****************************************************************************/
+/**
+ * @brief LU factorization with partial pivoting, P * A = L * U, of a square
+ * tensor. L (unit diagonal, not stored) and U share one packed tensor.
+ */
+class lu_factorization
+{
+private:
+    tensor lu;                   /* L strictly below the diagonal, U on/above */
+    vector<unsigned int> pivots; /* Step k swapped rows k and pivots[k] */
+    int pivot_sign = 1;          /* Determinant of P, +1 or -1 */
+    bool singular = true;
+
+public:
+    /* LU factorization class constructor, factoring a right away */
+    lu_factorization(const tensor &a) : lu(a.m_height, a.n_width)
+    {
+        factor(a);
+    }
+
+    /**
+     * @brief Factor a square tensor, replacing any previous factorization
+     * @param a A square tensor
+     * @return Tensor status (SUCCESS, or FAILURE if a is not square or is
+     * singular)
+    */
+    tensor_status factor(const tensor &a);
+
+    /**
+     * @brief Whether the factored tensor was singular (or not square), in
+     * which case solving is not possible
+    */
+    inline bool is_singular(void) const { return singular; }
+
+    /**
+     * @brief Solve A * x = b
+     * @param b The right-hand sides [n x p]
+     * @param x The solutions [n x p], which may be b
+     * @return Tensor status (SUCCESS or FAILURE)
+    */
+    tensor_status solve(const tensor &b, tensor &x) const;
+
+    /**
+     * @brief Solve A * x = b, overwriting b with x
+     * @param b The right-hand sides [n x p], replaced by the solutions
+     * @return Tensor status (SUCCESS or FAILURE)
+    */
+    tensor_status solve_in_place(tensor &b) const;
+
+    /**
+     * @brief The determinant of the factored tensor (0.0 if singular)
+    */
+    double determinant(void) const;
+
+    /**
+     * @brief The inverse of the factored tensor
+     * @param a_inv A preallocated tensor [n x n] for the inverse, left as
+     * it was on failure
+     * @return Tensor status (SUCCESS, or FAILURE if singular or a_inv is
+     * not [n x n])
+    */
+    tensor_status inverse(tensor &a_inv) const;
+};
+
+/**
+ * @brief Householder QR factorization, A = Q * R, of a tall (or square)
+ * tensor. R lives on and above the diagonal; the Householder vectors (with an
+ * implicit leading 1) live below it. Panels of FACTORIZATION_BLOCK reflectors
+ * are applied to the trailing columns at once in compact WY form, through
+ * gemm().
+ */
+class qr_factorization
+{
+private:
+    tensor qr;          /* Packed R and Householder vectors */
+    vector<double> tau; /* Scale of each Householder reflector */
+    bool rank_deficient = true;
+
+public:
+    /* QR factorization class constructor, factoring a right away */
+    qr_factorization(const tensor &a) : qr(a.m_height, a.n_width)
+    {
+        factor(a);
+    }
+
+    /**
+     * @brief Factor a tensor with at least as many rows as columns
+     * @param a A tensor [m x n], m >= n
+     * @return Tensor status (SUCCESS, or FAILURE if m < n or R has a zero, to
+     * within rounding, on its diagonal)
+    */
+    tensor_status factor(const tensor &a);
+
+    /**
+     * @brief Whether R has a zero on its diagonal, so least squares solutions
+     * are not unique
+    */
+    inline bool is_rank_deficient(void) const { return rank_deficient; }
+
+    /**
+     * @brief Overwrite b with Q^T * b
+     * @param b A tensor [m x p]
+     * @return Tensor status (SUCCESS or FAILURE)
+    */
+    tensor_status apply_qt(tensor &b) const;
+
+    /**
+     * @brief The least squares solution x minimizing ||A * x - b||
+     * @param b The right-hand sides [m x p]
+     * @param x The solutions [n x p]
+     * @return Tensor status (SUCCESS or FAILURE)
+    */
+    tensor_status least_squares(const tensor &b, tensor &x) const;
+
+    /**
+     * @brief Copy out the upper triangular factor
+     * @param r A preallocated tensor [n x n]
+     * @return Tensor status (SUCCESS or FAILURE)
+    */
+    tensor_status get_r(tensor &r) const;
+};
+
+/**
+ * @brief Cholesky factorization, A = L * L^T, of a symmetric positive-definite
+ * tensor. Only the lower triangle of A is read. Factored by blocks of
+ * FACTORIZATION_BLOCK columns, with the trailing updates done by gemm().
+ */
+class cholesky_factorization
+{
+private:
+    tensor l; /* Lower triangular factor, zeros above the diagonal */
+    bool positive_definite = false;
+
+public:
+    /* Cholesky factorization class constructor, factoring a right away */
+    cholesky_factorization(const tensor &a) : l(a.m_height, a.n_width)
+    {
+        factor(a);
+    }
+
+    /**
+     * @brief Factor a symmetric positive-definite tensor
+     * @param a A square tensor
+     * @return Tensor status (SUCCESS, or FAILURE if a is not square or not
+     * positive-definite)
+    */
+    tensor_status factor(const tensor &a);
+
+    /**
+     * @brief Whether the last factorization (or update) succeeded
+    */
+    inline bool is_positive_definite(void) const { return positive_definite; }
+
+    /**
+     * @brief Solve A * x = b
+     * @param b The right-hand sides [n x p]
+     * @param x The solutions [n x p], which may be b
+     * @return Tensor status (SUCCESS or FAILURE)
+    */
+    tensor_status solve(const tensor &b, tensor &x) const;
+
+    /**
+     * @brief Solve A * x = b, overwriting b with x
+     * @param b The right-hand sides [n x p], replaced by the solutions
+     * @return Tensor status (SUCCESS or FAILURE)
+    */
+    tensor_status solve_in_place(tensor &b) const;
+
+    /**
+     * @brief Turn the factorization of A into that of A + x * x^T in O(n^2)
+     * @param x A column vector [n x 1]
+     * @return Tensor status (SUCCESS or FAILURE)
+    */
+    tensor_status update(const tensor &x);
+
+    /**
+     * @brief Turn the factorization of A into that of A - x * x^T in O(n^2).
+     * The factorization is left untouched if the result would not be
+     * positive-definite.
+     * @param x A column vector [n x 1]
+     * @return Tensor status (SUCCESS or FAILURE)
+    */
+    tensor_status downdate(const tensor &x);
+
+    /**
+     * @brief The determinant of the factored tensor
+    */
+    double determinant(void) const;
+
+    /**
+     * @brief Copy out the lower triangular factor
+     * @param l_out A preallocated tensor [n x n]
+     * @return Tensor status (SUCCESS or FAILURE)
+    */
+    tensor_status get_l(tensor &l_out) const;
+};
+
+/**
+ * @brief The least squares solution x minimizing ||a * x - b|| of a tall
+ * system, through a Householder QR factorization
+ * @param a A tensor [m x n], m >= n, of full column rank
+ * @param b The right-hand sides [m x p]
+ * @param x The solutions [n x p]
+ * @return Tensor status (SUCCESS or FAILURE)
+ */
+tensor_status least_squares(const tensor &a, const tensor &b, tensor &x);
+
+#endif /* FACTORIZATION_H */
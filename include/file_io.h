@@ -0,0 +1,44 @@
+/**
+* @file file_io.h
+*
+* @brief POSIX file helpers shared by the binary formats and the .dat
+* emitter: complete writes, and private memory maps owned by a shared_ptr
+*
+* @author Pavlo Vlastos
+*/
+
+#ifndef FILE_IO_H
+#define FILE_IO_H
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "tensor.h"
+
+/******************************************************************************
+ * FUNCTION DECLARATIONS
+ *****************************************************************************/
+/**
+ * @brief Write all of a buffer, however many calls write() takes
+ * @param fd An open file
+ * @param data The bytes to write
+ * @param size The number of bytes
+ * @return tensor_status SUCCESS or FAILURE
+ */
+tensor_status write_all(int fd, const void *data, size_t size);
+
+/**
+ * @brief Map a whole file, private and writable: what is mapped may be
+ * written, in memory, but the file never is
+ * @param path The path of the file
+ * @param min_size The fewest bytes the file may hold
+ * @param mapping Owns the mapping, unmapping it when the last copy is gone
+ * (e.g. held by tensor views of it)
+ * @param size The bytes mapped, the size of the file
+ * @return tensor_status SUCCESS, or FAILURE if the file cannot be mapped or
+ * is shorter than min_size
+ */
+tensor_status map_file(const char *path, size_t min_size,
+                       shared_ptr<void> &mapping, size_t &size);
+
+#endif /* FILE_IO_H */
@@ -0,0 +1,223 @@
+/**
+* @file fixed_tensor.h
+*
+* @brief A stack-allocated tensor whose dimensions are known at compile time,
+* for the small 3x3, 4x1 and 12x12 products that dominate particle dynamics
+*
+* @author Pavlo Vlastos
+*/
+
+#ifndef FIXED_TENSOR_H
+#define FIXED_TENSOR_H
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "tensor.h"
+
+/******************************************************************************
+ * DEFINES
+ *****************************************************************************/
+/* Ask the compiler to fully unroll the (compile-time bounded) loops below */
+#define FIXED_TENSOR_UNROLL _Pragma("GCC unroll 16")
+
+/******************************************************************************
+ * CLASS DEFINITION AND FUNCTION DECLARATIONS
+ *****************************************************************************/
+template <unsigned int M, unsigned int N>
+class fixed_tensor
+{
+    static_assert((M > 0) && (N > 0),
+                  "fixed_tensor dimensions must be non-zero");
+
+public:
+    static constexpr unsigned int m_height = M; /* Number of rows*/
+    static constexpr unsigned int n_width = N;  /* Number of columns*/
+
+    alignas(32) double elements[M * N]; /* Row-major element storage */
+
+    fixed_tensor(void) : elements{} {}
+
+    /* Fixed tensor class constructor overloaded, e.g. {{1, 2}, {3, 4}} */
+    fixed_tensor(const double (&v)[M][N])
+    {
+        FIXED_TENSOR_UNROLL
+        for (unsigned int i = 0; i < M; i++)
+        {
+            FIXED_TENSOR_UNROLL
+            for (unsigned int j = 0; j < N; j++)
+            {
+                elements[i * N + j] = v[i][j];
+            }
+        }
+    }
+
+    /**
+     * @brief Build from a dynamic tensor. Left as zeros if the dimensions of
+     * the dynamic tensor do not match, just like the dynamic free functions
+     * @param a A dynamic tensor of dimensions M x N
+    */
+    explicit fixed_tensor(const tensor &a) : elements{}
+    {
+        from_tensor(a);
+    }
+
+    inline double &operator()(unsigned int row, unsigned int col)
+    {
+        return elements[row * N + col];
+    }
+
+    inline const double &operator()(unsigned int row, unsigned int col) const
+    {
+        return elements[row * N + col];
+    }
+
+    inline double *data(void) { return elements; }
+    inline const double *data(void) const { return elements; }
+    inline unsigned int stride(void) const { return N; }
+
+    /**
+     * @brief Copy the contents of a dynamic tensor into this fixed tensor
+     * @param a A dynamic tensor of dimensions M x N
+     * @return Tensor status (SUCCESS or FAILURE on a dimension mismatch)
+    */
+    tensor_status from_tensor(const tensor &a)
+    {
+        if ((a.m_height != M) || (a.n_width != N))
+        {
+            return tensor_status::FAILURE;
+        }
+
+        for (unsigned int i = 0; i < M; i++)
+        {
+            memcpy(elements + i * N, a.data() + (size_t)i * a.stride(),
+                   N * sizeof(double));
+        }
+
+        return tensor_status::SUCCESS;
+    }
+
+    /**
+     * @brief Copy this fixed tensor into a new dynamic tensor
+     * @return A dynamic tensor of dimensions M x N
+    */
+    tensor to_tensor(void) const
+    {
+        tensor a(M, N);
+
+        for (unsigned int i = 0; i < M; i++)
+        {
+            memcpy(a.data() + (size_t)i * a.stride(), elements + i * N,
+                   N * sizeof(double));
+        }
+
+        return a;
+    }
+
+    /**
+     * @brief print the tensor
+    */
+    void print(void) const
+    {
+        for (unsigned int row = 0; row < M; row++)
+        {
+            cout << "[ ";
+            for (unsigned int col = 0; col < N; col++)
+            {
+                cout << elements[row * N + col] << " ";
+            }
+            cout << "]\n";
+        }
+        cout << "Dimensions: " << M << " x " << N << "\n";
+    }
+};
+
+/**
+ * @brief multiply two fixed tensors together to make a new fixed tensor.
+ * Operands with mismatched inner dimensions do not compile.
+ * @param a A fixed tensor [M x K]
+ * @param b Another fixed tensor [K x N]
+ * @return c A new fixed tensor [M x N], being the matrix product of a and b.
+ */
+template <unsigned int M, unsigned int K, unsigned int N>
+inline fixed_tensor<M, N> multiply(const fixed_tensor<M, K> &a,
+                                   const fixed_tensor<K, N> &b)
+{
+    fixed_tensor<M, N> c;
+
+    FIXED_TENSOR_UNROLL
+    for (unsigned int i = 0; i < M; i++)
+    {
+        FIXED_TENSOR_UNROLL
+        for (unsigned int k = 0; k < K; k++)
+        {
+            const double a_ik = a.elements[i * K + k];
+
+            FIXED_TENSOR_UNROLL
+            for (unsigned int j = 0; j < N; j++)
+            {
+                c.elements[i * N + j] += a_ik * b.elements[k * N + j];
+            }
+        }
+    }
+
+    return c;
+}
+
+/**
+ * @brief add two fixed tensors of identical dimensions together
+ * @param a A fixed tensor [M x N]
+ * @param b Another fixed tensor [M x N]
+ * @return c A new fixed tensor, being the matrix addition of a and b.
+ */
+template <unsigned int M, unsigned int N>
+inline fixed_tensor<M, N> add(const fixed_tensor<M, N> &a,
+                              const fixed_tensor<M, N> &b)
+{
+    fixed_tensor<M, N> c;
+
+    FIXED_TENSOR_UNROLL
+    for (unsigned int i = 0; i < (M * N); i++)
+    {
+        c.elements[i] = a.elements[i] + b.elements[i];
+    }
+
+    return c;
+}
+
+/**
+ * @brief tansposes a fixed tensor
+ * @param a A fixed tensor [M x N]
+ * @return The transpose of a [N x M]
+ */
+template <unsigned int M, unsigned int N>
+inline fixed_tensor<N, M> transpose(const fixed_tensor<M, N> &a)
+{
+    fixed_tensor<N, M> b;
+
+    FIXED_TENSOR_UNROLL
+    for (unsigned int i = 0; i < N; i++)
+    {
+        FIXED_TENSOR_UNROLL
+        for (unsigned int j = 0; j < M; j++)
+        {
+            b.elements[i * M + j] = a.elements[j * N + i];
+        }
+    }
+
+    return b;
+}
+
+/**
+ * @brief Create a Direction Cosine Matrix (DCM) in (yaw,pitch,roll) -> (ZXY)
+ * format, without touching the heap
+ * @param psi Yaw rotation angle value in radians
+ * @param theta Pitch rotation angle value in radians
+ * @param phi Roll rotation angle value in radians
+ * @param dcm A fixed tensor that will be converted to a dcm
+ * @return Tensor status (SUCCESS or FAILURE)
+*/
+tensor_status create_dcm(double psi, double theta, double phi,
+                         fixed_tensor<3, 3> &dcm);
+
+#endif /* FIXED_TENSOR_H */
@@ -0,0 +1,136 @@
+/**
+* @file force_schedule.h
+*
+* @brief A timeline of input forces, compiled into a sorted array of
+* constant and linearly interpolated segments over sample steps
+*
+* @author Pavlo Vlastos
+*/
+
+#ifndef FORCE_SCHEDULE_H
+#define FORCE_SCHEDULE_H
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "tensor.h"
+#include "particle.h"
+#include "particle_system.h"
+
+/******************************************************************************
+ * GLOBAL VARIABLES AND DATATYPES
+ *****************************************************************************/
+/* The input over the steps [begin, next segment's begin): at step i it is
+ * u + slope * (i - begin), or just u for a constant segment */
+struct force_segment
+{
+    unsigned long begin;
+    bool constant;
+    double u[INPUT_SIZE];
+    double slope[INPUT_SIZE]; /* Change of the input per step */
+};
+
+/******************************************************************************
+ * CLASS DEFINITION AND FUNCTION DECLARATIONS
+ *****************************************************************************/
+/**
+ * @brief Input forces over time, in the order of particle::set_u(): normal
+ * forces fnx, fny, fnz, then tangent forces ftx, fty, ftz. Forces are added
+ * as pieces over time intervals, overlapping pieces sum, and the input is
+ * zero wherever no piece applies.
+ *
+ * compile() samples the pieces on the step grid of a sample-time, the input
+ * held over step i being its value at t = i * dt, into sorted segments. Each
+ * segment is either constant, which run() hands to advance() as a single
+ * jump, or a ramp, stepped by update() with its input set per step.
+ */
+class force_schedule
+{
+private:
+    /* A piece as added, over [t_begin, t_end) */
+    struct piece
+    {
+        double t_begin;
+        double t_end;
+        double u_begin[INPUT_SIZE];
+        double u_end[INPUT_SIZE];
+    };
+
+    vector<piece> pieces;
+    vector<force_segment> segments; /* Ends with a zero segment, forever */
+    double dt = 0.0;                /* The sample-time compiled for */
+
+    /* The index of the segment holding step i */
+    unsigned int find(unsigned long i) const;
+
+    /* The end of segment k's steps, or of the steps before last */
+    unsigned long segment_end(unsigned int k, unsigned long last) const;
+
+public:
+    /* Force schedule class constructor */
+    force_schedule(void) {}
+
+    /**
+     * @brief Add a constant force over [t_begin, t_end)
+     * @param u The input [INPUT_SIZE]
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status add(double t_begin, double t_end, const double *u);
+
+    /**
+     * @brief Add a force interpolated linearly over [t_begin, t_end), from
+     * u_begin at t_begin towards u_end at t_end
+     * @param u_begin The input at t_begin [INPUT_SIZE]
+     * @param u_end The input at t_end [INPUT_SIZE]
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status add(double t_begin, double t_end, const double *u_begin,
+                      const double *u_end);
+
+    /**
+     * @brief Remove every piece and segment
+     */
+    void clear(void);
+
+    /**
+     * @brief Sample the pieces on the step grid of a sample-time, each time
+     * rounded to the nearest step, into the segment array
+     * @param dt_in The sample-time of the particles to drive
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status compile(double dt_in);
+
+    /**
+     * @brief Step a particle through the steps [first, first + steps) of
+     * the schedule. Its sample-time must be the one compiled for.
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status run(particle &p, unsigned long first,
+                      unsigned long steps) const;
+
+    /**
+     * @brief Step the particles [begin, end) of a system together through
+     * the steps [first, first + steps), all under the scheduled input
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status run(particle_system &system, unsigned int begin,
+                      unsigned int end, unsigned long first,
+                      unsigned long steps) const;
+
+    /**************************************************************************
+     * Getters
+    **************************************************************************/
+    /**
+     * @brief The input held over step i
+     * @param u The input [INPUT_SIZE]
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status sample(unsigned long i, double *u) const;
+
+    inline const vector<force_segment> &get_segments(void) const
+    {
+        return segments;
+    }
+};
+
+#endif /* FORCE_SCHEDULE_H */
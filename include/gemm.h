@@ -0,0 +1,58 @@
+/**
+* @file gemm.h
+*
+* @brief Cache-blocked, register-blocked general matrix multiply on raw
+* row-major storage, with an AVX2/FMA micro-kernel and a scalar fallback
+*
+* @author Pavlo Vlastos
+*/
+
+#ifndef GEMM_H
+#define GEMM_H
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "tensor.h"
+
+/******************************************************************************
+ * DEFINES
+ *****************************************************************************/
+#define GEMM_MR 6    /* Rows of C held in registers by the micro-kernel */
+#define GEMM_NR 8    /* Columns of C held in registers by the micro-kernel */
+#define GEMM_KC 256  /* Depth of a packed panel (sized for L1) */
+#define GEMM_MC 72   /* Rows of a packed block of A (sized for L2) */
+#define GEMM_NC 2048 /* Columns of a packed block of B (sized for L3) */
+
+/* Products with fewer multiply-adds than this skip packing entirely */
+#define GEMM_MIN_WORK 4096
+
+/******************************************************************************
+ * FUNCTION DECLARATIONS
+ *****************************************************************************/
+/**
+ * @brief Computes C = alpha * A * B + beta * C on row-major storage
+ * @param m The number of rows of A and C
+ * @param n The number of columns of B and C
+ * @param k The number of columns of A and rows of B
+ * @param alpha Scale applied to the product A * B
+ * @param a The first element of A
+ * @param lda The number of elements between rows of A
+ * @param b The first element of B
+ * @param ldb The number of elements between rows of B
+ * @param beta Scale applied to C before accumulating (0.0 overwrites C)
+ * @param c The first element of C, which must not overlap A or B
+ * @param ldc The number of elements between rows of C
+ */
+void gemm(unsigned int m, unsigned int n, unsigned int k, double alpha,
+          const double *a, unsigned int lda, const double *b,
+          unsigned int ldb, double beta, double *c, unsigned int ldc);
+
+/**
+ * @brief Reports whether gemm() dispatches to the AVX2/FMA micro-kernel on
+ * this machine
+ * @return true if the vector micro-kernel is in use
+ */
+bool gemm_uses_avx2(void);
+
+#endif /* GEMM_H */
@@ -0,0 +1,236 @@
+/**
+* @file integrator.h
+*
+* @brief An adaptive-step Dormand-Prince RK5(4) integrator with dense output,
+* for the continuous dynamics of particles driven by arbitrary forces
+*
+* @author Pavlo Vlastos
+*/
+
+#ifndef INTEGRATOR_H
+#define INTEGRATOR_H
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include <functional>
+#include "tensor.h"
+#include "particle.h"
+
+/******************************************************************************
+ * DEFINES
+ *****************************************************************************/
+#define DORMAND_PRINCE_STAGES 7
+#define DORMAND_PRINCE_DENSE_ORDER 4 /* Degree of the interpolant */
+
+/* Step size control, as in Hairer, Norsett and Wanner */
+#define INTEGRATOR_SAFETY 0.9
+#define INTEGRATOR_MIN_FACTOR 0.2 /* Largest shrink of a rejected step */
+#define INTEGRATOR_MAX_FACTOR 10.0 /* Largest growth of an accepted step */
+
+#define INTEGRATOR_DEFAULT_RTOL 1e-6
+#define INTEGRATOR_DEFAULT_ATOL 1e-9
+
+/******************************************************************************
+ * GLOBAL VARIABLES AND DATATYPES
+ *****************************************************************************/
+/**
+ * @brief The right-hand side of y' = f(t, y)
+ * @param t The time
+ * @param y The state [n x 1]
+ * @param dy The derivative [n x 1], to be overwritten
+ * @return tensor_status SUCCESS, or FAILURE to abort the integration
+ */
+typedef function<tensor_status(double t, const tensor &y, tensor &dy)>
+    derivative_function;
+
+/**
+ * @brief The forces on a particle, laid out like particle::set_u()
+ * @param t The time
+ * @param state The particle state [STATE_SIZE x 1]
+ * @param u The forces [INPUT_SIZE x 1], to be overwritten
+ * @return tensor_status SUCCESS, or FAILURE to abort the integration
+ */
+typedef function<tensor_status(double t, const tensor &state, tensor &u)>
+    force_function;
+
+/**
+ * @brief Receives the solution at the requested output times
+ */
+typedef function<void(double t, const tensor &y)> output_function;
+
+/******************************************************************************
+ * CLASS DEFINITION AND FUNCTION DECLARATIONS
+ *****************************************************************************/
+/**
+ * @brief The explicit Runge-Kutta pair of Dormand and Prince: a fifth order
+ * solution advances the state while the embedded fourth order one estimates
+ * the local error, which sets the next step size. The last stage of a step is
+ * the derivative at its end, so it is reused as the first stage of the next
+ * (First Same As Last): six derivative evaluations per accepted step.
+ *
+ * After each step the solution anywhere inside it is available from a
+ * fourth order interpolant of the stages (dense output), so output at fixed
+ * intervals does not limit the step size.
+ *
+ * Integration runs forward in time. Stepping makes no heap allocations
+ * besides what the derivative function makes.
+ */
+class dormand_prince
+{
+private:
+    unsigned int n = 0; /* The state dimension */
+    derivative_function f;
+    bool initialized = false;
+
+    double rtol = INTEGRATOR_DEFAULT_RTOL; /* Relative tolerance */
+    double atol = INTEGRATOR_DEFAULT_ATOL; /* Absolute tolerance */
+    double h_min = 0.0;
+    double h_max = 0.0;     /* No limit when zero */
+    double h_initial = 0.0; /* Chosen automatically when zero */
+
+    double t = 0.0;     /* The time of y */
+    double h = 0.0;     /* The proposed size of the next step */
+    double t_old = 0.0; /* The start of the last accepted step */
+    double h_last = 0.0;
+
+    tensor y;      /* The current solution */
+    tensor y_old;  /* The solution at the start of the last step */
+    tensor y_new;  /* The trial solution of a step */
+    tensor y_temp; /* The argument of a stage evaluation */
+
+    /* The DORMAND_PRINCE_STAGES stage derivatives of the last step,
+     * k[0] = f(t_old, y_old) and k[6] = f(t, y) */
+    vector<tensor> k;
+    bool fsal_pending = false; /* Whether k[6] still has to become k[0] */
+
+    unsigned long accepted_steps = 0;
+    unsigned long rejected_steps = 0;
+    unsigned long evaluations = 0;
+
+    /* Evaluate f, counting the evaluation */
+    tensor_status evaluate(double t_eval, const tensor &y_eval, tensor &dy);
+
+    /* The root mean square of a over the error scale of y and y_new */
+    double scaled_rms(const tensor &a, const tensor &y_a,
+                      const tensor &y_b) const;
+
+    /* Choose the first step from the derivative and its rate of change */
+    tensor_status select_initial_step(void);
+
+public:
+    /* Dormand-Prince class constructor, for states of dimension n_in */
+    dormand_prince(unsigned int n_in);
+
+    /**
+     * @brief Start an integration
+     * @param f_in The right-hand side of y' = f(t, y)
+     * @param t0 The initial time
+     * @param y0 The initial state [n x 1]
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status initialize(const derivative_function &f_in, double t0,
+                             const tensor &y0);
+
+    /**
+     * @brief Take one accepted step, retrying with smaller steps while the
+     * error estimate is above the tolerance. The step never goes past t_bound.
+     * @param t_bound The time not to step past, greater than the current one
+     * @return tensor_status SUCCESS, or FAILURE if the step size underflows
+     * or the derivative function fails
+     */
+    tensor_status step(double t_bound);
+
+    /**
+     * @brief Integrate up to a final time
+     * @param t_final The time to stop at
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status integrate(double t_final);
+
+    /**
+     * @brief Integrate up to a final time, reporting the solution every
+     * output interval from the current time on, by dense output
+     * @param t_final The time to stop at
+     * @param interval The time between outputs
+     * @param output Receives each output time and state
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status integrate(double t_final, double interval,
+                            const output_function &output);
+
+    /**
+     * @brief The solution inside the last accepted step, from the fourth
+     * order interpolant of its stages
+     * @param t_eval A time in [t_old, t] of the last step
+     * @param y_eval The interpolated state [n x 1]
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status interpolate(double t_eval, tensor &y_eval) const;
+
+    /**************************************************************************
+     * Setters
+    **************************************************************************/
+    /**
+     * @brief Set the error tolerances. A step is accepted when the error of
+     * each component is about atol + rtol * |y| or less.
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status set_tolerances(double rtol_new, double atol_new);
+
+    /**
+     * @brief Limit the step size, a maximum of zero meaning no limit
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status set_step_limits(double h_min_new, double h_max_new);
+
+    /**
+     * @brief Set the size of the first step, zero to choose it automatically
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status set_initial_step(double h_new);
+
+    /**************************************************************************
+     * Getters
+    **************************************************************************/
+    inline double get_time(void) const { return t; }
+    inline const tensor &get_state(void) const { return y; }
+    inline double get_step_size(void) const { return h; }
+    inline unsigned long get_accepted_steps(void) const
+    {
+        return accepted_steps;
+    }
+    inline unsigned long get_rejected_steps(void) const
+    {
+        return rejected_steps;
+    }
+    inline unsigned long get_evaluations(void) const { return evaluations; }
+};
+
+/**
+ * @brief The continuous dynamics of a particle, x' = A x + B u, with the
+ * forces u from a force function: the velocities and rates integrate into
+ * the position and attitude, the normal forces accelerate the particle by
+ * 1 / mass and the tangent forces spin it by radius / moi
+ * @param p The particle, whose mass, radius and moi are copied
+ * @param force The forces on the particle
+ * @return The derivative function for a dormand_prince of STATE_SIZE
+ */
+derivative_function particle_dynamics(const particle &p,
+                                      const force_function &force);
+
+/**
+ * @brief Integrate a particle's state from t0 to t_final under a force
+ * function, leaving the final state in the particle
+ * @param solver A dormand_prince of STATE_SIZE, with its tolerances set
+ * @param p The particle
+ * @param force The forces on the particle
+ * @param t0 The initial time
+ * @param t_final The final time
+ * @return tensor_status SUCCESS or FAILURE
+ */
+tensor_status integrate(dormand_prince &solver, particle &p,
+                        const force_function &force, double t0,
+                        double t_final);
+
+#endif /* INTEGRATOR_H */
@@ -0,0 +1,65 @@
+/**
+* @file launch_sim.h
+*
+* @brief A headless run of the rail-accelerator launch scenario of the Python
+* prototype (python_prototyping/launch_sim.py)
+*
+* @author Pavlo Vlastos
+*/
+
+#ifndef LAUNCH_SIM_H
+#define LAUNCH_SIM_H
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "orbit.h"
+#include "constants.h"
+
+/******************************************************************************
+ * GLOBAL VARIABLES AND DATATYPES
+ *****************************************************************************/
+/* The parameters of a launch, defaulting to those of the prototype */
+struct launch_scenario
+{
+    double t0 = SIM_T0; /* Start of the accelerator push */
+    double tl = SIM_TL; /* Launch, when the projectile leaves the rail */
+    double tf = SIM_TF; /* End of the simulation */
+    double dt = SIM_DT;
+    double mass = MASS_PROJECTILE;
+    double force = INIT_FORCE; /* Accelerator force, until tl */
+    gravity_model gravity = gravity_model::J2;
+    symplectic_method method = symplectic_method::YOSHIDA4;
+    bool stop_at_impact = true; /* End the run when the projectile lands */
+};
+
+/* What became of the projectile */
+struct launch_result
+{
+    bool impacted = false;
+    double t_end = 0.0; /* The end of the run, the impact time if impacted */
+    unsigned long steps = 0;
+    double launch_speed = 0.0;   /* Speed leaving the rail, m/s */
+    double max_altitude = 0.0;   /* Above RADIUS_EARTH, m */
+    double min_altitude = 0.0;   /* After launch, m */
+    double energy_drift = 0.0;   /* Max |dE / E| of the coast after launch */
+    tensor final_state = tensor(STATE_SIZE);
+};
+
+/******************************************************************************
+ * CLASS DEFINITION AND FUNCTION DECLARATIONS
+ *****************************************************************************/
+/**
+ * @brief Run a launch: the projectile starts at rest at (LAUNCH_X0,
+ * LAUNCH_Y0, LAUNCH_Z0) and is pushed until tl along the prototype's launch
+ * vector, the position rotated by a yaw of -pi/2 (due east), while the rail
+ * carries its weight. It then coasts under gravity until tf, or until it
+ * falls back to the surface.
+ * @param scenario The launch parameters
+ * @param result The outcome
+ * @return tensor_status SUCCESS or FAILURE
+ */
+tensor_status run_launch_scenario(const launch_scenario &scenario,
+                                  launch_result &result);
+
+#endif /* LAUNCH_SIM_H */
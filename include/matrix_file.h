@@ -0,0 +1,89 @@
+/**
+* @file matrix_file.h
+*
+* @brief A versioned binary file format for a single matrix, saved and loaded
+* as raw elements, or mapped into memory as a tensor view
+*
+* @author Pavlo Vlastos
+*/
+
+#ifndef MATRIX_FILE_H
+#define MATRIX_FILE_H
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "tensor.h"
+
+/******************************************************************************
+ * DEFINES
+ *****************************************************************************/
+#define MATRIX_FILE_MAGIC "AEROMAT" /* Seven characters and the terminator */
+#define MATRIX_FILE_VERSION 1
+#define MATRIX_FILE_BYTE_ORDER 0x01020304 /* Reads back swapped if foreign */
+
+/******************************************************************************
+ * GLOBAL VARIABLES AND DATATYPES
+ *****************************************************************************/
+/* The type of the elements of a matrix file */
+enum class matrix_dtype : uint32_t
+{
+    FLOAT64 = 1 /* double, the only type a tensor holds */
+};
+
+/**
+ * The file is a header and the elements, row-major, row_stride elements
+ * from the start of one row to the next. The elements start at data_offset,
+ * a multiple of alignment bytes (a power of two, at least 8), so a mapped
+ * matrix is as aligned as a tensor's own storage.
+ */
+struct matrix_file_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order; /* MATRIX_FILE_BYTE_ORDER as written */
+    uint32_t dtype;      /* A matrix_dtype */
+    uint32_t rows;
+    uint32_t cols;
+    uint32_t row_stride;
+    uint32_t alignment;
+    uint32_t reserved_32;
+    uint64_t data_offset;
+    uint64_t reserved[2];
+};
+
+static_assert(sizeof(matrix_file_header) == TENSOR_ALIGNMENT,
+              "The elements start a cache line after the header");
+
+/******************************************************************************
+ * FUNCTION DECLARATIONS
+ *****************************************************************************/
+/**
+ * @brief Save a tensor (or a view) to a matrix file
+ * @param a The tensor
+ * @param path The path of the file, created or truncated
+ * @return tensor_status SUCCESS or FAILURE
+ */
+tensor_status save_tensor(const tensor &a, const char *path);
+
+/**
+ * @brief Load a matrix file into a tensor of its own storage
+ * @param path The path of the file
+ * @param a The tensor, resized to the matrix
+ * @return tensor_status SUCCESS or FAILURE
+ */
+tensor_status load_tensor(const char *path, tensor &a);
+
+/**
+ * @brief Map a matrix file and view its elements in place: nothing is read
+ * until an element is touched, a page at a time. The mapping is private, so
+ * the file is never written; writing to the view changes only the pages
+ * written, in memory. The view keeps the mapping alive, and its copies are
+ * ordinary tensors.
+ * @param path The path of the file
+ * @param a The tensor, made a view of the mapping
+ * @return tensor_status SUCCESS or FAILURE
+ */
+tensor_status map_tensor(const char *path, tensor &a);
+
+#endif /* MATRIX_FILE_H */
@@ -0,0 +1,170 @@
+/**
+* @file orbit.h
+*
+* @brief Symplectic (velocity-Verlet and Yoshida) propagation of particles in
+* Earth's gravity field, point-mass or with the J2 oblateness term
+*
+* @author Pavlo Vlastos
+*/
+
+#ifndef ORBIT_H
+#define ORBIT_H
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "tensor.h"
+#include "particle.h"
+#include "integrator.h"
+#include "constants.h"
+
+/******************************************************************************
+ * DEFINES
+ *****************************************************************************/
+#define ORBIT_DOF 6 /* Position and attitude coordinates of a particle */
+
+/******************************************************************************
+ * GLOBAL VARIABLES AND DATATYPES
+ *****************************************************************************/
+enum class gravity_model
+{
+    POINT_MASS = 0, /* mu / r^2 towards the Earth's center */
+    J2              /* Plus the oblateness of the Earth, about its z-axis */
+};
+
+enum class symplectic_method
+{
+    VELOCITY_VERLET = 0, /* Second order, one force evaluation per step */
+    YOSHIDA4             /* Fourth order, three force evaluations per step */
+};
+
+/******************************************************************************
+ * CLASS DEFINITION AND FUNCTION DECLARATIONS
+ *****************************************************************************/
+/**
+ * @brief The gravitational acceleration at a position, in Earth-Centered
+ * Earth-Fixed (ECEF) coordinates. The J2 field is symmetric about the z-axis,
+ * so the same expression holds in the inertial frame aligned with ECEF.
+ * @param model The gravity model
+ * @param r The position [3], in meters
+ * @param a The acceleration [3], in m / s^2
+ */
+void gravity_acceleration(gravity_model model, const double r[3],
+                          double a[3]);
+
+/**
+ * @brief The gravitational potential energy per unit mass at a position
+ * @param model The gravity model
+ * @param r The position [3], in meters
+ * @return The potential, in J / kg
+ */
+double gravity_potential(gravity_model model, const double r[3]);
+
+/**
+ * @brief Propagates a particle with a fixed step by a symplectic splitting:
+ * kicks of the velocities and rates by the forces, and drifts of the
+ * position and attitude by them. Under gravity alone the energy error stays
+ * bounded over any number of orbits instead of drifting.
+ *
+ * Additional forces (e.g. the accelerator) come from a force_function,
+ * evaluated at the kick times; they should not depend on the velocity for
+ * the splitting to stay symplectic. Stepping makes no heap allocations
+ * besides what the force function makes.
+ */
+class orbit_propagator
+{
+private:
+    gravity_model gravity;
+    symplectic_method method;
+    double dt;
+
+    double mass = 1.0;
+    double spin = 1.0; /* radius / moi, the tangent force to angular rate */
+
+    double t0 = 0.0;
+    unsigned long steps = 0;   /* Steps since set_particle() */
+    unsigned long t0_step = 0; /* The step at t0 */
+    double t = 0.0;            /* t0 + (steps - t0_step) * dt, drift free */
+
+    double q[ORBIT_DOF];    /* Position and attitude */
+    double v[ORBIT_DOF];    /* Velocity and angular rates */
+    double a[ORBIT_DOF];    /* Accelerations at q and t */
+    bool a_current = false; /* Whether a matches q and t */
+
+    force_function force; /* Optional forces besides gravity */
+    tensor state;         /* Scratch state and input, for force */
+    tensor u;
+
+    /* The accelerations at q and time t_eval */
+    tensor_status accelerate(double t_eval);
+
+    /* One kick-drift-kick velocity-Verlet step of size h, from time t_step */
+    tensor_status verlet(double t_step, double h);
+
+public:
+    /* Orbit propagator class constructor */
+    orbit_propagator(gravity_model gravity_in, symplectic_method method_in,
+                     double dt_in);
+
+    /**
+     * @brief Load the state, mass, radius and moi of a particle
+     * @param p The particle
+     * @param t_start The time of the particle state
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status set_particle(const particle &p, double t_start);
+
+    /**
+     * @brief Write the propagated state back into a particle
+     * @param p The particle
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status get_particle(particle &p) const;
+
+    /**
+     * @brief Advance the particle by one step
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status step(void);
+
+    /**
+     * @brief Advance the particle by whole steps until t_final is reached
+     * @param t_final The time to stop at (rounded up to a whole step)
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status propagate(double t_final);
+
+    /**************************************************************************
+     * Setters
+    **************************************************************************/
+    /**
+     * @brief Set the forces besides gravity, nullptr for none
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status set_force(const force_function &force_new);
+
+    /**
+     * @brief Set the step size
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status set_sample_time(double dt_new);
+
+    /**************************************************************************
+     * Getters
+    **************************************************************************/
+    inline double get_time(void) const { return t; }
+    inline unsigned long get_steps(void) const { return steps; }
+
+    /**
+     * @brief The distance from the center of the Earth, in meters
+     */
+    double get_radius(void) const;
+
+    /**
+     * @brief The orbital (kinetic plus gravitational) energy per unit mass,
+     * in J / kg, conserved under gravity alone
+     */
+    double get_specific_energy(void) const;
+};
+
+#endif /* ORBIT_H */
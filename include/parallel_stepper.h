@@ -0,0 +1,47 @@
+/**
+* @file parallel_stepper.h
+*
+* @brief Steps large particle populations across the threads of a pool
+*
+* @author Pavlo Vlastos
+*/
+
+#ifndef PARALLEL_STEPPER_H
+#define PARALLEL_STEPPER_H
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "particle.h"
+#include "particle_system.h"
+#include "thread_pool.h"
+
+/******************************************************************************
+ * DEFINES
+ *****************************************************************************/
+#define PARTICLE_GRAIN 256          /* Particle objects per stolen chunk */
+#define PARTICLE_SYSTEM_GRAIN 16384 /* SoA particles per stolen chunk */
+
+/******************************************************************************
+ * FUNCTION DECLARATIONS
+ *****************************************************************************/
+/**
+ * @brief Calls particle::update() on every particle, spread over the pool.
+ * Each particle only touches its own state and scratch, so the result is
+ * bit-for-bit the serial result for any number of threads.
+ * @param particles The particles to advance by one sample-time
+ * @param pool The threads to run on
+ * @return tensor_status SUCCESS or FAILURE
+ */
+tensor_status parallel_update(vector<particle> &particles, thread_pool &pool);
+
+/**
+ * @brief Calls particle_system::update() over index ranges spread over the
+ * pool, with the same bit-for-bit guarantee
+ * @param system The particles to advance by one sample-time
+ * @param pool The threads to run on
+ * @return tensor_status SUCCESS or FAILURE
+ */
+tensor_status parallel_update(particle_system &system, thread_pool &pool);
+
+#endif /* PARALLEL_STEPPER_H */
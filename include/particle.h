@@ -13,11 +13,26 @@
  * INCLUDES
  *****************************************************************************/
 #include "tensor.h"
+#include "sparse_tensor.h"
+#include "quaternion.h"
+#include "dynamics_model.h"
 
 /******************************************************************************
  * DEFINES
  *****************************************************************************/
-#define STATE_SIZE 12
+/* Below this squared half rotation angle per step, the exponential map is
+ * evaluated by its Taylor series (error under 1e-15) instead of sqrt/sin/cos */
+#define ATTITUDE_SERIES_LIMIT 0.0025
+
+/******************************************************************************
+ * GLOBAL VARIABLES AND DATATYPES
+ *****************************************************************************/
+/* How a particle represents and propagates its attitude */
+enum class attitude_mode
+{
+    EULER = 0, /* Yaw, pitch and roll in the state, integrated linearly */
+    QUATERNION /* A unit quaternion, propagated by the exponential map */
+};
 
 /******************************************************************************
  * CLASS DEFINITION AND FUNCTION DECLARATIONS
@@ -32,41 +47,47 @@ private:
     double moi = 2.0 * (mass * radius * radius) / 5.0; /* Moment of inertia */
 
     tensor state;      /* The particle state vector*/
-    tensor phi;        /* The discrete state transition, or dynamics matrix */
-    tensor gamma;      /* The input matrix */
     tensor u;          /* The input vector */
     tensor body_frame; /* Body-frame axes */
+    tensor next_state; /* Scratch destination, so update() never allocates */
+
+    /* The discrete state transition (phi) and input matrix (gamma), shared
+     * with every particle of the same sample-time, mass and radius */
+    shared_ptr<const dynamics_model> model;
+
+    attitude_mode mode = attitude_mode::EULER;
+    quaternion attitude;            /* Used in attitude_mode::QUATERNION */
+    bool body_frame_current = true; /* Whether body_frame matches attitude */
+
+    /**
+     * @brief Rotate the attitude quaternion through one step of body rates,
+     * q = q * exp(w * dt / 2), with w the mean of the rates before and after
+     * the step (exact for a constant torque about a fixed axis)
+     * @param before The state at the start of the step
+     * @param after The state at the end of the step
+    */
+    void propagate_attitude(const tensor &before, const tensor &after);
+
+    /**
+     * @brief Rotate the attitude quaternion by half a rotation vector,
+     * q = q * exp(h), h in the body x, y and z axes
+    */
+    void rotate_attitude(double hx, double hy, double hz);
+
+    /**
+     * @brief Switch to the shared dynamics_model, phi and gamma, for a
+     * sample-time and the current mass, radius and moment of inertia, and
+     * adopt that sample-time
+     * @param dt_new The sample-time
+     * @return tensor_status SUCCESS or FAILURE, leaving the model and dt as
+     * they were
+    */
+    tensor_status set_model(const double dt_new);
 
 public:
     /* Class constructor (Just one for now) */
     particle(const double x, const double y, const double z)
         : state(STATE_SIZE), // Initializer list
-          phi(vector<vector<double>>{
-              {1.0, 0.0, 0.0, dt, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0},
-              {0.0, 1.0, 0.0, 0.0, dt, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0},
-              {0.0, 0.0, 1.0, 0.0, 0.0, dt, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0},
-              {0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0},
-              {0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0},
-              {0.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0},
-              {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, dt, 0.0, 0.0},
-              {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, dt, 0.0},
-              {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, dt},
-              {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0},
-              {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0},
-              {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 1.0}}),
-          gamma(vector<vector<double>>{
-              {(dt * dt / mass), 0.0, 0.0, 0.0, 0.0, 0.0},
-              {0.0, (dt * dt / mass), 0.0, 0.0, 0.0, 0.0},
-              {0.0, 0.0, (dt * dt / mass), 0.0, 0.0, 0.0},
-              {(dt / mass), 0.0, 0.0, 0.0, 0.0, 0.0},
-              {0.0, (dt / mass), 0.0, 0.0, 0.0, 0.0},
-              {0.0, 0.0, (dt / mass), 0.0, 0.0, 0.0},
-              {0.0, 0.0, 0.0, (radius * dt * dt / moi), 0.0, 0.0, 0.0},
-              {0.0, 0.0, 0.0, 0.0, (radius * dt * dt / moi), 0.0, 0.0},
-              {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, (radius * dt * dt / moi)},
-              {0.0, 0.0, 0.0, (radius * dt / moi), 0.0, 0.0, 0.0},
-              {0.0, 0.0, 0.0, 0.0, (radius * dt / moi), 0.0, 0.0},
-              {0.0, 0.0, 0.0, 0.0, 0.0, (radius * dt / moi)}}),
           u(vector<vector<double>>{
               {0.0},
               {0.0},
@@ -77,56 +98,64 @@ public:
           body_frame(vector<vector<double>>{
               {1.0, 0.0, 0.0},
               {0.0, 1.0, 0.0},
-              {0.0, 0.0, 1.0}})
+              {0.0, 0.0, 1.0}}),
+          next_state(STATE_SIZE)
     {
+        /* Discretize the dynamics for the default sample-time and mass */
+        set_model(dt);
+
         /* Position */
-        state.content[0][0] = x; // x
-        state.content[1][0] = y; // y
-        state.content[2][0] = z; // z
+        state(0, 0) = x; // x
+        state(1, 0) = y; // y
+        state(2, 0) = z; // z
 
         /* Velocity */
-        state.content[3][0] = 0.0; // dx
-        state.content[4][0] = 0.0; // dy
-        state.content[5][0] = 0.0; // dz
+        state(3, 0) = 0.0; // dx
+        state(4, 0) = 0.0; // dy
+        state(5, 0) = 0.0; // dz
 
         /* Angular Orientation */
         /* Orientation in *SOME* reference frame @TODO: figure out which 
          * reference frame. I think it is inertial technically, but this might
          * be assignable in relation to another particle */
-        state.content[6][0] = 0.0; // yaw: radians
-        state.content[7][0] = 0.0; // pitch: radians
-        state.content[8][0] = 0.0; // roll: radians
+        state(6, 0) = 0.0; // yaw: radians
+        state(7, 0) = 0.0; // pitch: radians
+        state(8, 0) = 0.0; // roll: radians
 
         /* Angular Rates */
-        state.content[9][0] = 0.0;  // yaw-rate: radians per second
-        state.content[10][0] = 0.0; // pitch-rate: radians per second
-        state.content[11][0] = 0.0; // roll-rate: radians per second
+        state(9, 0) = 0.0;  // yaw-rate: radians per second
+        state(10, 0) = 0.0; // pitch-rate: radians per second
+        state(11, 0) = 0.0; // roll-rate: radians per second
     }
 
     /**
      * @brief Updates the state of the particle, based on the input force
      * member. Make sure to call set_u() before calling this method/function
+     * @note Computes state = phi * state + gamma * u into a preallocated
+     * scratch tensor and swaps it in, so a step makes no heap allocations.
+     * Only the non-zeros of phi and gamma are visited. In
+     * attitude_mode::QUATERNION the attitude quaternion is propagated from
+     * the body rates as well, without any trigonometry for ordinary rates.
      * @return tensor_status SUCCESS or FAILURE
     */
     tensor_status update(void);
 
-    /**************************************************************************
-     * Setters
-    **************************************************************************/
-    /**
-     * @brief Set the state transition tensor, phi 
-     * @param dt The sample-time
-     * @return tensor_status SUCCESS or FAILURE
-    */
-    tensor_status set_phi(const double dt);
-
     /**
-     * @brief Set the input tensor, gamma 
-     * @param dt The sample-time
+     * @brief Advances the particle by k sample-times under the current input
+     * force, the same as k calls of update() but in O(log k) work
+     * @note Applies the model's cached jumps of 2^j steps for the bits j of
+     * k (see dynamics_model::jump()). In attitude_mode::QUATERNION the body
+     * rates are constant without a tangent force, so the attitude turns by
+     * a single exponential map; with a tangent force the rotation axis can
+     * drift, and the particle is stepped by update() instead.
+     * @param k The number of sample-times to advance
      * @return tensor_status SUCCESS or FAILURE
     */
-    tensor_status set_gamma(const double dt);
+    tensor_status advance(unsigned long k);
 
+    /**************************************************************************
+     * Setters
+    **************************************************************************/
     /**
      * @brief Set the input tensor, gamma 
      * @note Any force on a particle is broken up into the normal and tangent
@@ -174,12 +203,38 @@ public:
 
     /**
      * @brief Sets the sample-time of the particle. This is also meant for
-     * dynamic sample-times in case of time dilation 
+     * dynamic sample-times in case of time dilation. Phi and gamma switch to
+     * the model for the new sample-time in the same call.
      * @param dt_new The new sample time
      * @return tensor_status SUCCESS or FAILURE
     */
     tensor_status set_sample_time(double dt_new);
 
+    /**
+     * @brief Choose how the attitude is represented. Switching to
+     * attitude_mode::QUATERNION starts from the yaw, pitch and roll in the
+     * state; switching back writes the quaternion's Euler angles into it.
+     * @param mode_new The attitude mode
+     * @return tensor_status SUCCESS or FAILURE
+    */
+    tensor_status set_attitude_mode(attitude_mode mode_new);
+
+    /**
+     * @brief Set the attitude quaternion (attitude_mode::QUATERNION only)
+     * @param q The attitude, normalized before use
+     * @return tensor_status SUCCESS or FAILURE
+    */
+    tensor_status set_attitude(const quaternion &q);
+
+    /**
+     * @brief Set the full state of the particle, e.g. after integrating it
+     * outside of update(). In attitude_mode::QUATERNION the attitude is reset
+     * from the yaw, pitch and roll in the state.
+     * @param state_new A [STATE_SIZE x 1] tensor
+     * @return tensor_status SUCCESS or FAILURE
+    */
+    tensor_status set_state(const tensor &state_new);
+
     /**************************************************************************
      * Getters
     **************************************************************************/
@@ -187,7 +242,31 @@ public:
      * @brief Gets the state of the particle
      * @return the state vector of the particle as a tensor object
      */
-    tensor get_state(void);
+    tensor get_state(void) const;
+
+    /**
+     * @brief Gets the attitude of the particle, whatever the attitude mode
+     * @return The unit quaternion of the attitude
+     */
+    quaternion get_attitude(void);
+
+    /**
+     * @brief Gets the body-frame axes, the DCM of the attitude. It is only
+     * rebuilt when the attitude has changed since it was last read.
+     * @return The body-frame axes [3 x 3], one axis per row
+     */
+    const tensor &get_body_frame(void);
+
+    /**
+     * @brief Gets the discrete dynamics model the particle steps with
+     * @return The shared, immutable model
+     */
+    shared_ptr<const dynamics_model> get_model(void) const;
+
+    inline double get_mass(void) const { return mass; }
+    inline double get_radius(void) const { return radius; }
+    inline double get_moi(void) const { return moi; }
+    inline double get_sample_time(void) const { return dt; }
 
     /**
      * @brief Print out the attributes of the particle
@@ -0,0 +1,226 @@
+/**
+* @file particle_system.h
+*
+* @brief A structure-of-arrays container that steps many particles at once
+*
+* @author Pavlo Vlastos
+*/
+
+#ifndef PARTICLE_SYSTEM_H
+#define PARTICLE_SYSTEM_H
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "particle.h"
+
+/******************************************************************************
+ * CLASS DEFINITION AND FUNCTION DECLARATIONS
+ *****************************************************************************/
+/**
+ * @brief Stores component s of every particle's state contiguously
+ * (states[s][i] is component s of particle i), so one sweep over the arrays
+ * advances the whole population with unit-stride, SIMD friendly loops. The
+ * dynamics are those of particle::update(): a double integrator per axis
+ * driven by the normal forces (translation) and tangent forces (rotation).
+ */
+class particle_system
+{
+private:
+    double dt = 0.001;
+    unsigned int count = 0;
+
+    aligned_buffer states[STATE_SIZE]; /* State components, one array each */
+    aligned_buffer inputs[INPUT_SIZE]; /* Input components, one array each */
+
+    aligned_buffer masses;
+    aligned_buffer radii;
+    aligned_buffer mois; /* Moments of inertia */
+
+    /* Input gains of the discrete model, derived from dt, mass, radius and
+     * moi, i.e. the non-zero entries of each particle's gamma */
+    aligned_buffer linear_position_gain;  /* dt * dt / (2 * mass) */
+    aligned_buffer linear_velocity_gain;  /* dt / mass */
+    aligned_buffer angular_position_gain; /* radius * dt * dt / (2 * moi) */
+    aligned_buffer angular_velocity_gain; /* radius * dt / moi */
+
+    /* Recompute the input gains of particle i from its dynamics_model */
+    tensor_status update_gains(unsigned int i);
+
+public:
+    particle_system(void) {}
+
+    /* Particle system class constructor overloaded, reserving capacity */
+    particle_system(unsigned int capacity)
+    {
+        reserve(capacity);
+    }
+
+    /**
+     * @brief Reserve storage for a number of particles
+     * @param capacity The number of particles to reserve storage for
+     */
+    void reserve(unsigned int capacity);
+
+    /**
+     * @brief Add a particle at rest, with unit mass and radius
+     * @param x The x-coordinate of the new particle
+     * @param y The y-coordinate of the new particle
+     * @param z The z-coordinate of the new particle
+     * @return The index of the new particle
+     */
+    unsigned int add_particle(const double x, const double y, const double z);
+
+    /**
+     * @brief The number of particles in the system
+     */
+    inline unsigned int size(void) const { return count; }
+
+    /**
+     * @brief Advances every particle by one sample-time, based on the input
+     * force of each particle
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status update(void);
+
+    /**
+     * @brief Advances the particles [begin, end) by one sample-time
+     * @param begin The index of the first particle to advance
+     * @param end One past the index of the last particle to advance
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status update(unsigned int begin, unsigned int end);
+
+    /**
+     * @brief Advances every particle by k sample-times under its current
+     * input force, the same as k calls of update() in a single sweep
+     * @param k The number of sample-times to advance
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status advance(unsigned long k);
+
+    /**
+     * @brief Advances the particles [begin, end) by k sample-times
+     * @param begin The index of the first particle to advance
+     * @param end One past the index of the last particle to advance
+     * @param k The number of sample-times to advance
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status advance(unsigned int begin, unsigned int end,
+                          unsigned long k);
+
+    /**************************************************************************
+     * Raw component access, for kernels that sweep the whole population
+    **************************************************************************/
+    /**
+     * @brief The contiguous array holding state component s of every particle
+     * @param s The state component [0, STATE_SIZE)
+     */
+    inline double *state_component(unsigned int s)
+    {
+        return states[s].data();
+    }
+
+    inline const double *state_component(unsigned int s) const
+    {
+        return states[s].data();
+    }
+
+    /**
+     * @brief The contiguous array holding input component s of every particle
+     * @param s The input component [0, INPUT_SIZE)
+     */
+    inline double *input_component(unsigned int s)
+    {
+        return inputs[s].data();
+    }
+
+    inline const double *input_component(unsigned int s) const
+    {
+        return inputs[s].data();
+    }
+
+    /**
+     * @brief The contiguous array of every particle's mass
+     */
+    inline const double *mass_component(void) const
+    {
+        return masses.data();
+    }
+
+    /**
+     * @brief The contiguous array of every particle's radius
+     */
+    inline const double *radius_component(void) const
+    {
+        return radii.data();
+    }
+
+    /**************************************************************************
+     * Setters
+    **************************************************************************/
+    /**
+     * @brief Set the full state of particle i
+     * @param i The particle index
+     * @param state A [STATE_SIZE x 1] tensor
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status set_state(unsigned int i, const tensor &state);
+
+    /**
+     * @brief Set the input forces of particle i, see particle::set_u()
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status set_u(unsigned int i, const double fnx, const double fny,
+                        const double fnz, const double ftx, const double fty,
+                        const double ftz);
+
+    /**
+     * @brief Set the mass of particle i, updating its moment of inertia
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status set_mass(unsigned int i, const double mass);
+
+    /**
+     * @brief Set the radius of particle i, updating its moment of inertia
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status set_radius(unsigned int i, const double radius);
+
+    /**
+     * @brief Set the mass and radius of particle i as a solid sphere
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status set_moi(unsigned int i, const double mass,
+                          const double radius);
+
+    /**
+     * @brief Sets the sample-time shared by every particle in the system
+     * @param dt_new The new sample time
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status set_sample_time(double dt_new);
+
+    /**************************************************************************
+     * Getters
+    **************************************************************************/
+    /**
+     * @brief Gets the state of particle i
+     * @param i The particle index
+     * @param state A [STATE_SIZE x 1] tensor to copy the state into
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status get_state(unsigned int i, tensor &state) const;
+
+    inline double get_mass(unsigned int i) const { return masses[i]; }
+    inline double get_radius(unsigned int i) const { return radii[i]; }
+    inline double get_moi(unsigned int i) const { return mois[i]; }
+    inline double get_sample_time(void) const { return dt; }
+
+    /**
+     * @brief Print out the attributes of particle i
+     */
+    void print(unsigned int i) const;
+};
+
+#endif /* PARTICLE_SYSTEM_H */
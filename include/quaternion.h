@@ -0,0 +1,255 @@
+/**
+* @file quaternion.h
+*
+* @brief A value-type attitude quaternion, q = w + x i + y j + z k, with its
+* algebra and its conversions to and from Euler angles and Direction Cosine
+* Matrices (DCMs)
+*
+* The DCM of a quaternion is the same passive (frame) rotation that
+* create_dcm() builds from Euler angles:
+*
+*     [ w^2+x^2-y^2-z^2   2(xy+wz)          2(xz-wy)        ]
+*     [ 2(xy-wz)          w^2-x^2+y^2-z^2   2(yz+wx)        ]
+*     [ 2(xz+wy)          2(yz-wx)          w^2-x^2-y^2+z^2 ]
+*
+* so euler_to_quaternion() and create_dcm() agree, and composing frame
+* rotations follows the Hamilton product: dcm(multiply(p, q)) =
+* dcm(q) * dcm(p), i.e. rotate by p first, then by q.
+*
+* @author Pavlo Vlastos
+*/
+
+#ifndef QUATERNION_H
+#define QUATERNION_H
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "tensor.h"
+#include "fixed_tensor.h"
+#include "rotation.h"
+#include <math.h>
+
+/******************************************************************************
+ * DEFINES
+ *****************************************************************************/
+/* Below this |1 - |q|^2| one Newton step, 1/sqrt(n) ~ (3 - n) / 2, is exact
+ * to double precision, so normalize() skips the square root and division */
+#define QUATERNION_FAST_NORMALIZE_TOLERANCE 2.107342e-08
+
+/* Above this cosine of the half angle between two quaternions, slerp() falls
+ * back to a normalized linear interpolation */
+#define QUATERNION_SLERP_LINEAR_THRESHOLD 0.9995
+
+/******************************************************************************
+ * CLASS DEFINITION AND FUNCTION DECLARATIONS
+ *****************************************************************************/
+class quaternion
+{
+public:
+    double w; /* Scalar part */
+    double x; /* Vector part, i */
+    double y; /* Vector part, j */
+    double z; /* Vector part, k */
+
+    /* Quaternion class constructor, the identity rotation */
+    quaternion(void) : w(1.0), x(0.0), y(0.0), z(0.0) {}
+
+    /* Quaternion class constructor overloaded, from its four components */
+    quaternion(double w_in, double x_in, double y_in, double z_in)
+        : w(w_in), x(x_in), y(y_in), z(z_in) {}
+
+    /* Quaternion class constructor overloaded, from a 4x1 tensor laid out
+     * [w, x, y, z] (the identity if the dimensions do not match) */
+    explicit quaternion(const tensor &q) : quaternion()
+    {
+        from_tensor(q);
+    }
+
+    /**
+     * @brief Copy the components of a 4x1 tensor laid out [w, x, y, z]
+     * @param q A tensor [4 x 1]
+     * @return Tensor status (SUCCESS or FAILURE on a dimension mismatch)
+    */
+    tensor_status from_tensor(const tensor &q);
+
+    /**
+     * @brief Copy this quaternion into a 4x1 tensor laid out [w, x, y, z]
+     * @return A new tensor [4 x 1]
+    */
+    tensor to_tensor(void) const;
+
+    /**
+     * @brief print the quaternion
+    */
+    void print(void) const;
+};
+
+/**
+ * @brief The Hamilton product p * q
+ * @param p The first (left) quaternion
+ * @param q The second (right) quaternion
+ * @return The product p * q
+ */
+inline quaternion multiply(const quaternion &p, const quaternion &q)
+{
+    return quaternion(p.w * q.w - p.x * q.x - p.y * q.y - p.z * q.z,
+                      p.w * q.x + p.x * q.w + p.y * q.z - p.z * q.y,
+                      p.w * q.y - p.x * q.z + p.y * q.w + p.z * q.x,
+                      p.w * q.z + p.x * q.y - p.y * q.x + p.z * q.w);
+}
+
+/**
+ * @brief The conjugate, which for a unit quaternion is also its inverse
+ */
+inline quaternion conjugate(const quaternion &q)
+{
+    return quaternion(q.w, -q.x, -q.y, -q.z);
+}
+
+/**
+ * @brief The (Euclidean) norm of a quaternion
+ */
+inline double norm(const quaternion &q)
+{
+    return sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+}
+
+/**
+ * @brief Scale a quaternion to unit norm. Quaternions that have only drifted
+ * slightly (e.g. after an integration step) are rescaled without a square
+ * root.
+ * @param q A non-zero quaternion
+ * @return The unit quaternion along q
+ */
+inline quaternion normalize(const quaternion &q)
+{
+    const double n = q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z;
+    const double scale = (fabs(1.0 - n) < QUATERNION_FAST_NORMALIZE_TOLERANCE)
+                             ? 0.5 * (3.0 - n)
+                             : 1.0 / sqrt(n);
+
+    return quaternion(q.w * scale, q.x * scale, q.y * scale, q.z * scale);
+}
+
+/**
+ * @brief Rotate a 3-vector without building a matrix, giving the same result
+ * as multiplying by the DCM of q: r = v - w t + u x t, where u is the vector
+ * part of q and t = 2 u x v
+ * @param q A unit quaternion
+ * @param v The vector [3]
+ * @param r The rotated vector [3], which may be v
+ */
+inline void rotate(const quaternion &q, const double v[3], double r[3])
+{
+    const double t0 = 2.0 * (q.y * v[2] - q.z * v[1]);
+    const double t1 = 2.0 * (q.z * v[0] - q.x * v[2]);
+    const double t2 = 2.0 * (q.x * v[1] - q.y * v[0]);
+
+    const double r0 = v[0] - q.w * t0 + (q.y * t2 - q.z * t1);
+    const double r1 = v[1] - q.w * t1 + (q.z * t0 - q.x * t2);
+    const double r2 = v[2] - q.w * t2 + (q.x * t1 - q.y * t0);
+
+    r[0] = r0;
+    r[1] = r1;
+    r[2] = r2;
+}
+
+/**
+ * @brief Spherical linear interpolation along the shorter arc
+ * @param q0 The unit quaternion at t = 0
+ * @param q1 The unit quaternion at t = 1
+ * @param t The interpolation parameter, [0, 1]
+ * @return The unit quaternion at t
+ */
+quaternion slerp(const quaternion &q0, const quaternion &q1, double t);
+
+/**
+ * @brief Convert Euler angles, in the convention of create_dcm(), to a unit
+ * quaternion
+ * @param psi Yaw rotation angle value in radians
+ * @param theta Pitch rotation angle value in radians
+ * @param phi Roll rotation angle value in radians
+ * @return The unit quaternion of the same rotation
+ */
+quaternion euler_to_quaternion(double psi, double theta, double phi);
+
+/**
+ * @brief Convert a unit quaternion to Euler angles, in the convention of
+ * create_dcm()
+ * @param q A unit quaternion
+ * @param psi Yaw rotation angle in radians, (-pi, pi]
+ * @param theta Pitch rotation angle in radians, [-pi/2, pi/2]
+ * @param phi Roll rotation angle in radians, (-pi, pi]
+ */
+void quaternion_to_euler(const quaternion &q, double &psi, double &theta,
+                         double &phi);
+
+/**
+ * @brief The DCM of a unit quaternion
+ * @param q A unit quaternion
+ * @param dcm The DCM (all elements overwritten)
+ * @return Tensor status (SUCCESS or FAILURE)
+ */
+tensor_status quaternion_to_dcm(const quaternion &q, fixed_tensor<3, 3> &dcm);
+
+/**
+ * @brief The unit quaternion of a DCM, by Shepperd's method: the largest of
+ * w^2, x^2, y^2 and z^2 is found from the trace and diagonal and divided
+ * into the others, so the conversion stays accurate for any rotation
+ * @param dcm A DCM
+ * @return The unit quaternion of the DCM, with w >= 0
+ */
+quaternion dcm_to_quaternion(const fixed_tensor<3, 3> &dcm);
+
+/**
+ * @brief The unit quaternion of a DCM held in a tensor
+ * @param dcm A DCM [3 x 3]
+ * @param q The unit quaternion of the DCM, with w >= 0
+ * @return Tensor status (SUCCESS or FAILURE)
+ */
+tensor_status dcm_to_quaternion(const tensor &dcm, quaternion &q);
+
+/******************************************************************************
+ * Batch (structure-of-arrays) variants, one component per array, so each loop
+ * is a straight-line expression over contiguous doubles
+ *****************************************************************************/
+/**
+ * @brief Hamilton products of n pairs, r[i] = p[i] * q[i]
+ * @return Tensor status (SUCCESS or FAILURE)
+ */
+tensor_status multiply_batch(const double *pw, const double *px,
+                             const double *py, const double *pz,
+                             const double *qw, const double *qx,
+                             const double *qy, const double *qz,
+                             unsigned int n, double *rw, double *rx,
+                             double *ry, double *rz);
+
+/**
+ * @brief Normalize n quaternions in place
+ * @return Tensor status (SUCCESS or FAILURE)
+ */
+tensor_status normalize_batch(double *w, double *x, double *y, double *z,
+                              unsigned int n);
+
+/**
+ * @brief Convert n Euler angle triples to unit quaternions
+ * @return Tensor status (SUCCESS or FAILURE)
+ */
+tensor_status euler_to_quaternion_batch(const double *psi,
+                                        const double *theta,
+                                        const double *phi, unsigned int n,
+                                        double *w, double *x, double *y,
+                                        double *z);
+
+/**
+ * @brief The DCMs of n unit quaternions
+ * @param dcms The DCMs [DCM_SIZE * n], row-major and back to back, ready for
+ * rotate_points()
+ * @return Tensor status (SUCCESS or FAILURE)
+ */
+tensor_status quaternion_to_dcm_batch(const double *w, const double *x,
+                                      const double *y, const double *z,
+                                      unsigned int n, double *dcms);
+
+#endif /* QUATERNION_H */
@@ -0,0 +1,93 @@
+/**
+* @file rotation.h
+*
+* @brief Batched construction of Direction Cosine Matrices (DCMs) and rotation
+* of large point sets, for moving whole sensor frames between body and
+* inertial axes at once
+*
+* @author Pavlo Vlastos
+*/
+
+#ifndef ROTATION_H
+#define ROTATION_H
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "tensor.h"
+#include "fixed_tensor.h"
+
+/******************************************************************************
+ * DEFINES
+ *****************************************************************************/
+#define DCM_SIZE 9         /* Elements of one row-major 3x3 DCM */
+#define ROTATION_BLOCK 256 /* Angles whose sines/cosines are staged at once */
+
+/* Beyond this magnitude the polynomial sincos hands over to the C library,
+ * whose argument reduction stays exact for any angle */
+#define SINCOS_MAX_ARGUMENT 1.0e5
+
+/******************************************************************************
+ * FUNCTION DECLARATIONS
+ *****************************************************************************/
+/**
+ * @brief The sines and cosines of n angles, vectorized when the CPU has
+ * AVX2/FMA. Accurate to a couple of ulp.
+ * @param x The angles in radians [n]
+ * @param n The number of angles
+ * @param s The sines [n], which must not overlap x or c
+ * @param c The cosines [n], which must not overlap x or s
+ */
+void sincos_batch(const double *x, unsigned int n, double *s, double *c);
+
+/**
+ * @brief Create n DCMs in (yaw,pitch,roll) -> (ZXY) format, the same as
+ * create_dcm(), from arrays of Euler angles
+ * @param psi Yaw rotation angles in radians [n]
+ * @param theta Pitch rotation angles in radians [n]
+ * @param phi Roll rotation angles in radians [n]
+ * @param n The number of Euler angle triples
+ * @param dcms The DCMs [DCM_SIZE * n], row-major and back to back
+ * @return Tensor status (SUCCESS or FAILURE)
+ */
+tensor_status create_dcm_batch(const double *psi, const double *theta,
+                               const double *phi, unsigned int n,
+                               double *dcms);
+
+/**
+ * @brief Rotate a block of points by one DCM, rotated = dcm * points, or
+ * dcm^T * points when inverse is set
+ * @param dcm A DCM
+ * @param points The points [3 x n], one coordinate per row
+ * @param rotated The rotated points [3 x n], which must not be points
+ * @param inverse Rotate by the transpose (the opposite direction) instead
+ * @return Tensor status (SUCCESS or FAILURE)
+ */
+tensor_status rotate_points(const fixed_tensor<3, 3> &dcm,
+                            const tensor &points, tensor &rotated,
+                            bool inverse = false);
+
+/**
+ * @brief Rotate a block of points by one DCM held in a tensor
+ * @param dcm A DCM [3 x 3]
+ * @param points The points [3 x n], one coordinate per row
+ * @param rotated The rotated points [3 x n], which must not be points
+ * @param inverse Rotate by the transpose (the opposite direction) instead
+ * @return Tensor status (SUCCESS or FAILURE)
+ */
+tensor_status rotate_points(const tensor &dcm, const tensor &points,
+                            tensor &rotated, bool inverse = false);
+
+/**
+ * @brief Rotate each point by its own DCM, e.g. the attitude at the time it
+ * was sampled
+ * @param dcms The DCMs [DCM_SIZE * n], as produced by create_dcm_batch()
+ * @param points The points [3 x n], one coordinate per row
+ * @param rotated The rotated points [3 x n], which must not be points
+ * @param inverse Rotate by the transposes (the opposite direction) instead
+ * @return Tensor status (SUCCESS or FAILURE)
+ */
+tensor_status rotate_points(const double *dcms, const tensor &points,
+                            tensor &rotated, bool inverse = false);
+
+#endif /* ROTATION_H */
@@ -0,0 +1,137 @@
+/**
+* @file sparse_tensor.h
+*
+* @brief A compressed sparse row (CSR) tensor, for structured dynamics models
+* that are mostly zeros
+*
+* @author Pavlo Vlastos
+*/
+
+#ifndef SPARSE_TENSOR_H
+#define SPARSE_TENSOR_H
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "tensor.h"
+
+/******************************************************************************
+ * CLASS DEFINITION AND FUNCTION DECLARATIONS
+ *****************************************************************************/
+/**
+ * @brief The non-zeros of row i are values[row_start[i] .. row_start[i + 1]),
+ * in increasing column order, with their columns in the matching entries of
+ * columns
+ */
+class sparse_tensor
+{
+public:
+    unsigned int m_height; /* Number of rows*/
+    unsigned int n_width;  /* Number of columns*/
+
+    vector<unsigned int> row_start; /* m_height + 1 offsets into values */
+    vector<unsigned int> columns;   /* Column of each stored value */
+    vector<double> values;          /* Stored (non-zero) values */
+
+    /* Sparse tensor class constructor, all zeros */
+    sparse_tensor(unsigned int m_rows, unsigned int n_cols)
+    {
+        if (m_rows < 1)
+        { /* Check input number of rows */
+            m_rows = 1;
+        }
+
+        if (n_cols < 1)
+        { /* Check input number of columns */
+            n_cols = 1;
+        }
+
+        m_height = m_rows;
+        n_width = n_cols;
+        row_start.assign(m_rows + 1, 0);
+    }
+
+    /* Sparse tensor class constructor overloaded, keeping the non-zeros of a
+     * dense tensor */
+    sparse_tensor(const tensor &a)
+    {
+        from_tensor(a);
+    }
+
+    /**
+     * @brief Replace the contents with the non-zeros of a dense tensor
+     * @param a A dense tensor
+     * @return Tensor status (SUCCESS or FAILURE)
+    */
+    tensor_status from_tensor(const tensor &a);
+
+    /**
+     * @brief Expand into a dense tensor
+     * @return A dense tensor with the same dimensions and contents
+    */
+    tensor to_tensor(void) const;
+
+    /**
+     * @brief The number of stored (non-zero) elements
+    */
+    inline unsigned int non_zeros(void) const
+    {
+        return (unsigned int)values.size();
+    }
+
+    /**
+     * @brief print the tensor
+    */
+    void print(void) const;
+};
+
+/**
+ * @brief multiply a sparse tensor with a dense tensor
+ * @param a A sparse tensor [m x k]
+ * @param b A dense tensor [k x n]
+ * @return c A new dense tensor [m x n], being the matrix product of a and b.
+ */
+tensor multiply(const sparse_tensor &a, const tensor &b);
+
+/**
+ * @brief multiply a sparse tensor with a dense tensor into a preallocated
+ * tensor
+ * @param a A sparse tensor [m x k]
+ * @param b A dense tensor [k x n]
+ * @param c The destination [m x n], which must not share storage with b
+ * @return Tensor status (SUCCESS or FAILURE)
+ */
+tensor_status multiply(const sparse_tensor &a, const tensor &b, tensor &c);
+
+/**
+ * @brief add a sparse tensor to a dense tensor
+ * @param a A sparse tensor
+ * @param b A dense tensor of the same dimensions
+ * @return c A new dense tensor, being the matrix addition of a and b.
+ */
+tensor add(const sparse_tensor &a, const tensor &b);
+
+/**
+ * @brief add a sparse tensor to a dense tensor into a preallocated tensor
+ * @param a A sparse tensor
+ * @param b A dense tensor of the same dimensions
+ * @param c The destination, which may be b
+ * @return Tensor status (SUCCESS or FAILURE)
+ */
+tensor_status add(const sparse_tensor &a, const tensor &b, tensor &c);
+
+/**
+ * @brief Computes the fused state update y = a * x + b * u in place, paying
+ * only for the non-zeros of a and b
+ * @param a A sparse tensor [m x n], e.g. the state transition matrix
+ * @param x A column vector [n x 1], e.g. the state
+ * @param b A sparse tensor [m x p], e.g. the input matrix
+ * @param u A column vector [p x 1], e.g. the input
+ * @param y The destination [m x 1], which must not share storage with x or u
+ * @return Tensor status (SUCCESS or FAILURE)
+ */
+tensor_status multiply_add(const sparse_tensor &a, const tensor &x,
+                           const sparse_tensor &b, const tensor &u,
+                           tensor &y);
+
+#endif /* SPARSE_TENSOR_H */
@@ -0,0 +1,143 @@
+/**
+* @file spatial_hash.h
+*
+* @brief Contact detection between spherical particles: a spatial-hash grid
+* as the broad phase and sphere-sphere tests as the narrow phase
+*
+* @author Pavlo Vlastos
+*/
+
+#ifndef SPATIAL_HASH_H
+#define SPATIAL_HASH_H
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "tensor.h"
+#include "particle_system.h"
+#include "thread_pool.h"
+#include <stdint.h>
+
+/******************************************************************************
+ * DEFINES
+ *****************************************************************************/
+#define SPATIAL_HASH_GRAIN 4096 /* Bodies per stolen chunk of a query */
+#define SPATIAL_HASH_LOAD 2     /* Buckets per body, rounded up to 2^k */
+
+/******************************************************************************
+ * GLOBAL VARIABLES AND DATATYPES
+ *****************************************************************************/
+/* Two overlapping spheres, a < b */
+struct contact
+{
+    unsigned int a;
+    unsigned int b;
+    double depth; /* Overlap, the sum of the radii less the distance */
+};
+
+/******************************************************************************
+ * CLASS DEFINITION AND FUNCTION DECLARATIONS
+ *****************************************************************************/
+/**
+ * @brief A uniform grid of cubic cells, stored sparsely: each cell hashes to
+ * one of a power-of-two number of buckets, and a counting sort lays the
+ * bodies out bucket by bucket, so building is linear in the body count.
+ *
+ * The cells are at least as wide as the largest sphere, so two spheres can
+ * only touch when their cells are neighbors. A query visits the 27 cells
+ * around each body (the candidates) and keeps the pairs that overlap (the
+ * contacts). It can run over a thread pool, and reports the same contacts in
+ * the same order for any number of threads.
+ */
+class spatial_hash
+{
+private:
+    double cell_size = 0.0;   /* Zero to follow the largest sphere */
+    double cell_in_use = 0.0; /* The cell size of the current grid */
+    unsigned int n = 0;
+    uint64_t mask = 0; /* Bucket count - 1 */
+
+    /* The bodies of the grid, valid until the next build */
+    const double *x = nullptr;
+    const double *y = nullptr;
+    const double *z = nullptr;
+    const double *r = nullptr;
+
+    vector<int64_t> cells;             /* Cell coordinates, 3 per body */
+    vector<unsigned int> bucket_start; /* Bucket b is sorted[start[b]..] */
+    vector<unsigned int> sorted;       /* Bodies, bucket by bucket */
+    vector<uint64_t> body_bucket;      /* Bucket of each body */
+
+    /* Contacts of each chunk of a parallel query, joined in chunk order */
+    vector<vector<contact>> chunk_contacts;
+
+    unsigned long candidates = 0;
+
+    /* The bucket of a cell */
+    inline uint64_t bucket(int64_t cx, int64_t cy, int64_t cz) const
+    {
+        return (((uint64_t)cx * 73856093ULL) ^ ((uint64_t)cy * 19349663ULL) ^
+                ((uint64_t)cz * 83492791ULL)) &
+               mask;
+    }
+
+    /* Contacts of bodies [begin, end) with higher numbered bodies */
+    unsigned long query_range(unsigned int begin, unsigned int end,
+                              vector<contact> &found) const;
+
+public:
+    /* Spatial hash class constructor */
+    spatial_hash(void) {}
+
+    /**
+     * @brief Lay out a grid over n spheres. The arrays are read again by
+     * query(), so they must stay unchanged until then.
+     * @param x_in The x-coordinates of the centers [n]
+     * @param y_in The y-coordinates of the centers [n]
+     * @param z_in The z-coordinates of the centers [n]
+     * @param r_in The radii [n]
+     * @param n_in The number of spheres
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status build(const double *x_in, const double *y_in,
+                        const double *z_in, const double *r_in,
+                        unsigned int n_in);
+
+    /**
+     * @brief Lay out a grid over the particles of a system, by their
+     * positions and radii
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status build(const particle_system &system);
+
+    /**
+     * @brief Find every pair of overlapping spheres of the grid
+     * @param contacts The contacts, replaced, in order of a
+     * @param pool Threads to query on, or nullptr to run serially
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status query(vector<contact> &contacts,
+                        thread_pool *pool = nullptr);
+
+    /**************************************************************************
+     * Setters
+    **************************************************************************/
+    /**
+     * @brief Set the cell size, zero to follow the diameter of the largest
+     * sphere. A size below that diameter is raised to it at the next build.
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status set_cell_size(double cell_size_new);
+
+    /**************************************************************************
+     * Getters
+    **************************************************************************/
+    inline double get_cell_size(void) const { return cell_in_use; }
+
+    /**
+     * @brief The pairs in neighboring cells the last query tested
+     */
+    inline unsigned long get_candidates(void) const { return candidates; }
+};
+
+#endif /* SPATIAL_HASH_H */
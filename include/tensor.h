@@ -14,9 +14,12 @@
  * INCLUDES
  *****************************************************************************/
 #include <vector>
+#include <memory>
 #include <stdint.h>
+#include <stddef.h>
 #include <iostream>
 #include <string.h>
+#include <new>
 #include "config.h"
 
 using namespace std;
@@ -24,6 +27,7 @@ using namespace std;
  * DEFINES
  *****************************************************************************/
 #define SPLOT_VEC_SIZE 6
+#define TENSOR_ALIGNMENT 64 /* Byte alignment of tensor buffers (cache line) */
 
 /******************************************************************************
  * GLOBAL VARIABLES AND DATATYPES
@@ -34,6 +38,49 @@ enum class tensor_status
     FAILURE
 };
 
+/**
+ * @brief Minimal allocator handing out over-aligned blocks, so tensor buffers
+ * start on a cache line and can be fed straight to SIMD kernels
+ */
+template <typename T, size_t alignment>
+struct aligned_allocator
+{
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind
+    {
+        typedef aligned_allocator<U, alignment> other;
+    };
+
+    aligned_allocator(void) noexcept {}
+
+    template <typename U>
+    aligned_allocator(const aligned_allocator<U, alignment> &) noexcept {}
+
+    T *allocate(size_t n)
+    {
+        return static_cast<T *>(
+            ::operator new(n * sizeof(T), align_val_t(alignment)));
+    }
+
+    void deallocate(T *p, size_t) noexcept
+    {
+        ::operator delete(p, align_val_t(alignment));
+    }
+};
+
+template <typename T, typename U, size_t alignment>
+bool operator==(const aligned_allocator<T, alignment> &,
+                const aligned_allocator<U, alignment> &) { return true; }
+
+template <typename T, typename U, size_t alignment>
+bool operator!=(const aligned_allocator<T, alignment> &,
+                const aligned_allocator<U, alignment> &) { return false; }
+
+typedef vector<double, aligned_allocator<double, TENSOR_ALIGNMENT>>
+    aligned_buffer;
+
 /******************************************************************************
  * CLASS DEFINITION AND FUNCTION DECLARATIONS
  *****************************************************************************/
@@ -42,15 +89,14 @@ class tensor
 private:
     uint8_t dimension = 3;
 
-public:
-    unsigned int m_height; /* Number of rows*/
-    unsigned int n_width;  /* Number of columns*/
-    vector<vector<double>> content;
+    aligned_buffer elements; /* Row-major element storage, unless a view */
+    double *base = nullptr;  /* The first element, in elements or viewed */
+    shared_ptr<void> owner;  /* Keeps the memory of a view alive */
+    unsigned int row_stride; /* Elements between the starts of two rows */
 
-    tensor(unsigned int m_rows, unsigned int n_cols)
+    /* Allocate zeroed, contiguous storage for an m x n tensor */
+    void allocate(unsigned int m_rows, unsigned int n_cols)
     {
-        vector<double> rows;
-
         if (m_rows < 1)
         { /* Check input number of rows */
             m_rows = 1;
@@ -61,70 +107,160 @@ public:
             n_cols = 1;
         }
 
-        for (unsigned int i_col = 0; i_col < n_cols; i_col++)
-        {
-            rows.push_back(0.0);
-        }
-        for (unsigned int i_row = 0; i_row < m_rows; i_row++)
+        m_height = m_rows;
+        n_width = n_cols;
+        row_stride = n_cols;
+        elements.assign((size_t)m_rows * row_stride, 0.0);
+        base = elements.data();
+        owner.reset();
+    }
+
+    /* Tensor class constructor for a view, see view() */
+    tensor(double *data, unsigned int m_rows, unsigned int n_cols,
+           unsigned int stride, shared_ptr<void> keep_alive)
+        : base(data), owner(move(keep_alive)), row_stride(stride),
+          m_height(m_rows), n_width(n_cols) {}
+
+    /* Copy the elements of a, of the same dimensions, row by row */
+    void copy_elements(const tensor &a)
+    {
+        for (unsigned int row = 0; row < m_height; row++)
         {
-            content.push_back(rows);
+            memcpy(base + (size_t)row * row_stride,
+                   a.base + (size_t)row * a.row_stride,
+                   n_width * sizeof(double));
         }
+    }
+
+public:
+    unsigned int m_height; /* Number of rows*/
+    unsigned int n_width;  /* Number of columns*/
 
-        m_height = content.size();
-        n_width = content[0].size();
+    tensor(unsigned int m_rows, unsigned int n_cols)
+    {
+        allocate(m_rows, n_cols);
     }
 
     /* Tensor class constructor overloaded */
     tensor(unsigned int m_rows)
     {
-        vector<double> rows;
+        allocate(m_rows, 1); // One column
+    }
 
-        /* Check input number of rows */
-        if (m_rows < 1)
+    /* Tensor class copy constructor, always copying the elements (also of
+     * a view) into storage of its own */
+    tensor(const tensor &a)
+    {
+        allocate(a.m_height, a.n_width);
+        copy_elements(a);
+    }
+
+    /* Tensor class move constructor, taking over the storage (or view) */
+    tensor(tensor &&a) noexcept
+        : dimension(a.dimension), elements(move(a.elements)), base(a.base),
+          owner(move(a.owner)), row_stride(a.row_stride),
+          m_height(a.m_height), n_width(a.n_width)
+    {
+        a.base = nullptr;
+    }
+
+    tensor &operator=(const tensor &a)
+    {
+        if (this != &a)
         {
-            m_rows = 1;
+            if (is_view() || (m_height != a.m_height) ||
+                (n_width != a.n_width))
+            {
+                allocate(a.m_height, a.n_width);
+            }
+            copy_elements(a);
         }
+        return *this;
+    }
 
-        rows.push_back(0.0); // One column
-
-        for (unsigned int i_row = 0; i_row < m_rows; i_row++)
+    tensor &operator=(tensor &&a) noexcept
+    {
+        if (this != &a)
         {
-            content.push_back(rows);
+            dimension = a.dimension;
+            elements = move(a.elements);
+            base = a.base;
+            owner = move(a.owner);
+            row_stride = a.row_stride;
+            m_height = a.m_height;
+            n_width = a.n_width;
+            a.base = nullptr;
         }
+        return *this;
+    }
 
-        m_height = content.size();
-        n_width = content[0].size();
+    /**
+     * @brief A tensor over memory it does not own, e.g. a mapped file,
+     * without copying it. Copies of a view are ordinary tensors.
+     * @param data The first element, row-major
+     * @param m_rows The number of rows
+     * @param n_cols The number of columns
+     * @param stride The number of elements between the starts of two rows
+     * @param keep_alive Owns the memory, held for as long as the view is
+     * @return The view
+    */
+    static tensor view(double *data, unsigned int m_rows,
+                       unsigned int n_cols, unsigned int stride,
+                       shared_ptr<void> keep_alive)
+    {
+        return tensor(data, m_rows, n_cols, stride, move(keep_alive));
     }
 
+    /**
+     * @brief Whether the tensor views memory it does not own
+    */
+    inline bool is_view(void) const { return base != elements.data(); }
+
     /* Tensor class constructor overloaded */
     tensor(const vector<vector<double>> &v)
     {
-        vector<double> rows;
-
         unsigned int m_rows = v.size();
         unsigned int n_cols = v[0].size();
 
-        for (unsigned int i_col = 0; i_col < n_cols; i_col++)
-        {
-            rows.push_back(0.0);
-        }
-        for (unsigned int i_row = 0; i_row < m_rows; i_row++)
-        {
-            content.push_back(rows);
-        }
+        allocate(m_rows, n_cols);
 
         for (unsigned int i_row = 0; i_row < m_rows; i_row++)
         {
             for (unsigned int i_col = 0; i_col < n_cols; i_col++)
             {
-                content[i_row][i_col] = v[i_row][i_col];
+                (*this)(i_row, i_col) = v[i_row][i_col];
             }
         }
+    }
+
+    /**
+     * @brief Element access, row-major
+     * @param row The row of the element
+     * @param col The column of the element
+     * @return A reference to the element (no bounds checking)
+    */
+    inline double &operator()(unsigned int row, unsigned int col)
+    {
+        return base[(size_t)row * row_stride + col];
+    }
 
-        m_height = content.size();
-        n_width = content[0].size();
+    inline const double &operator()(unsigned int row, unsigned int col) const
+    {
+        return base[(size_t)row * row_stride + col];
     }
 
+    /**
+     * @brief Raw access to the first element of the tensor buffer. Element
+     * (row, col) lives at data()[row * stride() + col]
+    */
+    inline double *data(void) { return base; }
+    inline const double *data(void) const { return base; }
+
+    /**
+     * @brief The number of elements between the starts of consecutive rows
+    */
+    inline unsigned int stride(void) const { return row_stride; }
+
     /**
      * @brief set a the value of a tensor element
      * @param row The row of the tensor where the elemement value will be set
@@ -181,6 +317,48 @@ tensor multiply(const tensor &a, const tensor &b);
  */
 tensor add(const tensor &a, const tensor &b);
 
+/**
+ * @brief multiply two tensors together into a preallocated tensor
+ * @param a A tensor [m x k]
+ * @param b Another tensor [k x n]
+ * @param c The destination [m x n], which must not share storage with a or b
+ * @return Tensor status (SUCCESS or FAILURE)
+ */
+tensor_status multiply(const tensor &a, const tensor &b, tensor &c);
+
+/**
+ * @brief add two tensors together into a preallocated tensor
+ * @param a A tensor
+ * @param b Another tensor of the same dimensions
+ * @param c The destination, which may be a or b
+ * @return Tensor status (SUCCESS or FAILURE)
+ */
+tensor_status add(const tensor &a, const tensor &b, tensor &c);
+
+/**
+ * @brief Computes y = alpha * a * x + beta * y in place
+ * @param alpha Scale applied to the product a * x
+ * @param a A tensor [m x n]
+ * @param x A tensor [n x p], usually a column vector
+ * @param beta Scale applied to y before accumulating (0.0 overwrites y)
+ * @param y The destination [m x p], which must not share storage with x
+ * @return Tensor status (SUCCESS or FAILURE)
+ */
+tensor_status gemv(double alpha, const tensor &a, const tensor &x,
+                   double beta, tensor &y);
+
+/**
+ * @brief Computes the fused state update y = a * x + b * u in place
+ * @param a A tensor [m x n], e.g. the state transition matrix
+ * @param x A column vector [n x 1], e.g. the state
+ * @param b A tensor [m x p], e.g. the input matrix
+ * @param u A column vector [p x 1], e.g. the input
+ * @param y The destination [m x 1], which must not share storage with x or u
+ * @return Tensor status (SUCCESS or FAILURE)
+ */
+tensor_status multiply_add(const tensor &a, const tensor &x, const tensor &b,
+                           const tensor &u, tensor &y);
+
 /**
  * @brief Makes a copy of the immediate tensor
  * @return copy of the immediate tensor
@@ -192,8 +370,26 @@ tensor copy(const tensor &a);
  */
 tensor transpose(const tensor &a);
 
+/**
+ * @brief Inverts a square tensor through an LU factorization with partial
+ * pivoting. To solve against many right-hand sides, keep an lu_factorization
+ * (factorization.h) instead of forming the inverse.
+ * @param a A square tensor
+ * @param a_inv A preallocated tensor of the same dimensions for the inverse
+ * @return Tensor status (SUCCESS, or FAILURE if a is singular, leaving
+ * a_inv as it was)
+ */
 tensor_status invert(const tensor &a, tensor &a_inv);
 
+/**
+ * @brief Computes the matrix exponential e^a by a degree 13 Pade approximant
+ * with scaling and squaring (Higham, 2005)
+ * @param a A square tensor
+ * @param e_a A preallocated tensor of the same dimensions for e^a
+ * @return Tensor status (SUCCESS or FAILURE)
+ */
+tensor_status expm(const tensor &a, tensor &e_a);
+
 /**
  * @brief Performs gaussian elimination to row reduce tensor to upper
  * triangular form.
@@ -245,10 +441,23 @@ tensor_status create_dcm(double psi, double theta, double phi, tensor &dcm);
 
 /**
  * @brief Convert Euler angle to a quaternion
+ * @param psi Yaw rotation angle value in radians
+ * @param theta Pitch rotation angle value in radians
+ * @param phi Roll rotation angle value in radians
+ * @param q A tensor [4 x 1] for the unit quaternion, laid out [w, x, y, z]
+ * @return Tensor status (SUCCESS or FAILURE)
 */
 tensor_status euler_to_quaternion(double psi, double theta, double phi,
                                   tensor &q);
-// tensor_status quaternion_to_dcm();
+
+/**
+ * @brief Convert a quaternion to a Direction Cosine Matrix (DCM), the same
+ * one create_dcm() makes from the matching Euler angles
+ * @param q A unit quaternion [4 x 1], laid out [w, x, y, z]
+ * @param dcm A tensor [3 x 3] that will be converted to a dcm
+ * @return Tensor status (SUCCESS or FAILURE)
+*/
+tensor_status quaternion_to_dcm(const tensor &q, tensor &dcm);
 
 /******************************************************************************
  * Conversion Functions for Plotting with GNU with .dat files
@@ -256,14 +465,16 @@ tensor_status euler_to_quaternion(double psi, double theta, double phi,
 /**
  * @brief Convert a tensor of rank 1 to .dat format dot for gnuplot
  * @param a A tensor, either [3x1] or [1x3]
- * @param 
+ * @param d The line "x y z \r\n", each value to 6 decimals
+ * @note For whole point sets, dat_emitter (dat_emitter.h) is much faster
 */
 tensor_status tensor_to_gnuplot_dot(tensor &a, string &d);
 
 /**
  * @brief Convert a tensor of rank 1 to .dat format vector for gnuplot
- * @param a A tensor, either [3x1] or [1x3]
- * @param 
+ * @param a A tensor, either [6x1] or [1x6]: the position x, y, z of the
+ * vector, then its components dx, dy, dz
+ * @param v The line "x y z dx dy dz \r\n", each value to 6 decimals
 */
 tensor_status tensor_to_gnuplot_vec(tensor &a, string &v);
 
@@ -0,0 +1,115 @@
+/**
+* @file thread_pool.h
+*
+* @brief A work-stealing thread pool for running index ranges in parallel
+*
+* @author Pavlo Vlastos
+*/
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "tensor.h"
+
+/******************************************************************************
+ * GLOBAL VARIABLES AND DATATYPES
+ *****************************************************************************/
+/**
+ * @brief A task run over the index range [begin, end). The worker index is in
+ * [0, thread_pool::size()) and is unique among concurrently running tasks, so
+ * it can select per-thread scratch buffers without any locking.
+ */
+typedef function<void(unsigned int begin, unsigned int end,
+                      unsigned int worker)>
+    range_task;
+
+/******************************************************************************
+ * CLASS DEFINITION AND FUNCTION DECLARATIONS
+ *****************************************************************************/
+class thread_pool
+{
+private:
+    /* A chunk of a parallel_for, with the task it belongs to */
+    struct range
+    {
+        unsigned int begin;
+        unsigned int end;
+        const range_task *task;
+    };
+
+    /* Each worker pops from the back of its own queue and steals from the
+     * front of the others' */
+    struct worker_queue
+    {
+        mutex lock;
+        deque<range> ranges;
+    };
+
+    vector<thread> workers;
+    vector<unique_ptr<worker_queue>> queues;
+
+    mutex job_lock;
+    condition_variable job_ready;
+    condition_variable job_done;
+    unsigned long job_generation = 0;
+    bool stopping = false;
+
+    atomic<unsigned int> remaining_ranges;
+    atomic<bool> task_failed;
+
+    /* Body of the background threads */
+    void worker_loop(unsigned int worker);
+
+    /* Run ranges, own queue first then stolen ones, until none are left */
+    void drain(unsigned int worker);
+
+    bool pop(unsigned int worker, range &r);
+    bool steal(unsigned int thief, range &r);
+
+public:
+    /**
+     * @brief Start a pool
+     * @param n_threads The number of threads, including the one calling
+     * parallel_for(). Zero selects the hardware concurrency.
+     */
+    thread_pool(unsigned int n_threads = 0);
+
+    /* Stops and joins the background threads */
+    ~thread_pool(void);
+
+    thread_pool(const thread_pool &) = delete;
+    thread_pool &operator=(const thread_pool &) = delete;
+
+    /**
+     * @brief The number of threads (and distinct worker indices) in the pool
+     */
+    inline unsigned int size(void) const
+    {
+        return (unsigned int)queues.size();
+    }
+
+    /**
+     * @brief Split [begin, end) into chunks of at most grain indices and run
+     * task over every chunk, returning once all of them are done. The calling
+     * thread works as worker 0. Must not be called from inside a task.
+     * @param begin The first index
+     * @param end One past the last index
+     * @param grain The largest chunk handed to a task at once
+     * @param task The task to run over each chunk
+     * @return tensor_status SUCCESS, or FAILURE if a task threw
+     */
+    tensor_status parallel_for(unsigned int begin, unsigned int end,
+                               unsigned int grain, const range_task &task);
+};
+
+#endif /* THREAD_POOL_H */
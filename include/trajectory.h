@@ -0,0 +1,237 @@
+/**
+* @file trajectory.h
+*
+* @brief A chunked, columnar binary format for recording particle
+* trajectories, written by large buffered writes and read back through a
+* memory map as zero-copy tensor views
+*
+* @author Pavlo Vlastos
+*/
+
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "tensor.h"
+#include "particle.h"
+#include "particle_system.h"
+#include "dat_emitter.h"
+
+/******************************************************************************
+ * DEFINES
+ *****************************************************************************/
+#define TRAJECTORY_MAGIC "AEROTRJ" /* Seven characters and the terminator */
+#define TRAJECTORY_VERSION 1
+#define TRAJECTORY_CHUNK_ROWS 65536 /* Rows buffered before each write */
+#define TRAJECTORY_ROW_ALIGN 16     /* Columns padded to 16 rows, 64 bytes */
+
+/******************************************************************************
+ * GLOBAL VARIABLES AND DATATYPES
+ *****************************************************************************/
+/**
+ * The file is a header and a sequence of chunks. A chunk is a chunk header
+ * and its columns, one after another, each padded to a multiple of
+ * TRAJECTORY_ROW_ALIGN rows: the time of each row (double), the STATE_SIZE
+ * state components (double), and the particle id (uint32_t). Everything
+ * starts on a 64 byte boundary, so a mapped column is as aligned as a
+ * tensor's own storage.
+ */
+struct trajectory_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t state_size;
+    uint64_t rows;   /* Rows in all chunks, filled in when closed */
+    uint64_t chunks; /* Number of chunks, filled in when closed */
+    uint64_t reserved[4];
+};
+
+struct trajectory_chunk_header
+{
+    uint64_t rows;
+    uint64_t padded_rows; /* The length of each column */
+    uint64_t reserved[6];
+};
+
+/* Byte alignment of the aligned buffers of the format */
+typedef vector<uint8_t, aligned_allocator<uint8_t, TENSOR_ALIGNMENT>>
+    byte_buffer;
+
+/******************************************************************************
+ * CLASS DEFINITION AND FUNCTION DECLARATIONS
+ *****************************************************************************/
+/**
+ * @brief Records rows of (time, particle id, state) into a trajectory file.
+ * Rows are gathered column by column into a chunk in memory, and each full
+ * chunk goes to the file in a single write, so recording costs a copy per
+ * value rather than any formatting.
+ */
+class trajectory_writer
+{
+private:
+    int fd = -1;
+    byte_buffer chunk; /* The chunk being filled, laid out as in the file */
+    unsigned long capacity = 0;
+    unsigned long rows = 0; /* Rows in the chunk being filled */
+    uint64_t total_rows = 0;
+    uint64_t chunks = 0;
+
+    double *time_column(void);
+    double *state_column(unsigned int s);
+    uint32_t *id_column(void);
+
+    /* Write the chunk being filled, if it holds any rows */
+    tensor_status flush_chunk(void);
+
+public:
+    /* Trajectory writer class constructor */
+    trajectory_writer(void) {}
+
+    /* Trajectory writer class destructor, closing the file */
+    ~trajectory_writer(void);
+
+    trajectory_writer(const trajectory_writer &) = delete;
+    trajectory_writer &operator=(const trajectory_writer &) = delete;
+
+    /**
+     * @brief Create (or truncate) a trajectory file
+     * @param path The path of the file
+     * @param chunk_rows The rows buffered before each write, rounded up to a
+     * multiple of TRAJECTORY_ROW_ALIGN
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status open(const char *path,
+                       unsigned long chunk_rows = TRAJECTORY_CHUNK_ROWS);
+
+    /**
+     * @brief Write the last chunk and the final header, and close the file
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status close(void);
+
+    /**
+     * @brief Record one row
+     * @param t The time
+     * @param id The particle id
+     * @param state The state [STATE_SIZE]
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status record(double t, uint32_t id, const double *state);
+
+    /**
+     * @brief Record the state of a particle
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status record(double t, uint32_t id, const particle &p);
+
+    /**
+     * @brief Record n particles stored column by column, particle i with id
+     * i, by copying whole runs of the columns
+     * @param columns The STATE_SIZE state components, each an array [n]
+     * @param n The number of particles
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status record(double t, const double *const *columns,
+                         unsigned int n);
+
+    /**
+     * @brief Record every particle of a system, particle i with id i
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status record(double t, const particle_system &system);
+
+    /**************************************************************************
+     * Getters
+    **************************************************************************/
+    inline uint64_t get_rows(void) const { return total_rows + rows; }
+    inline bool is_open(void) const { return fd >= 0; }
+};
+
+/**
+ * @brief Maps a trajectory file and hands out its columns as tensor views
+ * into the mapping, without copying or parsing them. The mapping is private:
+ * writing through a view changes the view, never the file. Views keep the
+ * mapping alive on their own, even after the reader is closed.
+ *
+ * A file whose writer never closed it (e.g. a crashed run) still reads back
+ * every chunk written completely.
+ */
+class trajectory_reader
+{
+private:
+    /* A chunk of the mapping */
+    struct chunk_info
+    {
+        uint8_t *columns; /* The time column, followed by the others */
+        uint64_t rows;
+        uint64_t padded_rows;
+    };
+
+    shared_ptr<void> mapping; /* Unmaps when the last view is gone */
+    size_t mapped_size = 0;
+    vector<chunk_info> chunks;
+    uint64_t total_rows = 0;
+
+public:
+    /* Trajectory reader class constructor */
+    trajectory_reader(void) {}
+
+    /**
+     * @brief Map a trajectory file and index its chunks
+     * @param path The path of the file
+     * @return tensor_status SUCCESS or FAILURE
+     */
+    tensor_status open(const char *path);
+
+    /**
+     * @brief Release the reader's hold on the mapping
+     */
+    void close(void);
+
+    /**
+     * @brief The time of each row of chunk c
+     * @return A view [rows x 1]
+     */
+    tensor time(unsigned int c) const;
+
+    /**
+     * @brief The states of chunk c, one row per state component
+     * @return A view [STATE_SIZE x rows]: element (s, r) is component s of
+     * row r
+     */
+    tensor states(unsigned int c) const;
+
+    /**
+     * @brief The particle id of each row of chunk c [rows]
+     */
+    const uint32_t *ids(unsigned int c) const;
+
+    /**************************************************************************
+     * Getters
+    **************************************************************************/
+    inline unsigned int get_chunks(void) const { return chunks.size(); }
+    inline uint64_t get_rows(void) const { return total_rows; }
+
+    inline uint64_t get_rows(unsigned int c) const
+    {
+        return chunks[c].rows;
+    }
+};
+
+/**
+ * @brief Convert a trajectory file to the .dat dots layout of
+ * simulation/gnuplot_dot, the position x y z of every row, one per line
+ * @param binary_path The trajectory file
+ * @param dat_path The .dat file to write
+ * @param precision Significant digits, or DAT_EMITTER_SHORTEST for the
+ * shortest text that reads back exactly
+ * @return tensor_status SUCCESS or FAILURE
+ */
+tensor_status trajectory_to_gnuplot(const char *binary_path,
+                                    const char *dat_path,
+                                    unsigned int precision =
+                                        DAT_EMITTER_SHORTEST);
+
+#endif /* TRAJECTORY_H */
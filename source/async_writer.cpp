@@ -0,0 +1,401 @@
+/**
+* @file async_writer.cpp
+*
+* @brief A background writer of particle states, fed by a lock-free single
+* producer, single consumer ring of preallocated frames
+*
+* @author Pavlo Vlastos
+*/
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "async_writer.h"
+#include <chrono>
+
+/******************************************************************************
+ * PRIVATE FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+void async_writer::drain(void)
+{
+    unsigned int idle = 0;
+
+    while (true)
+    {
+        const size_t t = tail.load(memory_order_relaxed);
+        size_t h = head.load(memory_order_acquire);
+
+        if (t == h)
+        {
+            /* Stopped only once the ring is empty after the last push */
+            if (stopping.load(memory_order_acquire))
+            {
+                h = head.load(memory_order_acquire);
+                if (t == h)
+                {
+                    return;
+                }
+                continue;
+            }
+
+            if (++idle < ASYNC_WRITER_SPINS)
+            {
+                this_thread::yield();
+            }
+            else
+            {
+                this_thread::sleep_for(
+                    chrono::microseconds(ASYNC_WRITER_IDLE_US));
+            }
+            continue;
+        }
+        idle = 0;
+
+        const double *columns = frames[t & mask].data();
+        state_frame frame;
+        frame.t = times[t & mask];
+        frame.count = particles;
+        for (unsigned int s = 0; s < STATE_SIZE; s++)
+        {
+            frame.columns[s] = columns + (size_t)s * particles;
+        }
+
+        for (const frame_sink &sink : sinks)
+        {
+            if (sink(frame) != tensor_status::SUCCESS)
+            {
+                failed.store(true, memory_order_relaxed);
+            }
+        }
+
+        /* Hands the frame back to the pushing thread */
+        tail.store(t + 1, memory_order_release);
+    }
+}
+
+/******************************************************************************
+ * PUBLIC FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+async_writer::async_writer(unsigned int particles_in, unsigned int frames_in,
+                           backpressure policy_in)
+    : particles(particles_in), policy(policy_in)
+{
+    size_t capacity = 1;
+    while (capacity < frames_in)
+    {
+        capacity <<= 1;
+    }
+    mask = capacity - 1;
+
+    frames.resize(capacity);
+    for (aligned_buffer &frame : frames)
+    {
+        frame.assign((size_t)STATE_SIZE * particles, 0.0);
+    }
+    times.assign(capacity, 0.0);
+}
+
+async_writer::~async_writer(void)
+{
+    stop();
+}
+
+tensor_status async_writer::add_sink(frame_sink sink)
+{
+    if (running || (sink == nullptr))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    sinks.push_back(sink);
+    return tensor_status::SUCCESS;
+}
+
+tensor_status async_writer::start(void)
+{
+    if (running)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    stopping.store(false, memory_order_relaxed);
+    failed.store(false, memory_order_relaxed);
+    writer = thread(&async_writer::drain, this);
+    running = true;
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status async_writer::push(double t, const particle_system &system)
+{
+    if (!running || (system.size() != particles))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    const size_t capacity = mask + 1;
+    const size_t h = head.load(memory_order_relaxed);
+    const unsigned long offered = pushed++;
+
+    if (policy == backpressure::DECIMATE)
+    {
+        /* Past half full, keep every factor-th frame, the factor doubling
+         * each time the free space halves */
+        const size_t free = capacity - (h - tail.load(memory_order_acquire));
+        unsigned long factor = 1;
+        while ((free > 0) && (free * factor * 2 < capacity))
+        {
+            factor <<= 1;
+        }
+
+        if ((free > 0) && (offered % factor != 0))
+        {
+            decimated++;
+            return tensor_status::SUCCESS;
+        }
+    }
+
+    while (h - tail.load(memory_order_acquire) == capacity)
+    {
+        if (policy != backpressure::BLOCK)
+        {
+            dropped++;
+            return tensor_status::SUCCESS;
+        }
+        this_thread::yield();
+    }
+
+    double *frame = frames[h & mask].data();
+    for (unsigned int s = 0; s < STATE_SIZE; s++)
+    {
+        memcpy(frame + (size_t)s * particles, system.state_component(s),
+               particles * sizeof(double));
+    }
+    times[h & mask] = t;
+
+    /* Hands the frame to the writer thread */
+    head.store(h + 1, memory_order_release);
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status async_writer::stop(void)
+{
+    if (!running)
+    {
+        return tensor_status::SUCCESS;
+    }
+
+    stopping.store(true, memory_order_release);
+    writer.join();
+    running = false;
+
+    return failed.load(memory_order_relaxed) ? tensor_status::FAILURE
+                                             : tensor_status::SUCCESS;
+}
+
+frame_sink binary_sink(shared_ptr<trajectory_writer> writer)
+{
+    return [writer](const state_frame &frame)
+    {
+        return writer->record(frame.t, frame.columns, frame.count);
+    };
+}
+
+frame_sink gnuplot_sink(shared_ptr<dat_emitter> dat)
+{
+    return [dat](const state_frame &frame)
+    {
+        return dat->emit_dots(frame.columns[0], frame.columns[1],
+                              frame.columns[2], frame.count);
+    };
+}
+
+/******************************************************************************
+ * UNIT TESTS
+ *****************************************************************************/
+#ifdef TESTING_ASYNC_WRITER
+
+#include <fstream>
+
+/* n particles drifting apart */
+static void build_cloud(particle_system &system, unsigned int n)
+{
+    system = particle_system(n);
+    for (unsigned int i = 0; i < n; i++)
+    {
+        system.add_particle((double)i, 0.0, 0.0);
+        system.set_u(i, 1.0, 0.5 * (i % 3), -0.25, 0.0, 0.0, 0.0);
+    }
+}
+
+/* Wall-clock seconds, as the writer's work overlaps the stepping */
+static double seconds_since(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start)
+        .count();
+}
+
+int main(void)
+{
+#ifdef TEST_ASYNC_WRITER_BLOCK
+    {
+        cout << "TEST_ASYNC_WRITER_BLOCK\r\n";
+        const unsigned int n = 10000;
+        const unsigned int steps = 200;
+        const char *sync_path = "../../simulation/trajectory.bin";
+        const char *async_path = "../../simulation/trajectory_async.bin";
+
+        /* Recording in the stepping loop */
+        particle_system system;
+        build_cloud(system, n);
+        trajectory_writer sync;
+        if (sync.open(sync_path) != tensor_status::SUCCESS)
+        {
+            cout << "Unable to open file\r\n";
+            return 1;
+        }
+        auto start = chrono::steady_clock::now();
+        for (unsigned int k = 0; k < steps; k++)
+        {
+            system.update();
+            sync.record(k * system.get_sample_time(), system);
+        }
+        sync.close();
+        double sync_seconds = seconds_since(start);
+
+        /* The same, handed to the writer thread */
+        build_cloud(system, n);
+        shared_ptr<trajectory_writer> file = make_shared<trajectory_writer>();
+        file->open(async_path);
+        async_writer writer(n, 16, backpressure::BLOCK);
+        writer.add_sink(binary_sink(file));
+        writer.start();
+
+        start = chrono::steady_clock::now();
+        double push_seconds = 0.0;
+        for (unsigned int k = 0; k < steps; k++)
+        {
+            system.update();
+            auto push_start = chrono::steady_clock::now();
+            writer.push(k * system.get_sample_time(), system);
+            push_seconds += seconds_since(push_start);
+        }
+        double loop_seconds = seconds_since(start);
+        writer.stop();
+        file->close();
+        double total_seconds = seconds_since(start);
+
+        trajectory_reader a;
+        trajectory_reader b;
+        a.open(sync_path);
+        b.open(async_path);
+        bool same = (a.get_rows() == b.get_rows()) &&
+                    (a.get_chunks() == b.get_chunks());
+        for (unsigned int c = 0; same && (c < a.get_chunks()); c++)
+        {
+            tensor xa = a.states(c);
+            tensor xb = b.states(c);
+            tensor ta = a.time(c);
+            tensor tb = b.time(c);
+            for (unsigned int r = 0; same && (r < xa.n_width); r++)
+            {
+                same = (ta(r, 0) == tb(r, 0));
+                for (unsigned int s = 0; same && (s < STATE_SIZE); s++)
+                {
+                    same = (xa(s, r) == xb(s, r));
+                }
+            }
+        }
+
+        cout << n << " particles x " << steps << " steps: recording in the "
+             << "loop " << sync_seconds << " s; async loop " << loop_seconds
+             << " s (pushes " << push_seconds << " s), flushed after "
+             << total_seconds << " s\r\n";
+        cout << "frames written = " << writer.get_written() << " of "
+             << writer.get_pushed() << ", same file contents = " << same
+             << "\r\n";
+    }
+#endif
+
+#ifdef TEST_ASYNC_WRITER_POLICIES
+    {
+        cout << "TEST_ASYNC_WRITER_POLICIES\r\n";
+        /* A sink far slower than the stepping, with each policy */
+        const unsigned int n = 100;
+        const unsigned int steps = 2000;
+        const backpressure policies[3] = {backpressure::BLOCK,
+                                          backpressure::DROP,
+                                          backpressure::DECIMATE};
+        const char *names[3] = {"BLOCK", "DROP", "DECIMATE"};
+
+        for (unsigned int p = 0; p < 3; p++)
+        {
+            particle_system system;
+            build_cloud(system, n);
+            async_writer writer(n, 8, policies[p]);
+
+            /* Records the frame times, to check they arrive in order */
+            vector<double> seen;
+            writer.add_sink([&seen](const state_frame &frame)
+                            {
+                                this_thread::sleep_for(
+                                    chrono::microseconds(20));
+                                seen.push_back(frame.t);
+                                return tensor_status::SUCCESS;
+                            });
+            writer.start();
+
+            for (unsigned int k = 0; k < steps; k++)
+            {
+                system.update();
+                writer.push((double)k, system);
+            }
+            writer.stop();
+
+            bool in_order = true;
+            for (size_t i = 1; i < seen.size(); i++)
+            {
+                in_order = in_order && (seen[i] > seen[i - 1]);
+            }
+            cout << names[p] << ": written " << writer.get_written()
+                 << " + dropped " << writer.get_dropped() << " + decimated "
+                 << writer.get_decimated() << " = "
+                 << (writer.get_written() + writer.get_dropped() +
+                     writer.get_decimated())
+                 << " of " << writer.get_pushed()
+                 << ", in order = " << in_order << "\r\n";
+        }
+
+        /* The positions of a few frames, as a gnuplot .dat */
+        particle_system system;
+        build_cloud(system, 4);
+        shared_ptr<dat_emitter> dat = make_shared<dat_emitter>();
+        dat->open("../../simulation/dots_async.dat");
+        async_writer writer(4);
+        writer.add_sink(gnuplot_sink(dat));
+        writer.start();
+        for (unsigned int k = 0; k < 3; k++)
+        {
+            system.advance(100);
+            writer.push(k, system);
+        }
+        writer.stop();
+        dat->close();
+
+        ifstream check("../../simulation/dots_async.dat");
+        string line;
+        string last;
+        unsigned int lines = 0;
+        while (getline(check, line))
+        {
+            last = line;
+            lines++;
+        }
+        cout << "gnuplot sink: " << lines << " lines, the last " << last
+             << "\r\n";
+    }
+#endif
+    return 0;
+}
+#endif
@@ -0,0 +1,578 @@
+/**
+* @file barnes_hut.cpp
+*
+* @brief Mutual gravity between particles in O(N log N) by a Barnes-Hut octree
+* over Morton (Z-order) sorted positions
+*
+* @author Pavlo Vlastos
+*/
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "barnes_hut.h"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+/******************************************************************************
+ * DEFINES
+ *****************************************************************************/
+#define MORTON_CELLS (1u << MORTON_BITS) /* Cells per axis */
+#define OCTANTS 8
+
+/* Deepest stack of a traversal: the unopened siblings on the way down */
+#define TRAVERSAL_STACK (MORTON_BITS * (OCTANTS - 1) + OCTANTS)
+
+/******************************************************************************
+ * PRIVATE FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+/**
+ * @brief Spread the low 21 bits of v three bits apart
+ */
+static inline uint64_t spread_bits(uint64_t v)
+{
+    v &= 0x1fffff;
+    v = (v | (v << 32)) & 0x1f00000000ffffULL;
+    v = (v | (v << 16)) & 0x1f0000ff0000ffULL;
+    v = (v | (v << 8)) & 0x100f00f00f00f00fULL;
+    v = (v | (v << 4)) & 0x10c30c30c30c30c3ULL;
+    v = (v | (v << 2)) & 0x1249249249249249ULL;
+    return v;
+}
+
+/**
+ * @brief The cell of a coordinate along one axis of the root cube
+ */
+static inline uint64_t quantize(double c, double origin, double scale)
+{
+    const double cell = (c - origin) * scale;
+
+    if (!(cell > 0.0))
+    {
+        return 0;
+    }
+    if (cell >= (double)(MORTON_CELLS - 1))
+    {
+        return MORTON_CELLS - 1;
+    }
+    return (uint64_t)cell;
+}
+
+void barnes_hut::sort_bodies(const double *x, const double *y,
+                             const double *z, unsigned int n)
+{
+    /* The root cube, around every body */
+    double lo[3] = {DBL_MAX, DBL_MAX, DBL_MAX};
+    double hi[3] = {-DBL_MAX, -DBL_MAX, -DBL_MAX};
+
+    for (unsigned int i = 0; i < n; i++)
+    {
+        lo[0] = fmin(lo[0], x[i]);
+        lo[1] = fmin(lo[1], y[i]);
+        lo[2] = fmin(lo[2], z[i]);
+        hi[0] = fmax(hi[0], x[i]);
+        hi[1] = fmax(hi[1], y[i]);
+        hi[2] = fmax(hi[2], z[i]);
+    }
+
+    root_size = fmax(fmax(hi[0] - lo[0], hi[1] - lo[1]), hi[2] - lo[2]);
+    if (root_size <= 0.0)
+    { /* A single body, or all of them in one place */
+        root_size = 1.0;
+    }
+    const double scale = MORTON_CELLS / root_size;
+
+    /* Bodies added or removed since the last call: start from scratch */
+    if (order.size() != n)
+    {
+        order.resize(n);
+        codes.resize(n);
+        for (unsigned int i = 0; i < n; i++)
+        {
+            order[i] = i;
+        }
+    }
+
+    for (unsigned int k = 0; k < n; k++)
+    {
+        const unsigned int i = order[k];
+        codes[k] = spread_bits(quantize(x[i], lo[0], scale)) |
+                   (spread_bits(quantize(y[i], lo[1], scale)) << 1) |
+                   (spread_bits(quantize(z[i], lo[2], scale)) << 2);
+    }
+
+    /* Insertion sort by (code, body): about linear when the bodies have
+     * moved little, and a unique order whatever the previous one was */
+    const unsigned long move_limit = (unsigned long)BARNES_HUT_RESORT_LIMIT * n;
+    unsigned long moves = 0;
+
+    for (unsigned int k = 1; (k < n) && (moves <= move_limit); k++)
+    {
+        const uint64_t code = codes[k];
+        const unsigned int body = order[k];
+        unsigned int j = k;
+
+        while ((j > 0) && ((codes[j - 1] > code) ||
+                           ((codes[j - 1] == code) && (order[j - 1] > body))))
+        {
+            codes[j] = codes[j - 1];
+            order[j] = order[j - 1];
+            j--;
+        }
+
+        codes[j] = code;
+        order[j] = body;
+        moves += k - j;
+    }
+
+    last_resort_moves = moves;
+
+    if (moves > move_limit)
+    { /* Too much has changed, sort from scratch */
+        keys.resize(n);
+        for (unsigned int k = 0; k < n; k++)
+        {
+            keys[k] = make_pair(codes[k], order[k]);
+        }
+
+        sort(keys.begin(), keys.end());
+
+        for (unsigned int k = 0; k < n; k++)
+        {
+            codes[k] = keys[k].first;
+            order[k] = keys[k].second;
+        }
+    }
+}
+
+void barnes_hut::gather_bodies(const double *x, const double *y,
+                               const double *z, const double *m,
+                               unsigned int n)
+{
+    sx.resize(n);
+    sy.resize(n);
+    sz.resize(n);
+    sm.resize(n);
+
+    for (unsigned int k = 0; k < n; k++)
+    {
+        const unsigned int i = order[k];
+        sx[k] = x[i];
+        sy[k] = y[i];
+        sz[k] = z[i];
+        sm[k] = m[i];
+    }
+}
+
+void barnes_hut::build(unsigned int i, unsigned int level)
+{
+    const unsigned int begin = nodes[i].begin;
+    const unsigned int end = nodes[i].end;
+
+    nodes[i].size = ldexp(root_size, -(int)level);
+    nodes[i].children = 0;
+
+    double mass = 0.0;
+    double mx = 0.0;
+    double my = 0.0;
+    double mz = 0.0;
+
+    if ((end - begin <= BARNES_HUT_LEAF_SIZE) || (level == MORTON_BITS))
+    { /* A leaf, its bodies summed directly */
+        for (unsigned int k = begin; k < end; k++)
+        {
+            mass += sm[k];
+            mx += sm[k] * sx[k];
+            my += sm[k] * sy[k];
+            mz += sm[k] * sz[k];
+        }
+    }
+    else
+    {
+        /* The sorted range splits into runs by the octant digit of level */
+        const unsigned int shift = 3 * (MORTON_BITS - 1 - level);
+        unsigned int bounds[OCTANTS + 1];
+        unsigned int children = 0;
+        unsigned int k = begin;
+
+        while (k < end)
+        {
+            const uint64_t digit = (codes[k] >> shift) & (OCTANTS - 1);
+            bounds[children++] = k;
+            while ((k < end) && (((codes[k] >> shift) & (OCTANTS - 1)) == digit))
+            {
+                k++;
+            }
+        }
+        bounds[children] = end;
+
+        const unsigned int first = nodes.size();
+        nodes.resize(first + children);
+        for (unsigned int c = 0; c < children; c++)
+        {
+            nodes[first + c].begin = bounds[c];
+            nodes[first + c].end = bounds[c + 1];
+        }
+
+        for (unsigned int c = 0; c < children; c++)
+        {
+            build(first + c, level + 1);
+
+            const node &child = nodes[first + c];
+            mass += child.mass;
+            mx += child.mass * child.x;
+            my += child.mass * child.y;
+            mz += child.mass * child.z;
+        }
+
+        nodes[i].first_child = first;
+        nodes[i].children = children;
+    }
+
+    nodes[i].mass = mass;
+    if (mass > 0.0)
+    {
+        nodes[i].x = mx / mass;
+        nodes[i].y = my / mass;
+        nodes[i].z = mz / mass;
+    }
+    else
+    { /* Massless bodies still need a position */
+        nodes[i].x = sx[begin];
+        nodes[i].y = sy[begin];
+        nodes[i].z = sz[begin];
+    }
+}
+
+void barnes_hut::accelerate(unsigned int b, double &ax, double &ay,
+                            double &az) const
+{
+    const double bx = sx[b];
+    const double by = sy[b];
+    const double bz = sz[b];
+    const double eps_sq = softening * softening;
+    const double theta_sq = theta * theta;
+
+    unsigned int stack[TRAVERSAL_STACK];
+    unsigned int top = 0;
+    stack[top++] = 0;
+
+    ax = 0.0;
+    ay = 0.0;
+    az = 0.0;
+
+    while (top > 0)
+    {
+        const node &nd = nodes[stack[--top]];
+        const double dx = nd.x - bx;
+        const double dy = nd.y - by;
+        const double dz = nd.z - bz;
+        const double d_sq = dx * dx + dy * dy + dz * dz;
+        const bool inside = (b >= nd.begin) && (b < nd.end);
+
+        if ((!inside) && (nd.size * nd.size < theta_sq * d_sq))
+        { /* Far enough to act as one mass at its center of mass */
+            const double r_sq = d_sq + eps_sq;
+            const double s = nd.mass / (r_sq * sqrt(r_sq));
+            ax += s * dx;
+            ay += s * dy;
+            az += s * dz;
+        }
+        else if (nd.children == 0)
+        {
+            for (unsigned int k = nd.begin; k < nd.end; k++)
+            {
+                const double ex = sx[k] - bx;
+                const double ey = sy[k] - by;
+                const double ez = sz[k] - bz;
+                const double r_sq = ex * ex + ey * ey + ez * ez + eps_sq;
+
+                if ((k != b) && (r_sq > 0.0))
+                {
+                    const double s = sm[k] / (r_sq * sqrt(r_sq));
+                    ax += s * ex;
+                    ay += s * ey;
+                    az += s * ez;
+                }
+            }
+        }
+        else
+        {
+            for (unsigned int c = 0; c < nd.children; c++)
+            {
+                stack[top++] = nd.first_child + c;
+            }
+        }
+    }
+}
+
+/******************************************************************************
+ * PUBLIC FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+tensor_status barnes_hut::compute(const double *x, const double *y,
+                                  const double *z, const double *m,
+                                  unsigned int n, double *fx, double *fy,
+                                  double *fz, thread_pool *pool)
+{
+    if (n == 0)
+    {
+        return tensor_status::SUCCESS;
+    }
+
+    if ((x == nullptr) || (y == nullptr) || (z == nullptr) ||
+        (m == nullptr) || (fx == nullptr) || (fy == nullptr) ||
+        (fz == nullptr))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    sort_bodies(x, y, z, n);
+    gather_bodies(x, y, z, m, n);
+
+    nodes.clear(); /* Keeps its capacity */
+    nodes.resize(1);
+    nodes[0].begin = 0;
+    nodes[0].end = n;
+    build(0, 0);
+
+    /* Each body only writes its own force */
+    range_task task = [&](unsigned int begin, unsigned int end, unsigned int)
+    {
+        for (unsigned int b = begin; b < end; b++)
+        {
+            double ax;
+            double ay;
+            double az;
+            accelerate(b, ax, ay, az);
+
+            const double s = g * sm[b];
+            const unsigned int i = order[b];
+            fx[i] = s * ax;
+            fy[i] = s * ay;
+            fz[i] = s * az;
+        }
+    };
+
+    if (pool == nullptr)
+    {
+        task(0, n, 0);
+        return tensor_status::SUCCESS;
+    }
+
+    return pool->parallel_for(0, n, BARNES_HUT_GRAIN, task);
+}
+
+tensor_status barnes_hut::compute(particle_system &system, thread_pool *pool)
+{
+    return compute(system.state_component(0), system.state_component(1),
+                   system.state_component(2), system.mass_component(),
+                   system.size(), system.input_component(0),
+                   system.input_component(1), system.input_component(2),
+                   pool);
+}
+
+/******************************************************************************
+ * Setters
+******************************************************************************/
+tensor_status barnes_hut::set_theta(double theta_new)
+{
+    if (theta_new < 0.0)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    theta = theta_new;
+    return tensor_status::SUCCESS;
+}
+
+tensor_status barnes_hut::set_softening(double softening_new)
+{
+    if (softening_new < 0.0)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    softening = softening_new;
+    return tensor_status::SUCCESS;
+}
+
+tensor_status barnes_hut::set_gravitational_constant(double g_new)
+{
+    if (g_new <= 0.0)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    g = g_new;
+    return tensor_status::SUCCESS;
+}
+
+/******************************************************************************
+ * UNIT TESTS
+ *****************************************************************************/
+#ifdef TESTING_BARNES_HUT
+
+#include <chrono>
+#include <random>
+
+/* A clustered cloud: a Plummer-like sphere of n bodies */
+static void build_cloud(particle_system &system, unsigned int n,
+                        unsigned int seed)
+{
+    mt19937 generator(seed);
+    uniform_real_distribution<double> uniform(0.0, 1.0);
+    normal_distribution<double> normal(0.0, 1.0);
+
+    system = particle_system(n);
+    for (unsigned int i = 0; i < n; i++)
+    {
+        double d[3] = {normal(generator), normal(generator),
+                       normal(generator)};
+        const double r = 1000.0 / sqrt(pow(uniform(generator), -2.0 / 3.0));
+        const double len = sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+        system.add_particle(r * d[0] / len, r * d[1] / len, r * d[2] / len);
+        system.set_mass(i, 1.0e6 * (1.0 + uniform(generator)));
+    }
+}
+
+/* The O(N^2) pairwise sum */
+static void direct_forces(const particle_system &system, double softening,
+                          vector<double> &f)
+{
+    const unsigned int n = system.size();
+    const double *x = system.state_component(0);
+    const double *y = system.state_component(1);
+    const double *z = system.state_component(2);
+    f.assign(3 * n, 0.0);
+
+    for (unsigned int i = 0; i < n; i++)
+    {
+        for (unsigned int j = 0; j < n; j++)
+        {
+            if (i == j)
+            {
+                continue;
+            }
+            const double dx = x[j] - x[i];
+            const double dy = y[j] - y[i];
+            const double dz = z[j] - z[i];
+            const double r_sq = dx * dx + dy * dy + dz * dz +
+                                softening * softening;
+            const double s = GRAVITATIONAL_CONSTANT * system.get_mass(i) *
+                             system.get_mass(j) / (r_sq * sqrt(r_sq));
+            f[3 * i] += s * dx;
+            f[3 * i + 1] += s * dy;
+            f[3 * i + 2] += s * dz;
+        }
+    }
+}
+
+int main(void)
+{
+#ifdef TEST_BARNES_HUT_ACCURACY
+    {
+        cout << "TEST_BARNES_HUT_ACCURACY\r\n";
+        const unsigned int n = 4000;
+        particle_system system;
+        build_cloud(system, n, 1);
+
+        vector<double> exact;
+        auto start = chrono::steady_clock::now();
+        direct_forces(system, 1.0, exact);
+        chrono::duration<double> direct_time =
+            chrono::steady_clock::now() - start;
+
+        const double thetas[4] = {0.0, 0.3, 0.5, 0.8};
+        for (unsigned int t = 0; t < 4; t++)
+        {
+            barnes_hut tree;
+            tree.set_theta(thetas[t]);
+            tree.set_softening(1.0);
+            start = chrono::steady_clock::now();
+            tree.compute(system);
+            chrono::duration<double> tree_time =
+                chrono::steady_clock::now() - start;
+
+            double error_sq = 0.0;
+            double norm_sq = 0.0;
+            for (unsigned int i = 0; i < n; i++)
+            {
+                for (unsigned int a = 0; a < 3; a++)
+                {
+                    const double e = system.input_component(a)[i] -
+                                     exact[3 * i + a];
+                    error_sq += e * e;
+                    norm_sq += exact[3 * i + a] * exact[3 * i + a];
+                }
+            }
+            cout << "theta = " << thetas[t] << ": relative RMS error = "
+                 << sqrt(error_sq / norm_sq) << ", " << tree_time.count()
+                 << " s (direct " << direct_time.count() << " s)\r\n";
+        }
+    }
+#endif
+
+#ifdef TEST_BARNES_HUT_INCREMENTAL
+    {
+        cout << "TEST_BARNES_HUT_INCREMENTAL\r\n";
+        /* The cloud falls in on itself; each step re-sorts the last order */
+        const unsigned int n = 100000;
+        particle_system system;
+        build_cloud(system, n, 2);
+        system.set_sample_time(10.0);
+        barnes_hut tree;
+        tree.set_softening(10.0);
+
+        for (unsigned int step = 0; step < 4; step++)
+        {
+            auto start = chrono::steady_clock::now();
+            tree.compute(system);
+            chrono::duration<double> elapsed =
+                chrono::steady_clock::now() - start;
+            system.update();
+            cout << "step " << step << ": " << elapsed.count() << " s, "
+                 << tree.get_node_count() << " nodes, re-sort moves = "
+                 << tree.get_resort_moves() << "\r\n";
+        }
+    }
+#endif
+
+#ifdef TEST_BARNES_HUT_PARALLEL
+    {
+        cout << "TEST_BARNES_HUT_PARALLEL\r\n";
+        const unsigned int n = 100000;
+        particle_system serial;
+        build_cloud(serial, n, 3);
+        barnes_hut tree;
+        tree.compute(serial);
+
+        for (unsigned int threads = 2; threads <= 4; threads++)
+        {
+            particle_system parallel;
+            build_cloud(parallel, n, 3);
+            thread_pool pool(threads);
+            barnes_hut parallel_tree;
+            auto start = chrono::steady_clock::now();
+            parallel_tree.compute(parallel, &pool);
+            chrono::duration<double> elapsed =
+                chrono::steady_clock::now() - start;
+
+            unsigned int mismatches = 0;
+            for (unsigned int a = 0; a < 3; a++)
+            {
+                for (unsigned int i = 0; i < n; i++)
+                {
+                    mismatches += (parallel.input_component(a)[i] !=
+                                   serial.input_component(a)[i]);
+                }
+            }
+            cout << "threads = " << threads << ": " << elapsed.count()
+                 << " s, forces differing from serial = " << mismatches
+                 << "\r\n";
+        }
+    }
+#endif
+    return 0;
+}
+#endif
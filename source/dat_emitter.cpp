@@ -0,0 +1,343 @@
+/**
+* @file dat_emitter.cpp
+*
+* @brief Batched writing of gnuplot .dat files: whole point and vector sets
+* formatted by to_chars into a reusable buffer, written in large blocks
+*
+* @author Pavlo Vlastos
+*/
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "dat_emitter.h"
+#include "file_io.h"
+#include <charconv>
+#include <fcntl.h>
+#include <unistd.h>
+
+/******************************************************************************
+ * DEFINES
+ *****************************************************************************/
+#define DIM 3
+#define MAX_DIGITS 17 /* Significant digits that pin down any double */
+
+/******************************************************************************
+ * PRIVATE FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+void dat_emitter::append_row(const double *values, unsigned int n)
+{
+    char *p = buffer.data() + used;
+    char *end = buffer.data() + buffer.size();
+
+    for (unsigned int i = 0; i < n; i++)
+    {
+        /* The buffer keeps room for a whole row, so neither can fail */
+        to_chars_result r =
+            (precision == DAT_EMITTER_SHORTEST)
+                ? to_chars(p, end, values[i])
+                : to_chars(p, end, values[i], chars_format::general,
+                           precision);
+        p = r.ptr;
+        *p++ = ' ';
+    }
+    *p++ = '\r';
+    *p++ = '\n';
+
+    used = p - buffer.data();
+    rows++;
+}
+
+tensor_status dat_emitter::flush_if_full(void)
+{
+    return (used >= DAT_EMITTER_BATCH) ? flush() : tensor_status::SUCCESS;
+}
+
+/******************************************************************************
+ * PUBLIC FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+dat_emitter::~dat_emitter(void)
+{
+    close();
+}
+
+tensor_status dat_emitter::open(const char *path)
+{
+    if ((path == nullptr) || (close() != tensor_status::SUCCESS))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    /* A batch, and room for the row that completes it */
+    buffer.resize(DAT_EMITTER_BATCH +
+                  SPLOT_VEC_SIZE * (DAT_EMITTER_VALUE_CHARS + 1) + 2);
+    used = 0;
+    rows = 0;
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status dat_emitter::close(void)
+{
+    if (fd < 0)
+    {
+        return tensor_status::SUCCESS;
+    }
+
+    tensor_status status = flush();
+    if (::close(fd) != 0)
+    {
+        status = tensor_status::FAILURE;
+    }
+    fd = -1;
+
+    return status;
+}
+
+tensor_status dat_emitter::flush(void)
+{
+    if (fd < 0)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    if (write_all(fd, buffer.data(), used) != tensor_status::SUCCESS)
+    {
+        return tensor_status::FAILURE;
+    }
+    used = 0;
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status dat_emitter::emit_dots(const double *x, const double *y,
+                                     const double *z, unsigned int n)
+{
+    if ((fd < 0) || (x == nullptr) || (y == nullptr) || (z == nullptr))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    for (unsigned int i = 0; i < n; i++)
+    {
+        const double dot[DIM] = {x[i], y[i], z[i]};
+        append_row(dot, DIM);
+        if (flush_if_full() != tensor_status::SUCCESS)
+        {
+            return tensor_status::FAILURE;
+        }
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status dat_emitter::emit_dots(const tensor &points)
+{
+    if (points.n_width == DIM)
+    { /* One dot per row */
+        for (unsigned int i = 0; i < points.m_height; i++)
+        {
+            if (emit_dots(&points(i, 0), &points(i, 1), &points(i, 2), 1) !=
+                tensor_status::SUCCESS)
+            {
+                return tensor_status::FAILURE;
+            }
+        }
+        return tensor_status::SUCCESS;
+    }
+
+    if (points.m_height == DIM)
+    { /* One dot per column: the rows are the x, y and z arrays */
+        return emit_dots(&points(0, 0), &points(1, 0), &points(2, 0),
+                         points.n_width);
+    }
+
+    return tensor_status::FAILURE;
+}
+
+tensor_status dat_emitter::emit_vectors(const double *x, const double *y,
+                                        const double *z, const double *dx,
+                                        const double *dy, const double *dz,
+                                        unsigned int n)
+{
+    if ((fd < 0) || (x == nullptr) || (y == nullptr) || (z == nullptr) ||
+        (dx == nullptr) || (dy == nullptr) || (dz == nullptr))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    for (unsigned int i = 0; i < n; i++)
+    {
+        const double vec[SPLOT_VEC_SIZE] = {x[i], y[i], z[i],
+                                            dx[i], dy[i], dz[i]};
+        append_row(vec, SPLOT_VEC_SIZE);
+        if (flush_if_full() != tensor_status::SUCCESS)
+        {
+            return tensor_status::FAILURE;
+        }
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+/******************************************************************************
+ * Setters
+******************************************************************************/
+tensor_status dat_emitter::set_precision(unsigned int digits)
+{
+    if (digits > MAX_DIGITS)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    precision = digits;
+    return tensor_status::SUCCESS;
+}
+
+/******************************************************************************
+ * UNIT TESTS
+ *****************************************************************************/
+#ifdef TESTING_DAT_EMITTER
+
+#include <fstream>
+#include <math.h>
+#include <random>
+#include <stdlib.h>
+#include <time.h>
+
+int main(void)
+{
+#ifdef TEST_DAT_EMITTER_FORMAT
+    {
+        cout << "TEST_DAT_EMITTER_FORMAT\r\n";
+        /* The dots of TEST_TENSOR_TO_GNUPLOT_DOT, one per row */
+        tensor points(vector<vector<double>>{{1.0, 2.0, 3.0},
+                                             {2.0, 4.0, 6.0},
+                                             {2.0, 3.0, 5.5}});
+        const char *path = "../../simulation/emitter.dat";
+        dat_emitter dots;
+        if (dots.open(path) != tensor_status::SUCCESS)
+        {
+            cout << "Unable to open file\r\n";
+            return 1;
+        }
+        dots.emit_dots(points);
+        dots.close();
+
+        ifstream check(path);
+        string line;
+        while (getline(check, line))
+        {
+            cout << line << "\n";
+        }
+
+        /* The vector of simulation/vector.dat */
+        tensor v(vector<vector<double>>{{0.0, 0.0, 2.0, 2.0, 1.0, 1.0}});
+        string text;
+        tensor_status status = tensor_to_gnuplot_vec(v, text);
+        cout << "tensor_to_gnuplot_vec: status = " << (int)status << ", "
+             << text;
+        dat_emitter vectors;
+        vectors.open(path);
+        vectors.emit_vectors(&v(0, 0), &v(0, 1), &v(0, 2), &v(0, 3),
+                             &v(0, 4), &v(0, 5), 1);
+        vectors.close();
+        ifstream check_vector(path);
+        getline(check_vector, line);
+        cout << "dat_emitter vector: " << line << "\n";
+
+        /* Shortest text reads back exactly; 6 digits come close */
+        mt19937 generator(1);
+        uniform_real_distribution<double> exponent(-300.0, 300.0);
+        const unsigned int n = 100000;
+        vector<double> x(n);
+        for (unsigned int i = 0; i < n; i++)
+        {
+            x[i] = pow(10.0, exponent(generator)) * ((i % 2) ? -1.0 : 1.0);
+        }
+
+        const unsigned int precisions[2] = {DAT_EMITTER_SHORTEST, 6};
+        for (unsigned int p = 0; p < 2; p++)
+        {
+            dat_emitter emitter;
+            emitter.set_precision(precisions[p]);
+            emitter.open(path);
+            emitter.emit_dots(x.data(), x.data(), x.data(), n);
+            emitter.close();
+
+            ifstream in(path);
+            unsigned int exact = 0;
+            double max_relative = 0.0;
+            for (unsigned int i = 0; i < n; i++)
+            {
+                double a, b, c;
+                in >> a >> b >> c;
+                exact += (a == x[i]) && (b == x[i]) && (c == x[i]);
+                max_relative = fmax(max_relative, fabs(a - x[i]) /
+                                                      fabs(x[i]));
+            }
+            cout << "precision " << precisions[p] << ": " << exact << " of "
+                 << n << " read back exactly, max relative error "
+                 << max_relative << "\r\n";
+        }
+        remove(path);
+    }
+#endif
+
+#ifdef TEST_DAT_EMITTER_THROUGHPUT
+    {
+        cout << "TEST_DAT_EMITTER_THROUGHPUT\r\n";
+        /* A million-point trajectory, a helix */
+        const unsigned int n = 1000000;
+        vector<double> x(n), y(n), z(n);
+        for (unsigned int i = 0; i < n; i++)
+        {
+            const double t = 1.0e-3 * i;
+            x[i] = 6.771e6 * cos(t);
+            y[i] = 6.771e6 * sin(t);
+            z[i] = 1.0e3 * t;
+        }
+
+        /* One tensor_to_gnuplot_dot() and stream insertion per point */
+        clock_t start = clock();
+        {
+            ofstream dat("../../simulation/trajectory.dat");
+            tensor point(3);
+            string dot;
+            for (unsigned int i = 0; i < n; i++)
+            {
+                point(0, 0) = x[i];
+                point(1, 0) = y[i];
+                point(2, 0) = z[i];
+                tensor_to_gnuplot_dot(point, dot);
+                dat << dot;
+            }
+        }
+        double dot_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        const unsigned int precisions[2] = {DAT_EMITTER_SHORTEST, 9};
+        for (unsigned int p = 0; p < 2; p++)
+        {
+            start = clock();
+            dat_emitter emitter;
+            emitter.set_precision(precisions[p]);
+            emitter.open("../../simulation/trajectory.dat");
+            emitter.emit_dots(x.data(), y.data(), z.data(), n);
+            emitter.close();
+            double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+            cout << "precision " << precisions[p] << ": " << seconds
+                 << " s vs " << dot_seconds
+                 << " s by tensor_to_gnuplot_dot, " << (dot_seconds / seconds)
+                 << " times faster\r\n";
+        }
+    }
+#endif
+    return 0;
+}
+#endif
@@ -0,0 +1,565 @@
+/**
+* @file decimation.cpp
+*
+* @brief Error-bounded simplification of 3D trajectories, by Douglas-Peucker
+* or by streaming max-deviation decimation, and a level-of-detail exporter of
+* .dat files built on the latter while a simulation runs
+*
+* @author Pavlo Vlastos
+*/
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "decimation.h"
+#include <math.h>
+#include <string>
+
+/******************************************************************************
+ * DEFINES
+ *****************************************************************************/
+#define DIM 3
+
+/******************************************************************************
+ * PRIVATE FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+/**
+ * @brief The squared distance of point p from the segment a b
+ */
+static double segment_distance_sq(const double *a, const double *b,
+                                  const double *p)
+{
+    double ab[DIM];
+    double ap[DIM];
+    double dot = 0.0;
+    double length_sq = 0.0;
+
+    for (unsigned int i = 0; i < DIM; i++)
+    {
+        ab[i] = b[i] - a[i];
+        ap[i] = p[i] - a[i];
+        dot += ab[i] * ap[i];
+        length_sq += ab[i] * ab[i];
+    }
+
+    /* The nearest point of the segment, a + s * (b - a) */
+    double s = (length_sq > 0.0) ? fmin(fmax(dot / length_sq, 0.0), 1.0)
+                                 : 0.0;
+
+    double distance_sq = 0.0;
+    for (unsigned int i = 0; i < DIM; i++)
+    {
+        const double d = ap[i] - s * ab[i];
+        distance_sq += d * d;
+    }
+
+    return distance_sq;
+}
+
+bool stream_decimator::hold(const double *point)
+{
+    double direction[DIM];
+    double distance_sq = 0.0;
+    for (unsigned int i = 0; i < DIM; i++)
+    {
+        direction[i] = point[i] - anchor[i];
+        distance_sq += direction[i] * direction[i];
+    }
+    const double distance = sqrt(distance_sq);
+
+    /* Every point held lies along the segment only if the segment reaches
+     * past them all */
+    if (distance < reach)
+    {
+        return false;
+    }
+
+    if (distance > tolerance)
+    {
+        for (unsigned int i = 0; i < DIM; i++)
+        {
+            direction[i] /= distance;
+        }
+        /* Directions within this angle pass within the tolerance of it */
+        const double angle = asin(tolerance / distance);
+
+        if (!constrained)
+        {
+            memcpy(axis, direction, DIM * sizeof(double));
+            half_angle = angle;
+            constrained = true;
+        }
+        else
+        {
+            /* The angle from the axis, by atan2 to stay exact when small */
+            const double c[DIM] = {axis[1] * direction[2] -
+                                       axis[2] * direction[1],
+                                   axis[2] * direction[0] -
+                                       axis[0] * direction[2],
+                                   axis[0] * direction[1] -
+                                       axis[1] * direction[0]};
+            const double cos_off = axis[0] * direction[0] +
+                                   axis[1] * direction[1] +
+                                   axis[2] * direction[2];
+            const double off = atan2(sqrt(c[0] * c[0] + c[1] * c[1] +
+                                          c[2] * c[2]),
+                                     cos_off);
+            if (off > half_angle)
+            {
+                return false;
+            }
+
+            if (off + angle <= half_angle)
+            { /* The point's cone lies inside the one kept */
+                memcpy(axis, direction, DIM * sizeof(double));
+                half_angle = angle;
+            }
+            else if (off + half_angle > angle)
+            {
+                /* The widest cone in both, its axis turned from the axis
+                 * towards the direction, along the great circle of both */
+                const double narrowed = 0.5 * (half_angle + angle - off);
+                const double turn = half_angle - narrowed;
+                double w[DIM];
+                double w_norm_sq = 0.0;
+                for (unsigned int i = 0; i < DIM; i++)
+                {
+                    w[i] = direction[i] - cos_off * axis[i];
+                    w_norm_sq += w[i] * w[i];
+                }
+                const double w_norm = sqrt(w_norm_sq);
+                for (unsigned int i = 0; i < DIM; i++)
+                {
+                    axis[i] = cos(turn) * axis[i] +
+                              sin(turn) * w[i] / w_norm;
+                }
+                half_angle = narrowed;
+            }
+        }
+    }
+
+    memcpy(last, point, DIM * sizeof(double));
+    holding = true;
+    reach = distance;
+
+    return true;
+}
+
+/******************************************************************************
+ * PUBLIC FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+tensor_status douglas_peucker(const double *x, const double *y,
+                              const double *z, unsigned int n,
+                              double tolerance, vector<unsigned int> &kept)
+{
+    kept.clear();
+
+    if ((x == nullptr) || (y == nullptr) || (z == nullptr) ||
+        (tolerance < 0.0))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    if (n <= 2)
+    {
+        for (unsigned int i = 0; i < n; i++)
+        {
+            kept.push_back(i);
+        }
+        return tensor_status::SUCCESS;
+    }
+
+    const double tolerance_sq = tolerance * tolerance;
+    vector<bool> keep(n, false);
+    keep[0] = true;
+    keep[n - 1] = true;
+
+    /* The spans still to split, in place of recursion, which a long
+     * straight run would take as deep as the points it has */
+    vector<pair<unsigned int, unsigned int>> spans;
+    spans.push_back({0, n - 1});
+
+    while (!spans.empty())
+    {
+        const unsigned int first = spans.back().first;
+        const unsigned int last = spans.back().second;
+        spans.pop_back();
+
+        const double a[DIM] = {x[first], y[first], z[first]};
+        const double b[DIM] = {x[last], y[last], z[last]};
+        double farthest_sq = 0.0;
+        unsigned int farthest = first;
+
+        for (unsigned int i = first + 1; i < last; i++)
+        {
+            const double p[DIM] = {x[i], y[i], z[i]};
+            const double distance_sq = segment_distance_sq(a, b, p);
+            if (distance_sq > farthest_sq)
+            {
+                farthest_sq = distance_sq;
+                farthest = i;
+            }
+        }
+
+        if (farthest_sq > tolerance_sq)
+        {
+            keep[farthest] = true;
+            spans.push_back({first, farthest});
+            spans.push_back({farthest, last});
+        }
+    }
+
+    for (unsigned int i = 0; i < n; i++)
+    {
+        if (keep[i])
+        {
+            kept.push_back(i);
+        }
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+bool stream_decimator::push(const double *point, double *out)
+{
+    const unsigned long index = seen++;
+
+    if (index == 0)
+    { /* The first point is always kept */
+        memcpy(anchor, point, DIM * sizeof(double));
+        memcpy(out, point, DIM * sizeof(double));
+        anchor_index = 0;
+        kept++;
+        holding = false;
+        constrained = false;
+        reach = 0.0;
+        return true;
+    }
+
+    if (hold(point))
+    {
+        return false;
+    }
+
+    /* Keep the last point held, and hold the new one after it, which always
+     * fits a cone of its own */
+    memcpy(anchor, last, DIM * sizeof(double));
+    memcpy(out, last, DIM * sizeof(double));
+    anchor_index = index - 1;
+    kept++;
+
+    holding = false;
+    constrained = false;
+    reach = 0.0;
+    hold(point);
+
+    return true;
+}
+
+bool stream_decimator::finish(double *out)
+{
+    const bool kept_last = holding;
+
+    if (kept_last)
+    {
+        memcpy(out, last, DIM * sizeof(double));
+        anchor_index = seen - 1;
+        kept++;
+    }
+
+    holding = false;
+    seen = 0;
+
+    return kept_last;
+}
+
+lod_exporter::~lod_exporter(void)
+{
+    close();
+}
+
+tensor_status lod_exporter::open(const char *prefix, unsigned int levels_in,
+                                 double tolerance, double ratio)
+{
+    if ((prefix == nullptr) || (levels_in == 0) ||
+        (levels_in > LOD_MAX_LEVELS) || (tolerance <= 0.0) || (ratio <= 1.0) ||
+        (close() != tensor_status::SUCCESS))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    /* Level l is within tolerance * ratio^l of the trajectory */
+    decimators.clear();
+    for (unsigned int l = 0; l < levels_in; l++)
+    {
+        decimators.emplace_back(tolerance);
+        tolerance *= ratio;
+    }
+
+    for (unsigned int l = 0; l < levels_in; l++)
+    {
+        const string path = string(prefix) + "_lod" + to_string(l) + ".dat";
+        if (files[l].open(path.c_str()) != tensor_status::SUCCESS)
+        {
+            for (unsigned int k = 0; k < l; k++)
+            {
+                files[k].close();
+            }
+            return tensor_status::FAILURE;
+        }
+    }
+
+    levels = levels_in;
+    points = 0;
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status lod_exporter::close(void)
+{
+    tensor_status status = tensor_status::SUCCESS;
+
+    for (unsigned int l = 0; l < levels; l++)
+    {
+        double out[DIM];
+        if ((decimators[l].finish(out) &&
+             (files[l].emit_dots(&out[0], &out[1], &out[2], 1) !=
+              tensor_status::SUCCESS)) ||
+            (files[l].close() != tensor_status::SUCCESS))
+        {
+            status = tensor_status::FAILURE;
+        }
+    }
+    levels = 0;
+
+    return status;
+}
+
+tensor_status lod_exporter::push(double x, double y, double z)
+{
+    if (levels == 0)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    points++;
+
+    const double point[DIM] = {x, y, z};
+    double out[DIM];
+    for (unsigned int l = 0; l < levels; l++)
+    {
+        if (decimators[l].push(point, out) &&
+            (files[l].emit_dots(&out[0], &out[1], &out[2], 1) !=
+             tensor_status::SUCCESS))
+        {
+            return tensor_status::FAILURE;
+        }
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+frame_sink lod_sink(shared_ptr<lod_exporter> lod, unsigned int id)
+{
+    return [lod, id](const state_frame &frame)
+    {
+        if (id >= frame.count)
+        {
+            return tensor_status::FAILURE;
+        }
+        return lod->push(frame.columns[0][id], frame.columns[1][id],
+                         frame.columns[2][id]);
+    };
+}
+
+/******************************************************************************
+ * UNIT TESTS
+ *****************************************************************************/
+#ifdef TESTING_DECIMATION
+
+#include <fstream>
+#include <time.h>
+
+/**
+ * @brief The largest distance of the points from the segments between the
+ * kept points around them
+ */
+static double max_deviation(const vector<double> &x, const vector<double> &y,
+                            const vector<double> &z,
+                            const vector<unsigned int> &kept)
+{
+    double deviation_sq = 0.0;
+    for (size_t k = 1; k < kept.size(); k++)
+    {
+        const unsigned int first = kept[k - 1];
+        const double a[DIM] = {x[first], y[first], z[first]};
+        const double b[DIM] = {x[kept[k]], y[kept[k]], z[kept[k]]};
+        for (unsigned int i = first + 1; i < kept[k]; i++)
+        {
+            const double p[DIM] = {x[i], y[i], z[i]};
+            deviation_sq = fmax(deviation_sq, segment_distance_sq(a, b, p));
+        }
+    }
+    return sqrt(deviation_sq);
+}
+
+int main(void)
+{
+#ifdef TEST_DECIMATION_DOUGLAS_PEUCKER
+    {
+        cout << "TEST_DECIMATION_DOUGLAS_PEUCKER\r\n";
+        /* A straight run, then a turn of a helix, 200000 points each */
+        const unsigned int half = 200000;
+        const unsigned int n = 2 * half;
+        vector<double> x(n), y(n), z(n);
+        for (unsigned int i = 0; i < half; i++)
+        {
+            x[i] = 1.0e-3 * i;
+            y[i] = 0.0;
+            z[i] = 0.0;
+
+            const double angle = 2.0 * M_PI * i / half;
+            x[half + i] = x[half - 1] + 10.0 * sin(angle);
+            y[half + i] = 10.0 * (1.0 - cos(angle));
+            z[half + i] = 1.0e-4 * i;
+        }
+
+        const double tolerances[3] = {1.0e-3, 1.0e-2, 1.0e-1};
+        for (unsigned int t = 0; t < 3; t++)
+        {
+            clock_t start = clock();
+            vector<unsigned int> kept;
+            douglas_peucker(x.data(), y.data(), z.data(), n, tolerances[t],
+                            kept);
+            double dp_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+            double dp_deviation = max_deviation(x, y, z, kept);
+            size_t dp_kept = kept.size();
+
+            start = clock();
+            kept.clear();
+            stream_decimator stream(tolerances[t]);
+            double out[DIM];
+            for (unsigned int i = 0; i < n; i++)
+            {
+                const double p[DIM] = {x[i], y[i], z[i]};
+                if (stream.push(p, out))
+                {
+                    kept.push_back(stream.get_kept_index());
+                }
+            }
+            if (stream.finish(out))
+            {
+                kept.push_back(stream.get_kept_index());
+            }
+            double stream_seconds = (double)(clock() - start) /
+                                    CLOCKS_PER_SEC;
+
+            cout << "tolerance " << tolerances[t] << ": Douglas-Peucker keeps "
+                 << dp_kept << " of " << n << " (max deviation "
+                 << dp_deviation << ", " << dp_seconds
+                 << " s), streaming keeps " << kept.size()
+                 << " (max deviation " << max_deviation(x, y, z, kept) << ", "
+                 << stream_seconds << " s)\r\n";
+        }
+
+        vector<unsigned int> kept;
+        douglas_peucker(x.data(), y.data(), z.data(), 2, 1.0, kept);
+        cout << "two points keep " << kept.size() << ", a negative "
+             << "tolerance fails = "
+             << (douglas_peucker(x.data(), y.data(), z.data(), n, -1.0,
+                                 kept) == tensor_status::FAILURE)
+             << "\r\n";
+    }
+#endif
+
+#ifdef TEST_DECIMATION_LOD
+    {
+        cout << "TEST_DECIMATION_LOD\r\n";
+        /* A particle under a force that turns every 50000 steps, recorded
+         * live through the async writer */
+        const unsigned int steps = 200000;
+        const unsigned int levels = 4;
+        const double tolerance = 1.0e-3;
+        const char *prefix = "../../simulation/trajectory";
+
+        particle_system system(1);
+        system.add_particle(0.0, 0.0, 0.0);
+
+        shared_ptr<lod_exporter> lod = make_shared<lod_exporter>();
+        if (lod->open(prefix, levels, tolerance) != tensor_status::SUCCESS)
+        {
+            cout << "Unable to open file\r\n";
+            return 1;
+        }
+        async_writer writer(1);
+        writer.add_sink(lod_sink(lod, 0));
+        writer.start();
+
+        const double forces[4][DIM] = {{1.0, 0.0, 0.0},
+                                       {0.0, 1.0, 0.0},
+                                       {-1.0, 0.0, 0.5},
+                                       {0.0, -1.0, 0.0}};
+        vector<double> x(steps), y(steps), z(steps);
+        for (unsigned int k = 0; k < steps; k++)
+        {
+            if (k % (steps / 4) == 0)
+            {
+                const double *f = forces[k / (steps / 4)];
+                system.set_u(0, f[0], f[1], f[2], 0.0, 0.0, 0.0);
+            }
+            system.update();
+            writer.push(k * system.get_sample_time(), system);
+
+            x[k] = system.state_component(0)[0];
+            y[k] = system.state_component(1)[0];
+            z[k] = system.state_component(2)[0];
+        }
+        writer.stop();
+        lod->close();
+
+        /* Each level's points are among the trajectory's, exactly as the
+         * shortest text reads back, so find them in order */
+        unsigned long full_bytes = 0;
+        double level_tolerance = tolerance;
+        for (unsigned int l = 0; l < levels; l++)
+        {
+            const string path = string(prefix) + "_lod" + to_string(l) +
+                                ".dat";
+            ifstream in(path, ios::binary | ios::ate);
+            const unsigned long bytes = in.tellg();
+            in.seekg(0);
+
+            vector<unsigned int> kept;
+            unsigned int i = 0;
+            double px, py, pz;
+            while ((in >> px >> py >> pz) && (i < steps))
+            {
+                while ((i < steps) &&
+                       ((x[i] != px) || (y[i] != py) || (z[i] != pz)))
+                {
+                    i++;
+                }
+                kept.push_back(i);
+            }
+            const bool found = (i < steps) &&
+                               (kept.size() == lod->get_rows(l));
+            if (l == 0)
+            {
+                /* Level 0's bytes per point, for all the steps */
+                full_bytes = bytes / kept.size() * steps;
+            }
+
+            cout << "level " << l << ": " << lod->get_rows(l) << " of "
+                 << lod->get_points() << " points, " << bytes
+                 << " bytes, max deviation " << max_deviation(x, y, z, kept)
+                 << " (tolerance " << level_tolerance << "), all found = "
+                 << found << "\r\n";
+            level_tolerance *= LOD_RATIO;
+            remove(path.c_str());
+        }
+        cout << "every step would take about " << full_bytes << " bytes\r\n";
+    }
+#endif
+    return 0;
+}
+#endif
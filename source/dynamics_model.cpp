@@ -0,0 +1,270 @@
+/**
+* @file dynamics_model.cpp
+*
+* @brief Immutable, shared discrete dynamics models of a particle. Particles
+* with the same sample-time, mass, radius and moment of inertia point at one
+* interned model instead of each carrying its own phi and gamma.
+*
+* @author Pavlo Vlastos
+*/
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "dynamics_model.h"
+#include <map>
+#include <mutex>
+#include <tuple>
+
+/******************************************************************************
+ * DEFINES
+ *****************************************************************************/
+#define INTERN_SWEEP_MINIMUM 64 /* Table size before expired entries matter */
+
+/******************************************************************************
+ * GLOBAL VARIABLES AND DATATYPES
+ *****************************************************************************/
+/* Models by (dt, mass, radius, moi). The table does not keep models alive:
+ * a model lives as long as some particle (or the retained ring) uses it. */
+typedef tuple<double, double, double, double> model_key;
+
+static mutex intern_mutex;
+static map<model_key, weak_ptr<const dynamics_model>> intern_table;
+static size_t intern_sweep_size = INTERN_SWEEP_MINIMUM;
+
+static shared_ptr<const dynamics_model> retained[DYNAMICS_MODEL_RETAINED];
+static unsigned int retained_next = 0;
+
+/******************************************************************************
+ * PRIVATE FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+/**
+ * @brief Drop the table entries of models nobody uses any more, once the
+ * table has doubled since the last sweep
+ */
+static void sweep_expired(void)
+{
+    if (intern_table.size() < intern_sweep_size)
+    {
+        return;
+    }
+
+    for (auto entry = intern_table.begin(); entry != intern_table.end();)
+    {
+        if (entry->second.expired())
+        {
+            entry = intern_table.erase(entry);
+        }
+        else
+        {
+            ++entry;
+        }
+    }
+
+    intern_sweep_size = 2 * intern_table.size();
+    if (intern_sweep_size < INTERN_SWEEP_MINIMUM)
+    {
+        intern_sweep_size = INTERN_SWEEP_MINIMUM;
+    }
+}
+
+/******************************************************************************
+ * PUBLIC FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+dynamics_model::dynamics_model(double dt_in, double mass_in, double radius_in,
+                               double moi_in)
+    : dt(dt_in), mass(mass_in), radius(radius_in), moi(moi_in),
+      phi(STATE_SIZE, STATE_SIZE), gamma(STATE_SIZE, INPUT_SIZE),
+      sparse_phi(STATE_SIZE, STATE_SIZE), sparse_gamma(STATE_SIZE, INPUT_SIZE)
+{
+    const unsigned int n = STATE_SIZE + INPUT_SIZE;
+    tensor m(n, n);
+    tensor e_m(n, n);
+
+    /* [A B; 0 0] * dt: positions and attitude integrate their rates, forces
+     * accelerate them */
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        m(i, 3 + i) = dt;                                 /* x' = v */
+        m(6 + i, 9 + i) = dt;                             /* angle' = rate */
+        m(3 + i, STATE_SIZE + i) = dt / mass;             /* v' = fn / m */
+        m(9 + i, STATE_SIZE + 3 + i) = radius * dt / moi; /* rate' */
+    }
+
+    if (expm(m, e_m) != tensor_status::SUCCESS)
+    {
+        return;
+    }
+
+    for (unsigned int i = 0; i < STATE_SIZE; i++)
+    {
+        for (unsigned int j = 0; j < STATE_SIZE; j++)
+        {
+            phi(i, j) = e_m(i, j);
+        }
+        for (unsigned int j = 0; j < INPUT_SIZE; j++)
+        {
+            gamma(i, j) = e_m(i, STATE_SIZE + j);
+        }
+    }
+
+    sparse_phi.from_tensor(phi);
+    sparse_gamma.from_tensor(gamma);
+    valid = true;
+}
+
+shared_ptr<const dynamics_model> dynamics_model::intern(double dt,
+                                                        double mass,
+                                                        double radius,
+                                                        double moi)
+{
+    if ((dt <= 0.0) || (mass <= 0.0) || (radius <= 0.0) || (moi <= 0.0))
+    {
+        return nullptr;
+    }
+
+    const model_key key(dt, mass, radius, moi);
+
+    {
+        lock_guard<mutex> lock(intern_mutex);
+        auto found = intern_table.find(key);
+        if (found != intern_table.end())
+        {
+            shared_ptr<const dynamics_model> model = found->second.lock();
+            if (model != nullptr)
+            {
+                return model;
+            }
+        }
+    }
+
+    /* Discretized outside the lock. Should another thread intern the same
+     * parameters meanwhile, whichever model reached the table first wins. */
+    shared_ptr<const dynamics_model> model(
+        new dynamics_model(dt, mass, radius, moi));
+
+    if (!model->valid)
+    {
+        return nullptr;
+    }
+
+    lock_guard<mutex> lock(intern_mutex);
+    weak_ptr<const dynamics_model> &entry = intern_table[key];
+    shared_ptr<const dynamics_model> existing = entry.lock();
+
+    if (existing != nullptr)
+    {
+        return existing;
+    }
+
+    entry = model;
+    retained[retained_next] = model;
+    retained_next = (retained_next + 1) % DYNAMICS_MODEL_RETAINED;
+    sweep_expired();
+
+    return model;
+}
+
+const dynamics_jump *dynamics_model::jump(unsigned int level) const
+{
+    if (level >= DYNAMICS_MODEL_JUMP_LEVELS)
+    {
+        return nullptr;
+    }
+
+    lock_guard<mutex> lock(jump_mutex);
+
+    if (jumps.empty())
+    {
+        jumps.emplace_back(new dynamics_jump{copy(phi), copy(gamma),
+                                             sparse_phi, sparse_gamma});
+    }
+
+    while (jumps.size() <= level)
+    {
+        const dynamics_jump &half = *jumps.back();
+
+        /* Twice 2^j steps: x = phi_j (phi_j x + gamma_j u) + gamma_j u */
+        tensor phi_next = multiply(half.phi, half.phi);
+        tensor gamma_next = add(multiply(half.phi, half.gamma), half.gamma);
+        sparse_tensor sparse_phi_next(phi_next);
+        sparse_tensor sparse_gamma_next(gamma_next);
+
+        jumps.emplace_back(new dynamics_jump{phi_next, gamma_next,
+                                             sparse_phi_next,
+                                             sparse_gamma_next});
+    }
+
+    return jumps[level].get();
+}
+
+unsigned int dynamics_model::live_models(void)
+{
+    lock_guard<mutex> lock(intern_mutex);
+    unsigned int live = 0;
+
+    for (auto entry = intern_table.begin(); entry != intern_table.end();
+         ++entry)
+    {
+        live += !entry->second.expired();
+    }
+
+    return live;
+}
+
+/******************************************************************************
+ * UNIT TESTS
+ *****************************************************************************/
+#ifdef TESTING_DYNAMICS_MODEL
+
+#include "particle.h"
+
+int main(void)
+{
+#ifdef TEST_DYNAMICS_MODEL_INTERN
+    {
+        cout << "TEST_DYNAMICS_MODEL_INTERN\r\n";
+        shared_ptr<const dynamics_model> a =
+            dynamics_model::intern(0.001, 2.0, 1.0, 0.8);
+        shared_ptr<const dynamics_model> b =
+            dynamics_model::intern(0.001, 2.0, 1.0, 0.8);
+        shared_ptr<const dynamics_model> c =
+            dynamics_model::intern(0.002, 2.0, 1.0, 0.8);
+        cout << "same parameters shared = " << (a == b)
+             << ", different parameters shared = " << (a == c) << "\r\n";
+        cout << "invalid mass gives nullptr = "
+             << (dynamics_model::intern(0.001, 0.0, 1.0, 0.8) == nullptr)
+             << "\r\n";
+    }
+#endif
+
+#ifdef TEST_DYNAMICS_MODEL_SHARING
+    {
+        cout << "TEST_DYNAMICS_MODEL_SHARING\r\n";
+        const unsigned int n = 100000;
+        vector<particle> particles;
+        particles.reserve(n);
+        for (unsigned int i = 0; i < n; i++)
+        {
+            particles.push_back(particle(i, 0.0, 0.0));
+            particles[i].set_mass(1.0 + (i % 3));
+        }
+        unsigned int live = dynamics_model::live_models();
+        cout << n << " particles with 3 masses: " << live
+             << " live models (one per mass, plus retained ones)\r\n";
+        cout << "particles sharing particle 0's model = "
+             << particles[0].get_model().use_count() - 1 << "\r\n";
+
+        /* Copy-on-write: changing one particle leaves the others alone */
+        shared_ptr<const dynamics_model> before = particles[3].get_model();
+        particles[3].set_sample_time(0.0005);
+        cout << "particle 3 moved to its own model = "
+             << (particles[3].get_model() != before)
+             << ", particle 0 unchanged = "
+             << (particles[0].get_model() == before) << "\r\n";
+        cout << "sizeof(particle) = " << sizeof(particle) << " bytes\r\n";
+    }
+#endif
+    return 0;
+}
+#endif
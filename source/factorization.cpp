@@ -0,0 +1,979 @@
+/**
+* @file factorization.cpp
+*
+* @brief Matrix factorizations that are computed once and then reused to
+* solve against many right-hand sides
+*
+* @author Pavlo Vlastos
+*/
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "factorization.h"
+#include "gemm.h"
+#include <float.h>
+#include <math.h>
+
+/******************************************************************************
+ * DEFINES
+ *****************************************************************************/
+#define FACTORIZATION_MIN(a, b) (((a) < (b)) ? (a) : (b))
+
+/******************************************************************************
+ * PRIVATE FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+/**
+ * @brief row_i -= x * row_k over n contiguous elements
+ */
+static inline void subtract_scaled_row(double *row_i, const double *row_k,
+                                       double x, unsigned int n)
+{
+    for (unsigned int j = 0; j < n; j++)
+    {
+        row_i[j] -= x * row_k[j];
+    }
+}
+
+/**
+ * @brief Dot product of two contiguous rows over n elements
+ */
+static inline double dot_rows(const double *a, const double *b,
+                              unsigned int n)
+{
+    double x = 0.0;
+
+    for (unsigned int j = 0; j < n; j++)
+    {
+        x += a[j] * b[j];
+    }
+
+    return x;
+}
+
+/**
+ * @brief Apply the Householder reflector stored in column k of qr (rows
+ * k..m, implicit leading 1) to columns [j0, j1) of c, over rows k..m
+ * @param w Scratch of at least j1 - j0 elements
+ */
+static void apply_reflector(const tensor &qr, unsigned int k, double tau,
+                            double *c, unsigned int ldc, unsigned int j0,
+                            unsigned int j1, double *w)
+{
+    const unsigned int m = qr.m_height;
+    const unsigned int width = j1 - j0;
+
+    if ((tau == 0.0) || (width == 0))
+    {
+        return;
+    }
+
+    /* w = v^T * C, accumulated row by row */
+    memcpy(w, c + (size_t)k * ldc + j0, width * sizeof(double));
+    for (unsigned int i = k + 1; i < m; i++)
+    {
+        const double v_i = qr(i, k);
+        const double *c_row = c + (size_t)i * ldc + j0;
+
+        for (unsigned int j = 0; j < width; j++)
+        {
+            w[j] += v_i * c_row[j];
+        }
+    }
+
+    /* C -= tau * v * w^T */
+    subtract_scaled_row(c + (size_t)k * ldc + j0, w, tau, width);
+    for (unsigned int i = k + 1; i < m; i++)
+    {
+        subtract_scaled_row(c + (size_t)i * ldc + j0, w, tau * qr(i, k),
+                            width);
+    }
+}
+
+/******************************************************************************
+ * PUBLIC FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+tensor_status lu_factorization::factor(const tensor &a)
+{
+    const unsigned int n = a.m_height;
+
+    singular = true;
+    pivot_sign = 1;
+    pivots.assign(n, 0);
+
+    if (a.m_height != a.n_width)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    lu = copy(a);
+
+    for (unsigned int k = 0; k < n; k++)
+    {
+        /* Partial pivoting: bring up the largest magnitude in column k */
+        unsigned int pivot_row = k;
+        double pivot_magnitude = fabs(lu(k, k));
+
+        for (unsigned int i = k + 1; i < n; i++)
+        {
+            if (fabs(lu(i, k)) > pivot_magnitude)
+            {
+                pivot_magnitude = fabs(lu(i, k));
+                pivot_row = i;
+            }
+        }
+
+        pivots[k] = pivot_row;
+
+        if (pivot_magnitude == 0.0)
+        { /* All elements in the column are zero */
+            return tensor_status::FAILURE;
+        }
+
+        if (pivot_row != k)
+        {
+            lu.swap_rows(k, pivot_row);
+            pivot_sign = -pivot_sign;
+        }
+
+        /* Eliminate below the pivot, storing the multipliers in place */
+        const double *row_k = lu.data() + (size_t)k * lu.stride();
+        const double pivot_inv = 1.0 / row_k[k];
+
+        for (unsigned int i = k + 1; i < n; i++)
+        {
+            double *row_i = lu.data() + (size_t)i * lu.stride();
+            const double x = row_i[k] * pivot_inv;
+
+            row_i[k] = x;
+            if (x != 0.0)
+            {
+                subtract_scaled_row(row_i + k + 1, row_k + k + 1, x,
+                                    n - k - 1);
+            }
+        }
+    }
+
+    singular = false;
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status lu_factorization::solve(const tensor &b, tensor &x) const
+{
+    if ((x.m_height != b.m_height) || (x.n_width != b.n_width))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    if (x.data() != b.data())
+    {
+        for (unsigned int i = 0; i < b.m_height; i++)
+        {
+            memcpy(x.data() + (size_t)i * x.stride(),
+                   b.data() + (size_t)i * b.stride(),
+                   b.n_width * sizeof(double));
+        }
+    }
+
+    return solve_in_place(x);
+}
+
+tensor_status lu_factorization::solve_in_place(tensor &b) const
+{
+    const unsigned int n = lu.m_height;
+    const unsigned int p = b.n_width;
+
+    if (singular || (b.m_height != n))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    /* Apply the row interchanges, in the order they were made */
+    for (unsigned int k = 0; k < n; k++)
+    {
+        b.swap_rows(k, pivots[k]);
+    }
+
+    /* Forward substitution with the unit lower triangle: L * y = P * b */
+    for (unsigned int i = 1; i < n; i++)
+    {
+        const double *l_row = lu.data() + (size_t)i * lu.stride();
+        double *b_i = b.data() + (size_t)i * b.stride();
+
+        for (unsigned int k = 0; k < i; k++)
+        {
+            if (l_row[k] != 0.0)
+            {
+                subtract_scaled_row(b_i, b.data() + (size_t)k * b.stride(),
+                                    l_row[k], p);
+            }
+        }
+    }
+
+    /* Back substitution with the upper triangle: U * x = y */
+    for (unsigned int i = n; i-- > 0;)
+    {
+        const double *u_row = lu.data() + (size_t)i * lu.stride();
+        double *b_i = b.data() + (size_t)i * b.stride();
+
+        for (unsigned int k = i + 1; k < n; k++)
+        {
+            if (u_row[k] != 0.0)
+            {
+                subtract_scaled_row(b_i, b.data() + (size_t)k * b.stride(),
+                                    u_row[k], p);
+            }
+        }
+
+        const double diagonal_inv = 1.0 / u_row[i];
+        for (unsigned int j = 0; j < p; j++)
+        {
+            b_i[j] *= diagonal_inv;
+        }
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+double lu_factorization::determinant(void) const
+{
+    if (singular)
+    {
+        return 0.0;
+    }
+
+    double det = (double)pivot_sign;
+
+    for (unsigned int i = 0; i < lu.m_height; i++)
+    {
+        det *= lu(i, i);
+    }
+
+    return det;
+}
+
+tensor_status lu_factorization::inverse(tensor &a_inv) const
+{
+    /* Leave a_inv untouched unless there is an inverse to write into it */
+    if (singular || (a_inv.m_height != lu.m_height) ||
+        (a_inv.n_width != lu.n_width))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    for (unsigned int i = 0; i < a_inv.m_height; i++)
+    {
+        for (unsigned int j = 0; j < a_inv.n_width; j++)
+        {
+            a_inv(i, j) = (i == j) ? 1.0 : 0.0;
+        }
+    }
+
+    return solve_in_place(a_inv);
+}
+
+tensor_status qr_factorization::factor(const tensor &a)
+{
+    const unsigned int m = a.m_height;
+    const unsigned int n = a.n_width;
+
+    rank_deficient = true;
+
+    if (m < n)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    qr = copy(a);
+    tau.assign(n, 0.0);
+
+    const unsigned int ld = qr.stride();
+    double *q = qr.data();
+    vector<double> w(n);
+
+    for (unsigned int k0 = 0; k0 < n; k0 += FACTORIZATION_BLOCK)
+    {
+        const unsigned int kb = FACTORIZATION_MIN(FACTORIZATION_BLOCK, n - k0);
+
+        /* Factor the panel one column at a time, only touching the panel */
+        for (unsigned int k = k0; k < (k0 + kb); k++)
+        {
+            const double alpha = qr(k, k);
+            double x_norm_sq = 0.0;
+
+            for (unsigned int i = k + 1; i < m; i++)
+            {
+                x_norm_sq += qr(i, k) * qr(i, k);
+            }
+
+            if (x_norm_sq == 0.0)
+            { /* Column already reduced, the reflector is the identity */
+                tau[k] = 0.0;
+                continue;
+            }
+
+            const double beta = -copysign(sqrt(alpha * alpha + x_norm_sq),
+                                          alpha);
+            const double scale = 1.0 / (alpha - beta);
+
+            tau[k] = (beta - alpha) / beta;
+            for (unsigned int i = k + 1; i < m; i++)
+            {
+                qr(i, k) *= scale;
+            }
+            qr(k, k) = beta;
+
+            apply_reflector(qr, k, tau[k], q, ld, k + 1, k0 + kb, w.data());
+        }
+
+        const unsigned int j0 = k0 + kb;
+        if (j0 >= n)
+        {
+            break;
+        }
+
+        /* Apply the panel to the trailing columns in compact WY form:
+         * H_1 * ... * H_kb = I - V * T * V^T, so Q^T * C = C - V * (T^T *
+         * (V^T * C)). The two large products go through gemm(). */
+        const unsigned int mk = m - k0;
+        const unsigned int nt = n - j0;
+        tensor v(mk, kb);
+        tensor v_t(kb, mk);
+        tensor t(kb, kb);
+        tensor w_block(kb, nt);
+
+        for (unsigned int r = 0; r < mk; r++)
+        {
+            for (unsigned int c = 0; (c < kb) && (c <= r); c++)
+            {
+                v(r, c) = (r == c) ? 1.0 : qr(k0 + r, k0 + c);
+                v_t(c, r) = v(r, c);
+            }
+        }
+
+        for (unsigned int i = 0; i < kb; i++)
+        {
+            t(i, i) = tau[k0 + i];
+
+            for (unsigned int j = 0; j < i; j++)
+            {
+                /* z_j = -tau_i * v_j^T * v_i */
+                w[j] = -tau[k0 + i] *
+                       dot_rows(v_t.data() + (size_t)j * v_t.stride(),
+                                v_t.data() + (size_t)i * v_t.stride(), mk);
+            }
+            for (unsigned int j = 0; j < i; j++)
+            {
+                double x = 0.0;
+                for (unsigned int p = j; p < i; p++)
+                {
+                    x += t(j, p) * w[p];
+                }
+                t(j, i) = x;
+            }
+        }
+
+        double *c = q + (size_t)k0 * ld + j0;
+
+        gemm(kb, nt, mk, 1.0, v_t.data(), v_t.stride(), c, ld, 0.0,
+             w_block.data(), w_block.stride());
+
+        /* W = T^T * W, bottom row first so the rows still needed are intact */
+        for (unsigned int i = kb; i-- > 0;)
+        {
+            double *w_i = w_block.data() + (size_t)i * w_block.stride();
+            const double t_ii = t(i, i);
+
+            for (unsigned int j = 0; j < nt; j++)
+            {
+                w_i[j] *= t_ii;
+            }
+            for (unsigned int p = 0; p < i; p++)
+            {
+                subtract_scaled_row(w_i,
+                                    w_block.data() + (size_t)p * w_block.stride(),
+                                    -t(p, i), nt);
+            }
+        }
+
+        gemm(mk, nt, kb, -1.0, v.data(), v.stride(), w_block.data(),
+             w_block.stride(), 1.0, c, ld);
+    }
+
+    /* Treat diagonal entries at rounding level of the largest as zero */
+    double r_max = 0.0;
+    for (unsigned int k = 0; k < n; k++)
+    {
+        r_max = fmax(r_max, fabs(qr(k, k)));
+    }
+
+    const double tolerance = r_max * m * DBL_EPSILON;
+    rank_deficient = (r_max == 0.0);
+    for (unsigned int k = 0; k < n; k++)
+    {
+        if (fabs(qr(k, k)) <= tolerance)
+        {
+            rank_deficient = true;
+        }
+    }
+
+    return rank_deficient ? tensor_status::FAILURE : tensor_status::SUCCESS;
+}
+
+tensor_status qr_factorization::apply_qt(tensor &b) const
+{
+    if (b.m_height != qr.m_height)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    vector<double> w(b.n_width);
+
+    for (unsigned int k = 0; k < qr.n_width; k++)
+    {
+        apply_reflector(qr, k, tau[k], b.data(), b.stride(), 0, b.n_width,
+                        w.data());
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status qr_factorization::least_squares(const tensor &b,
+                                              tensor &x) const
+{
+    const unsigned int n = qr.n_width;
+    const unsigned int p = b.n_width;
+
+    if (rank_deficient || (b.m_height != qr.m_height) ||
+        (x.m_height != n) || (x.n_width != p))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    tensor y = copy(b);
+    apply_qt(y);
+
+    /* Back substitution with R over the first n rows of Q^T * b */
+    for (unsigned int i = n; i-- > 0;)
+    {
+        double *x_i = x.data() + (size_t)i * x.stride();
+
+        memcpy(x_i, y.data() + (size_t)i * y.stride(), p * sizeof(double));
+        for (unsigned int k = i + 1; k < n; k++)
+        {
+            subtract_scaled_row(x_i, x.data() + (size_t)k * x.stride(),
+                                qr(i, k), p);
+        }
+
+        const double diagonal_inv = 1.0 / qr(i, i);
+        for (unsigned int j = 0; j < p; j++)
+        {
+            x_i[j] *= diagonal_inv;
+        }
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status qr_factorization::get_r(tensor &r) const
+{
+    const unsigned int n = qr.n_width;
+
+    if ((r.m_height != n) || (r.n_width != n))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    for (unsigned int i = 0; i < n; i++)
+    {
+        for (unsigned int j = 0; j < n; j++)
+        {
+            r(i, j) = (j >= i) ? qr(i, j) : 0.0;
+        }
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status cholesky_factorization::factor(const tensor &a)
+{
+    const unsigned int n = a.m_height;
+
+    positive_definite = false;
+
+    if (a.m_height != a.n_width)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    l = copy(a);
+
+    const unsigned int ld = l.stride();
+    double *d = l.data();
+
+    for (unsigned int k0 = 0; k0 < n; k0 += FACTORIZATION_BLOCK)
+    {
+        const unsigned int kb = FACTORIZATION_MIN(FACTORIZATION_BLOCK, n - k0);
+        const unsigned int k1 = k0 + kb;
+
+        /* Diagonal block, unblocked (its trailing updates are already in) */
+        for (unsigned int j = k0; j < k1; j++)
+        {
+            double *l_j = d + (size_t)j * ld;
+            const double diagonal =
+                l_j[j] - dot_rows(l_j + k0, l_j + k0, j - k0);
+
+            if (diagonal <= 0.0)
+            {
+                return tensor_status::FAILURE;
+            }
+
+            l_j[j] = sqrt(diagonal);
+
+            for (unsigned int i = j + 1; i < k1; i++)
+            {
+                double *l_i = d + (size_t)i * ld;
+                l_i[j] = (l_i[j] - dot_rows(l_i + k0, l_j + k0, j - k0)) /
+                         l_j[j];
+            }
+        }
+
+        if (k1 >= n)
+        {
+            break;
+        }
+
+        /* Panel below the block: L21 * L11^T = A21, row by row */
+        for (unsigned int i = k1; i < n; i++)
+        {
+            double *l_i = d + (size_t)i * ld;
+
+            for (unsigned int j = k0; j < k1; j++)
+            {
+                const double *l_j = d + (size_t)j * ld;
+                l_i[j] = (l_i[j] - dot_rows(l_i + k0, l_j + k0, j - k0)) /
+                         l_j[j];
+            }
+        }
+
+        /* Trailing update of the lower triangle, A22 -= L21 * L21^T, one
+         * block row at a time so the upper triangle is mostly skipped */
+        const unsigned int n2 = n - k1;
+        tensor l21_t(kb, n2);
+
+        for (unsigned int i = 0; i < n2; i++)
+        {
+            for (unsigned int j = 0; j < kb; j++)
+            {
+                l21_t(j, i) = l(k1 + i, k0 + j);
+            }
+        }
+
+        for (unsigned int r0 = 0; r0 < n2; r0 += FACTORIZATION_BLOCK)
+        {
+            const unsigned int rb = FACTORIZATION_MIN(FACTORIZATION_BLOCK,
+                                                      n2 - r0);
+
+            gemm(rb, r0 + rb, kb, -1.0, d + (size_t)(k1 + r0) * ld + k0, ld,
+                 l21_t.data(), l21_t.stride(), 1.0,
+                 d + (size_t)(k1 + r0) * ld + k1, ld);
+        }
+    }
+
+    /* Clear the (never read) upper triangle */
+    for (unsigned int i = 0; i < n; i++)
+    {
+        for (unsigned int j = i + 1; j < n; j++)
+        {
+            l(i, j) = 0.0;
+        }
+    }
+
+    positive_definite = true;
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status cholesky_factorization::solve(const tensor &b, tensor &x) const
+{
+    if ((x.m_height != b.m_height) || (x.n_width != b.n_width))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    if (x.data() != b.data())
+    {
+        for (unsigned int i = 0; i < b.m_height; i++)
+        {
+            memcpy(x.data() + (size_t)i * x.stride(),
+                   b.data() + (size_t)i * b.stride(),
+                   b.n_width * sizeof(double));
+        }
+    }
+
+    return solve_in_place(x);
+}
+
+tensor_status cholesky_factorization::solve_in_place(tensor &b) const
+{
+    const unsigned int n = l.m_height;
+    const unsigned int p = b.n_width;
+
+    if (!positive_definite || (b.m_height != n))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    /* Forward substitution: L * y = b */
+    for (unsigned int i = 0; i < n; i++)
+    {
+        const double *l_row = l.data() + (size_t)i * l.stride();
+        double *b_i = b.data() + (size_t)i * b.stride();
+
+        for (unsigned int k = 0; k < i; k++)
+        {
+            if (l_row[k] != 0.0)
+            {
+                subtract_scaled_row(b_i, b.data() + (size_t)k * b.stride(),
+                                    l_row[k], p);
+            }
+        }
+
+        const double diagonal_inv = 1.0 / l_row[i];
+        for (unsigned int j = 0; j < p; j++)
+        {
+            b_i[j] *= diagonal_inv;
+        }
+    }
+
+    /* Back substitution: L^T * x = y, pushing each solved row upwards */
+    for (unsigned int i = n; i-- > 0;)
+    {
+        const double *l_row = l.data() + (size_t)i * l.stride();
+        double *b_i = b.data() + (size_t)i * b.stride();
+
+        const double diagonal_inv = 1.0 / l_row[i];
+        for (unsigned int j = 0; j < p; j++)
+        {
+            b_i[j] *= diagonal_inv;
+        }
+
+        for (unsigned int k = 0; k < i; k++)
+        {
+            if (l_row[k] != 0.0)
+            {
+                subtract_scaled_row(b.data() + (size_t)k * b.stride(), b_i,
+                                    l_row[k], p);
+            }
+        }
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+/**
+ * @brief Rank-1 modification of a Cholesky factor through Givens-like
+ * rotations, for sign = +1 (update) or -1 (downdate)
+ * @return false if the downdated matrix is not positive-definite
+ */
+static bool rank_one_modify(tensor &l, vector<double> &x, double sign)
+{
+    const unsigned int n = l.m_height;
+
+    for (unsigned int k = 0; k < n; k++)
+    {
+        const double l_kk = l(k, k);
+        const double r_sq = l_kk * l_kk + sign * x[k] * x[k];
+
+        if (r_sq <= 0.0)
+        {
+            return false;
+        }
+
+        const double r = sqrt(r_sq);
+        const double c = r / l_kk;
+        const double s = x[k] / l_kk;
+
+        l(k, k) = r;
+        for (unsigned int i = k + 1; i < n; i++)
+        {
+            l(i, k) = (l(i, k) + sign * s * x[i]) / c;
+            x[i] = c * x[i] - s * l(i, k);
+        }
+    }
+
+    return true;
+}
+
+tensor_status cholesky_factorization::update(const tensor &x)
+{
+    if (!positive_definite || (x.m_height != l.m_height) || (x.n_width != 1))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    vector<double> work(x.m_height);
+    for (unsigned int i = 0; i < x.m_height; i++)
+    {
+        work[i] = x(i, 0);
+    }
+
+    rank_one_modify(l, work, 1.0);
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status cholesky_factorization::downdate(const tensor &x)
+{
+    if (!positive_definite || (x.m_height != l.m_height) || (x.n_width != 1))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    vector<double> work(x.m_height);
+    for (unsigned int i = 0; i < x.m_height; i++)
+    {
+        work[i] = x(i, 0);
+    }
+
+    /* Work on a copy, so a failed downdate leaves the factor untouched */
+    tensor l_new = copy(l);
+    if (!rank_one_modify(l_new, work, -1.0))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    swap(l, l_new);
+
+    return tensor_status::SUCCESS;
+}
+
+double cholesky_factorization::determinant(void) const
+{
+    if (!positive_definite)
+    {
+        return 0.0;
+    }
+
+    double det = 1.0;
+
+    for (unsigned int i = 0; i < l.m_height; i++)
+    {
+        det *= l(i, i) * l(i, i);
+    }
+
+    return det;
+}
+
+tensor_status cholesky_factorization::get_l(tensor &l_out) const
+{
+    if ((l_out.m_height != l.m_height) || (l_out.n_width != l.n_width))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    l_out = copy(l);
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status least_squares(const tensor &a, const tensor &b, tensor &x)
+{
+    qr_factorization qr(a);
+
+    return qr.least_squares(b, x);
+}
+
+/******************************************************************************
+ * UNIT TESTS
+ *****************************************************************************/
+#ifdef TESTING_FACTORIZATION
+
+int main(void)
+{
+#ifdef TEST_LU_FACTORIZATION
+    {
+        cout << "TEST_LU_FACTORIZATION\r\n";
+        tensor a(vector<vector<double>>{{1.0, 2.0, 3.0}, {0.0, 1.0, 4.0}, {5.0, 6.0, 1.0}});
+        lu_factorization f(a);
+
+        cout << "determinant = " << f.determinant() << "\r\n";
+
+        tensor a_inv(3, 3);
+        f.inverse(a_inv);
+        a_inv.print();
+
+        /* Many right-hand sides against one factorization */
+        tensor b(vector<vector<double>>{{1.0, 14.0, 0.0}, {2.0, 14.0, 0.0}, {3.0, 20.0, 1.0}});
+        tensor x(3, 3);
+        f.solve(b, x);
+        x.print();
+        cout << "residual A * x - b:\r\n";
+        tensor r = copy(b);
+        gemv(1.0, a, x, -1.0, r);
+        r.print();
+
+        /* A zero leading pivot needs a row interchange */
+        tensor c(vector<vector<double>>{{0.0, 2.0}, {3.0, 1.0}});
+        lu_factorization g(c);
+        cout << "determinant = " << g.determinant() << "\r\n";
+        tensor d(vector<vector<double>>{{4.0}, {5.0}});
+        g.solve_in_place(d);
+        d.print();
+
+        tensor s(vector<vector<double>>{{1.0, 2.0}, {2.0, 4.0}});
+        lu_factorization h(s);
+        cout << "singular = " << h.is_singular()
+             << ", solve status = " << (int)h.solve_in_place(d) << "\r\n";
+
+        /* A singular inverse fails without touching the destination */
+        tensor s_inv(vector<vector<double>>{{7.0, 7.0}, {7.0, 7.0}});
+        tensor_status status = invert(s, s_inv);
+        cout << "invert status = " << (int)status << ", inverse untouched = "
+             << (s_inv(0, 0) == 7.0 && s_inv(1, 1) == 7.0) << "\r\n";
+    }
+#endif
+
+#ifdef TEST_QR_FACTORIZATION
+    {
+        cout << "TEST_QR_FACTORIZATION\r\n";
+        /* Fit y = 1 - 2 t + 0.5 t^2 through 200 noiseless samples, using more
+         * columns than one panel so the blocked path is exercised */
+        const unsigned int m = 200;
+        const unsigned int n = 40;
+        tensor a(m, n);
+        tensor y(m);
+        for (unsigned int i = 0; i < m; i++)
+        {
+            const double t = -1.0 + 2.0 * i / (m - 1);
+            y(i, 0) = 1.0 - 2.0 * t + 0.5 * t * t;
+            for (unsigned int j = 0; j < n; j++)
+            { /* Chebyshev columns keep the problem well conditioned */
+                a(i, j) = cos(j * acos(t));
+            }
+        }
+
+        tensor x(n);
+        least_squares(a, y, x);
+        cout << "coefficients of T0, T1, T2 = " << x(0, 0) << ", " << x(1, 0)
+             << ", " << x(2, 0) << "\r\n";
+
+        double max_rest = 0.0;
+        for (unsigned int j = 3; j < n; j++)
+        {
+            max_rest = fmax(max_rest, fabs(x(j, 0)));
+        }
+        cout << "max |higher coefficients| = " << max_rest << "\r\n";
+
+        /* R^T * R must equal A^T * A */
+        qr_factorization f(a);
+        tensor r(n, n);
+        f.get_r(r);
+        tensor rtr = multiply(transpose(r), r);
+        tensor ata = multiply(transpose(a), a);
+        double max_error = 0.0;
+        for (unsigned int i = 0; i < n; i++)
+        {
+            for (unsigned int j = 0; j < n; j++)
+            {
+                max_error = fmax(max_error, fabs(rtr(i, j) - ata(i, j)));
+            }
+        }
+        cout << "max |R^T * R - A^T * A| = " << max_error << "\r\n";
+
+        tensor d(vector<vector<double>>{{1.0, 2.0}, {2.0, 4.0}, {3.0, 6.0}});
+        qr_factorization g(d);
+        cout << "rank deficient = " << g.is_rank_deficient() << "\r\n";
+    }
+#endif
+
+#ifdef TEST_CHOLESKY_FACTORIZATION
+    {
+        cout << "TEST_CHOLESKY_FACTORIZATION\r\n";
+        /* A = B * B^T + n * I is symmetric positive-definite */
+        const unsigned int n = 200;
+        tensor b(n, n);
+        for (unsigned int i = 0; i < n; i++)
+        {
+            for (unsigned int j = 0; j < n; j++)
+            {
+                b(i, j) = sin(1.0 + i * 0.37 + j * 0.11);
+            }
+        }
+        tensor a = multiply(b, transpose(b));
+        for (unsigned int i = 0; i < n; i++)
+        {
+            a(i, i) += n;
+        }
+
+        cholesky_factorization f(a);
+        tensor rhs(n);
+        for (unsigned int i = 0; i < n; i++)
+        {
+            rhs(i, 0) = cos(0.1 * i);
+        }
+        tensor x(n);
+        f.solve(rhs, x);
+        tensor r = copy(rhs);
+        gemv(1.0, a, x, -1.0, r);
+        cout << "positive definite = " << f.is_positive_definite()
+             << ", ||A * x - b|| = " << norm(r) << "\r\n";
+
+        /* An update then a downdate must match refactoring from scratch */
+        tensor v(n);
+        for (unsigned int i = 0; i < n; i++)
+        {
+            v(i, 0) = 0.5 * sin(0.3 * i);
+        }
+        f.update(v);
+        tensor a_plus = copy(a);
+        for (unsigned int i = 0; i < n; i++)
+        {
+            for (unsigned int j = 0; j < n; j++)
+            {
+                a_plus(i, j) += v(i, 0) * v(j, 0);
+            }
+        }
+        cholesky_factorization g(a_plus);
+        tensor l_updated(n, n);
+        tensor l_refactored(n, n);
+        f.get_l(l_updated);
+        g.get_l(l_refactored);
+        double max_error = 0.0;
+        for (unsigned int i = 0; i < n; i++)
+        {
+            for (unsigned int j = 0; j < n; j++)
+            {
+                max_error = fmax(max_error,
+                                 fabs(l_updated(i, j) - l_refactored(i, j)));
+            }
+        }
+        cout << "max |L updated - L refactored| = " << max_error << "\r\n";
+
+        f.downdate(v);
+        cholesky_factorization h(a);
+        f.get_l(l_updated);
+        h.get_l(l_refactored);
+        max_error = 0.0;
+        for (unsigned int i = 0; i < n; i++)
+        {
+            for (unsigned int j = 0; j < n; j++)
+            {
+                max_error = fmax(max_error,
+                                 fabs(l_updated(i, j) - l_refactored(i, j)));
+            }
+        }
+        cout << "max |L downdated - L refactored| = " << max_error << "\r\n";
+
+        /* Downdating the identity by a long vector must fail and leave it */
+        tensor e = eye(2, 2);
+        cholesky_factorization k(e);
+        tensor w(vector<vector<double>>{{2.0}, {0.0}});
+        cout << "downdate status = " << (int)k.downdate(w)
+             << ", determinant = " << k.determinant() << "\r\n";
+    }
+#endif
+    return 0;
+}
+#endif
@@ -0,0 +1,72 @@
+/**
+* @file file_io.cpp
+*
+* @brief POSIX file helpers shared by the binary formats and the .dat
+* emitter: complete writes, and private memory maps owned by a shared_ptr
+*
+* @author Pavlo Vlastos
+*/
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "file_io.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/******************************************************************************
+ * PUBLIC FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+tensor_status write_all(int fd, const void *data, size_t size)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+
+    while (size > 0)
+    {
+        ssize_t written = ::write(fd, bytes, size);
+        if (written <= 0)
+        {
+            return tensor_status::FAILURE;
+        }
+        bytes += written;
+        size -= (size_t)written;
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status map_file(const char *path, size_t min_size,
+                       shared_ptr<void> &mapping, size_t &size)
+{
+    int fd = (path != nullptr) ? ::open(path, O_RDONLY) : -1;
+    if (fd < 0)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    struct stat info;
+    if ((fstat(fd, &info) != 0) || (info.st_size <= 0) ||
+        ((size_t)info.st_size < min_size))
+    {
+        ::close(fd);
+        return tensor_status::FAILURE;
+    }
+
+    const size_t mapped_size = (size_t)info.st_size;
+    void *address = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE, fd, 0);
+    ::close(fd); /* The mapping holds on to the file by itself */
+
+    if (address == MAP_FAILED)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    mapping = shared_ptr<void>(address, [mapped_size](void *p)
+                               { munmap(p, mapped_size); });
+    size = mapped_size;
+
+    return tensor_status::SUCCESS;
+}
@@ -0,0 +1,389 @@
+/**
+* @file force_schedule.cpp
+*
+* @brief A timeline of input forces, compiled into a sorted array of
+* constant and linearly interpolated segments over sample steps
+*
+* @author Pavlo Vlastos
+*/
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "force_schedule.h"
+#include <algorithm>
+#include <math.h>
+
+/******************************************************************************
+ * PRIVATE FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+unsigned int force_schedule::find(unsigned long i) const
+{
+    /* The first segment starts at step 0, so there always is one */
+    auto after = upper_bound(segments.begin(), segments.end(), i,
+                             [](unsigned long step, const force_segment &s)
+                             { return step < s.begin; });
+
+    return (unsigned int)(after - segments.begin()) - 1;
+}
+
+unsigned long force_schedule::segment_end(unsigned int k,
+                                          unsigned long last) const
+{
+    if ((k + 1 < segments.size()) && (segments[k + 1].begin < last))
+    {
+        return segments[k + 1].begin;
+    }
+
+    return last;
+}
+
+/******************************************************************************
+ * PUBLIC FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+tensor_status force_schedule::add(double t_begin, double t_end,
+                                  const double *u)
+{
+    return add(t_begin, t_end, u, u);
+}
+
+tensor_status force_schedule::add(double t_begin, double t_end,
+                                  const double *u_begin, const double *u_end)
+{
+    if (!(t_end > t_begin) || (t_begin < 0.0) || (u_begin == nullptr) ||
+        (u_end == nullptr))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    piece p;
+    p.t_begin = t_begin;
+    p.t_end = t_end;
+    for (unsigned int s = 0; s < INPUT_SIZE; s++)
+    {
+        p.u_begin[s] = u_begin[s];
+        p.u_end[s] = u_end[s];
+    }
+
+    pieces.push_back(p);
+    segments.clear(); /* Stale until compiled again */
+
+    return tensor_status::SUCCESS;
+}
+
+void force_schedule::clear(void)
+{
+    pieces.clear();
+    segments.clear();
+    dt = 0.0;
+}
+
+tensor_status force_schedule::compile(double dt_in)
+{
+    if (dt_in <= 0.0)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    dt = dt_in;
+    segments.clear();
+
+    /* Every piece's first and last step bound a segment */
+    vector<unsigned long> first(pieces.size());
+    vector<unsigned long> last(pieces.size());
+    vector<unsigned long> bounds(1, 0);
+
+    for (size_t p = 0; p < pieces.size(); p++)
+    {
+        first[p] = (unsigned long)llround(pieces[p].t_begin / dt);
+        last[p] = (unsigned long)llround(pieces[p].t_end / dt);
+        bounds.push_back(first[p]);
+        bounds.push_back(last[p]);
+    }
+
+    sort(bounds.begin(), bounds.end());
+    bounds.erase(unique(bounds.begin(), bounds.end()), bounds.end());
+
+    /* Sum the pieces over each stretch between bounds. A schedule holds a
+     * handful of pieces, so each stretch simply visits all of them. */
+    for (size_t b = 0; b < bounds.size(); b++)
+    {
+        force_segment segment;
+        segment.begin = bounds[b];
+        segment.constant = true;
+
+        for (unsigned int s = 0; s < INPUT_SIZE; s++)
+        {
+            segment.u[s] = 0.0;
+            segment.slope[s] = 0.0;
+        }
+
+        for (size_t p = 0; (b + 1 < bounds.size()) && (p < pieces.size());
+             p++)
+        {
+            if ((first[p] > bounds[b]) || (last[p] < bounds[b + 1]))
+            {
+                continue;
+            }
+
+            /* u(t) = u_begin + rate * (t - t_begin), sampled at t = i * dt */
+            const piece &q = pieces[p];
+            const double span = q.t_end - q.t_begin;
+            const double t = (double)segment.begin * dt;
+
+            for (unsigned int s = 0; s < INPUT_SIZE; s++)
+            {
+                const double rate = (q.u_end[s] - q.u_begin[s]) / span;
+                segment.u[s] += q.u_begin[s] + rate * (t - q.t_begin);
+                segment.slope[s] += rate * dt;
+            }
+        }
+
+        for (unsigned int s = 0; s < INPUT_SIZE; s++)
+        {
+            segment.constant = segment.constant && (segment.slope[s] == 0.0);
+        }
+
+        /* A constant stretch continuing the last one extends it */
+        if (!segments.empty() && segment.constant &&
+            segments.back().constant &&
+            equal(segment.u, segment.u + INPUT_SIZE, segments.back().u))
+        {
+            continue;
+        }
+
+        segments.push_back(segment);
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status force_schedule::run(particle &p, unsigned long first,
+                                  unsigned long steps) const
+{
+    if (segments.empty() || (p.get_sample_time() != dt))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    const unsigned long last = first + steps;
+    unsigned long i = first;
+
+    for (unsigned int k = find(first); i < last; k++)
+    {
+        const force_segment &s = segments[k];
+        const unsigned long stop = segment_end(k, last);
+
+        if (s.constant)
+        {
+            p.set_u(s.u[0], s.u[1], s.u[2], s.u[3], s.u[4], s.u[5]);
+            if (p.advance(stop - i) != tensor_status::SUCCESS)
+            {
+                return tensor_status::FAILURE;
+            }
+            i = stop;
+            continue;
+        }
+
+        for (; i < stop; i++)
+        {
+            const double d = (double)(i - s.begin);
+            p.set_u(s.u[0] + s.slope[0] * d, s.u[1] + s.slope[1] * d,
+                    s.u[2] + s.slope[2] * d, s.u[3] + s.slope[3] * d,
+                    s.u[4] + s.slope[4] * d, s.u[5] + s.slope[5] * d);
+            if (p.update() != tensor_status::SUCCESS)
+            {
+                return tensor_status::FAILURE;
+            }
+        }
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status force_schedule::run(particle_system &system, unsigned int begin,
+                                  unsigned int end, unsigned long first,
+                                  unsigned long steps) const
+{
+    if (segments.empty() || (system.get_sample_time() != dt) ||
+        (begin > end) || (end > system.size()))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    const unsigned long last = first + steps;
+    unsigned long i = first;
+
+    for (unsigned int k = find(first); i < last; k++)
+    {
+        const force_segment &s = segments[k];
+        const unsigned long stop = segment_end(k, last);
+
+        /* The input only changes at segment bounds, or every step of a ramp */
+        for (; i < stop; i++)
+        {
+            const double d = (double)(i - s.begin);
+            for (unsigned int c = 0; c < INPUT_SIZE; c++)
+            {
+                const double value = s.u[c] + s.slope[c] * d;
+                double *input = system.input_component(c);
+                fill(input + begin, input + end, value);
+            }
+
+            if (s.constant)
+            {
+                if (system.advance(begin, end, stop - i) !=
+                    tensor_status::SUCCESS)
+                {
+                    return tensor_status::FAILURE;
+                }
+                i = stop;
+                break;
+            }
+
+            if (system.update(begin, end) != tensor_status::SUCCESS)
+            {
+                return tensor_status::FAILURE;
+            }
+        }
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+/******************************************************************************
+ * Getters
+******************************************************************************/
+tensor_status force_schedule::sample(unsigned long i, double *u) const
+{
+    if (segments.empty() || (u == nullptr))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    const force_segment &s = segments[find(i)];
+    const double d = (double)(i - s.begin);
+
+    for (unsigned int c = 0; c < INPUT_SIZE; c++)
+    {
+        u[c] = s.u[c] + s.slope[c] * d;
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+/******************************************************************************
+ * UNIT TESTS
+ *****************************************************************************/
+#ifdef TESTING_FORCE_SCHEDULE
+
+#include <time.h>
+
+int main(void)
+{
+#ifdef TEST_FORCE_SCHEDULE_IMPULSE
+    {
+        cout << "TEST_FORCE_SCHEDULE_IMPULSE\r\n";
+        /* The step response of TEST_PARTICLE_UPDATE, without the if (i == 1)
+         * in the loop */
+        particle a(1.2, 2.5, -1.125);
+        particle b(1.2, 2.5, -1.125);
+        a.set_mass(0.001);
+        b.set_mass(0.001);
+
+        a.set_u(2000.0, 1000.0, 0.0, 0.0, 0.0, 0.0);
+        for (unsigned int i = 0; i < 1000; i++)
+        {
+            if (i == 1)
+            {
+                a.set_u(0.0, 0.0, 0.0, 0.0, 0.0, 0.0);
+            }
+            a.update();
+        }
+
+        force_schedule schedule;
+        const double impulse[INPUT_SIZE] = {2000.0, 1000.0, 0.0,
+                                            0.0, 0.0, 0.0};
+        schedule.add(0.0, 0.001, impulse);
+        schedule.compile(0.001);
+        schedule.run(b, 0, 1000);
+
+        tensor xa = a.get_state();
+        tensor xb = b.get_state();
+        double max_error = 0.0;
+        for (unsigned int s = 0; s < STATE_SIZE; s++)
+        {
+            max_error = fmax(max_error, fabs(xa(s, 0) - xb(s, 0)));
+        }
+        cout << schedule.get_segments().size()
+             << " segments, max |set_u loop - schedule| = " << max_error
+             << "\r\n";
+    }
+#endif
+
+#ifdef TEST_FORCE_SCHEDULE_RAMP
+    {
+        cout << "TEST_FORCE_SCHEDULE_RAMP\r\n";
+        /* A thrust ramping up over 1 s, held for 2 s, with a 0.5 s kick on
+         * top, then a coast: the same as setting each step's input by hand */
+        const double dt = 0.001;
+        const double zero[INPUT_SIZE] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+        const double full[INPUT_SIZE] = {10.0, 0.0, 5.0, 0.0, 0.2, 0.0};
+        const double kick[INPUT_SIZE] = {0.0, 3.0, 0.0, 0.0, 0.0, 0.0};
+        force_schedule schedule;
+        schedule.add(0.0, 1.0, zero, full);
+        schedule.add(1.0, 3.0, full);
+        schedule.add(2.0, 2.5, kick);
+        schedule.compile(dt);
+
+        const unsigned long steps = 100000;
+        particle a(0.0, 0.0, 0.0);
+        particle b(0.0, 0.0, 0.0);
+        particle_system c;
+        c.add_particle(0.0, 0.0, 0.0);
+        c.add_particle(0.0, 0.0, 0.0);
+
+        clock_t start = clock();
+        for (unsigned long i = 0; i < steps; i++)
+        {
+            double u[INPUT_SIZE];
+            const double t = (double)i * dt;
+            for (unsigned int s = 0; s < INPUT_SIZE; s++)
+            {
+                u[s] = ((t < 1.0) ? full[s] * t
+                                  : ((t < 3.0) ? full[s] : 0.0)) +
+                       (((t >= 2.0) && (t < 2.5)) ? kick[s] : 0.0);
+            }
+            a.set_u(u[0], u[1], u[2], u[3], u[4], u[5]);
+            a.update();
+        }
+        double loop_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        start = clock();
+        schedule.run(b, 0, 2000);
+        schedule.run(b, 2000, steps - 2000); /* Resumed mid-segment */
+        double schedule_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+        schedule.run(c, 0, 2, 0, steps);
+
+        tensor xa = a.get_state();
+        tensor xb = b.get_state();
+        tensor xc(STATE_SIZE);
+        c.get_state(1, xc);
+        double max_error = 0.0;
+        double system_error = 0.0;
+        for (unsigned int s = 0; s < STATE_SIZE; s++)
+        {
+            max_error = fmax(max_error, fabs(xa(s, 0) - xb(s, 0)));
+            system_error = fmax(system_error, fabs(xb(s, 0) - xc(s, 0)));
+        }
+        cout << schedule.get_segments().size() << " segments, " << steps
+             << " steps: loop " << loop_seconds << " s, schedule "
+             << schedule_seconds << " s\r\n";
+        cout << "x = " << xb(0, 0) << ", max |loop - schedule| = "
+             << max_error << ", max |particle - particle_system| = "
+             << system_error << "\r\n";
+    }
+#endif
+    return 0;
+}
+#endif
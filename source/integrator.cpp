@@ -0,0 +1,600 @@
+/**
+* @file integrator.cpp
+*
+* @brief An adaptive-step Dormand-Prince RK5(4) integrator with dense output,
+* for the continuous dynamics of particles driven by arbitrary forces
+*
+* @author Pavlo Vlastos
+*/
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "integrator.h"
+#include <math.h>
+#include <float.h>
+
+/******************************************************************************
+ * DEFINES
+ *****************************************************************************/
+#define ERROR_EXPONENT (-1.0 / 5.0) /* -1 / (order of the error + 1) */
+
+/******************************************************************************
+ * GLOBAL VARIABLES AND DATATYPES
+ *****************************************************************************/
+/* The Dormand-Prince tableau */
+static const double C[DORMAND_PRINCE_STAGES] = {
+    0.0, 1.0 / 5.0, 3.0 / 10.0, 4.0 / 5.0, 8.0 / 9.0, 1.0, 1.0};
+
+static const double A[DORMAND_PRINCE_STAGES][DORMAND_PRINCE_STAGES - 1] = {
+    {0.0, 0.0, 0.0, 0.0, 0.0, 0.0},
+    {1.0 / 5.0, 0.0, 0.0, 0.0, 0.0, 0.0},
+    {3.0 / 40.0, 9.0 / 40.0, 0.0, 0.0, 0.0, 0.0},
+    {44.0 / 45.0, -56.0 / 15.0, 32.0 / 9.0, 0.0, 0.0, 0.0},
+    {19372.0 / 6561.0, -25360.0 / 2187.0, 64448.0 / 6561.0, -212.0 / 729.0,
+     0.0, 0.0},
+    {9017.0 / 3168.0, -355.0 / 33.0, 46732.0 / 5247.0, 49.0 / 176.0,
+     -5103.0 / 18656.0, 0.0},
+    {35.0 / 384.0, 0.0, 500.0 / 1113.0, 125.0 / 192.0, -2187.0 / 6784.0,
+     11.0 / 84.0}};
+
+/* The fifth order weights are the last row of A (hence FSAL). E holds the
+ * difference between the fifth and fourth order weights. */
+static const double E[DORMAND_PRINCE_STAGES] = {
+    71.0 / 57600.0, 0.0, -71.0 / 16695.0, 71.0 / 1920.0, -17253.0 / 339200.0,
+    22.0 / 525.0, -1.0 / 40.0};
+
+/* Dense output: y(t_old + x h) = y_old + h * sum_i k[i] * sum_j P[i][j] x^(j+1)
+ * (Dormand and Prince, as in Hairer's DOPRI5 and SciPy's RK45) */
+static const double P[DORMAND_PRINCE_STAGES][DORMAND_PRINCE_DENSE_ORDER] = {
+    {1.0, -8048581381.0 / 2820520608.0, 8663915743.0 / 2820520608.0,
+     -12715105075.0 / 11282082432.0},
+    {0.0, 0.0, 0.0, 0.0},
+    {0.0, 131558114200.0 / 32700410799.0, -68118460800.0 / 10900136933.0,
+     87487479700.0 / 32700410799.0},
+    {0.0, -1754552775.0 / 470086768.0, 14199869525.0 / 1410260304.0,
+     -10690763975.0 / 1880347072.0},
+    {0.0, 127303824393.0 / 49829197408.0, -318862633887.0 / 49829197408.0,
+     701980252875.0 / 199316789632.0},
+    {0.0, -282668133.0 / 205662961.0, 2019193451.0 / 616988883.0,
+     -1453857185.0 / 822651844.0},
+    {0.0, 40617522.0 / 29380423.0, -110615467.0 / 29380423.0,
+     69997945.0 / 29380423.0}};
+
+/******************************************************************************
+ * PRIVATE FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+tensor_status dormand_prince::evaluate(double t_eval, const tensor &y_eval,
+                                       tensor &dy)
+{
+    evaluations++;
+    return f(t_eval, y_eval, dy);
+}
+
+double dormand_prince::scaled_rms(const tensor &a, const tensor &y_a,
+                                  const tensor &y_b) const
+{
+    double sum = 0.0;
+
+    for (unsigned int i = 0; i < n; i++)
+    {
+        const double scale =
+            atol + rtol * fmax(fabs(y_a(i, 0)), fabs(y_b(i, 0)));
+        const double e = a(i, 0) / scale;
+        sum += e * e;
+    }
+
+    return sqrt(sum / n);
+}
+
+tensor_status dormand_prince::select_initial_step(void)
+{
+    /* Hairer, Norsett and Wanner, Solving ODEs I, II.4: a first guess from
+     * |y| / |y'|, then refined by the size of y'' from one Euler step */
+    const double d0 = scaled_rms(y, y, y);
+    const double d1 = scaled_rms(k[0], y, y);
+    const double h0 = ((d0 < 1e-5) || (d1 < 1e-5)) ? 1e-6 : 0.01 * d0 / d1;
+
+    for (unsigned int i = 0; i < n; i++)
+    {
+        y_temp(i, 0) = y(i, 0) + h0 * k[0](i, 0);
+    }
+
+    if (evaluate(t + h0, y_temp, k[1]) != tensor_status::SUCCESS)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    for (unsigned int i = 0; i < n; i++)
+    {
+        k[2](i, 0) = k[1](i, 0) - k[0](i, 0);
+    }
+
+    const double d2 = scaled_rms(k[2], y, y) / h0;
+    const double d_max = fmax(d1, d2);
+    const double h1 = (d_max <= 1e-15) ? fmax(1e-6, h0 * 1e-3)
+                                       : pow(0.01 / d_max, 1.0 / 5.0);
+
+    h = fmin(100.0 * h0, h1);
+
+    return tensor_status::SUCCESS;
+}
+
+/******************************************************************************
+ * PUBLIC FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+dormand_prince::dormand_prince(unsigned int n_in)
+    : n(n_in), y(n_in), y_old(n_in), y_new(n_in), y_temp(n_in),
+      k(DORMAND_PRINCE_STAGES, tensor(n_in))
+{
+}
+
+tensor_status dormand_prince::initialize(const derivative_function &f_in,
+                                         double t0, const tensor &y0)
+{
+    if ((f_in == nullptr) || (y0.m_height != n) || (y0.n_width != 1))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    f = f_in;
+    t = t0;
+    t_old = t0;
+    h_last = 0.0;
+    accepted_steps = 0;
+    rejected_steps = 0;
+    evaluations = 0;
+    fsal_pending = false;
+    initialized = false;
+
+    for (unsigned int i = 0; i < n; i++)
+    {
+        y(i, 0) = y0(i, 0);
+        y_old(i, 0) = y0(i, 0);
+    }
+
+    if (evaluate(t, y, k[0]) != tensor_status::SUCCESS)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    if (h_initial > 0.0)
+    {
+        h = h_initial;
+    }
+    else if (select_initial_step() != tensor_status::SUCCESS)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    initialized = true;
+    return tensor_status::SUCCESS;
+}
+
+tensor_status dormand_prince::step(double t_bound)
+{
+    if ((!initialized) || (t_bound <= t))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    if (fsal_pending)
+    { /* The last stage of the previous step is f(t, y) */
+        swap(k[0], k[DORMAND_PRINCE_STAGES - 1]);
+        fsal_pending = false;
+    }
+
+    bool rejected = false;
+
+    while (true)
+    {
+        /* Below this the step no longer changes t */
+        const double h_floor = fmax(h_min, 10.0 * DBL_EPSILON * fabs(t));
+
+        if (h_max > 0.0)
+        {
+            h = fmin(h, h_max);
+        }
+
+        if (h < h_floor)
+        {
+            return tensor_status::FAILURE;
+        }
+
+        double h_step = h;
+        double t_new = t + h_step;
+
+        if (t_new >= t_bound)
+        {
+            t_new = t_bound;
+            h_step = t_bound - t;
+        }
+
+        /* Stages 2 to 7, the seventh evaluated at the fifth order solution */
+        for (unsigned int s = 1; s < DORMAND_PRINCE_STAGES; s++)
+        {
+            tensor &stage_y = (s == DORMAND_PRINCE_STAGES - 1) ? y_new : y_temp;
+
+            for (unsigned int i = 0; i < n; i++)
+            {
+                double sum = 0.0;
+                for (unsigned int j = 0; j < s; j++)
+                {
+                    sum += A[s][j] * k[j](i, 0);
+                }
+                stage_y(i, 0) = y(i, 0) + h_step * sum;
+            }
+
+            const double t_stage = (s == DORMAND_PRINCE_STAGES - 1)
+                                       ? t_new
+                                       : t + C[s] * h_step;
+
+            if (evaluate(t_stage, stage_y, k[s]) != tensor_status::SUCCESS)
+            {
+                return tensor_status::FAILURE;
+            }
+        }
+
+        /* The local error estimate, fifth minus fourth order solution */
+        for (unsigned int i = 0; i < n; i++)
+        {
+            double sum = 0.0;
+            for (unsigned int j = 0; j < DORMAND_PRINCE_STAGES; j++)
+            {
+                sum += E[j] * k[j](i, 0);
+            }
+            y_temp(i, 0) = h_step * sum;
+        }
+
+        const double error = scaled_rms(y_temp, y, y_new);
+
+        if (error < 1.0)
+        {
+            double factor = (error == 0.0)
+                                ? INTEGRATOR_MAX_FACTOR
+                                : fmin(INTEGRATOR_MAX_FACTOR,
+                                       INTEGRATOR_SAFETY *
+                                           pow(error, ERROR_EXPONENT));
+
+            if (rejected)
+            { /* Do not grow straight after a rejection */
+                factor = fmin(1.0, factor);
+            }
+
+            h = h_step * factor;
+            h_last = h_step;
+            t_old = t;
+            t = t_new;
+            swap(y_old, y);
+            swap(y, y_new);
+            fsal_pending = true;
+            accepted_steps++;
+
+            return tensor_status::SUCCESS;
+        }
+
+        h = h_step * fmax(INTEGRATOR_MIN_FACTOR,
+                          INTEGRATOR_SAFETY * pow(error, ERROR_EXPONENT));
+        rejected = true;
+        rejected_steps++;
+    }
+}
+
+tensor_status dormand_prince::integrate(double t_final)
+{
+    while (t < t_final)
+    {
+        if (step(t_final) != tensor_status::SUCCESS)
+        {
+            return tensor_status::FAILURE;
+        }
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status dormand_prince::integrate(double t_final, double interval,
+                                        const output_function &output)
+{
+    if ((!initialized) || (interval <= 0.0) || (output == nullptr))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    const double t_start = t;
+    unsigned long sample = 0;
+    tensor y_sample(n);
+
+    output(t, y);
+    sample++;
+
+    while (t < t_final)
+    {
+        if (step(t_final) != tensor_status::SUCCESS)
+        {
+            return tensor_status::FAILURE;
+        }
+
+        /* Every output time the step went past, interpolated */
+        double t_sample = t_start + sample * interval;
+        while (t_sample <= t)
+        {
+            interpolate(t_sample, y_sample);
+            output(t_sample, y_sample);
+            sample++;
+            t_sample = t_start + sample * interval;
+        }
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status dormand_prince::interpolate(double t_eval, tensor &y_eval) const
+{
+    if ((!initialized) || (y_eval.m_height != n) || (y_eval.n_width != 1) ||
+        (t_eval < t_old) || (t_eval > t))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    if (h_last == 0.0)
+    { /* No step taken yet */
+        for (unsigned int i = 0; i < n; i++)
+        {
+            y_eval(i, 0) = y(i, 0);
+        }
+        return tensor_status::SUCCESS;
+    }
+
+    /* The weight of each stage at x = (t_eval - t_old) / h_last */
+    const double x = (t_eval - t_old) / h_last;
+    double weights[DORMAND_PRINCE_STAGES];
+
+    for (unsigned int s = 0; s < DORMAND_PRINCE_STAGES; s++)
+    {
+        double w = 0.0;
+        for (int j = DORMAND_PRINCE_DENSE_ORDER - 1; j >= 0; j--)
+        {
+            w = (w + P[s][j]) * x;
+        }
+        weights[s] = h_last * w;
+    }
+
+    /* k[0] is still this step's first stage until the next step begins */
+    for (unsigned int i = 0; i < n; i++)
+    {
+        double sum = 0.0;
+        for (unsigned int s = 0; s < DORMAND_PRINCE_STAGES; s++)
+        {
+            sum += weights[s] * k[s](i, 0);
+        }
+        y_eval(i, 0) = y_old(i, 0) + sum;
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+derivative_function particle_dynamics(const particle &p,
+                                      const force_function &force)
+{
+    const double mass = p.get_mass();
+    const double spin = p.get_radius() / p.get_moi();
+    tensor u(INPUT_SIZE);
+
+    return [=](double t, const tensor &state, tensor &dx) mutable
+    {
+        if (force(t, state, u) != tensor_status::SUCCESS)
+        {
+            return tensor_status::FAILURE;
+        }
+
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            dx(i, 0) = state(3 + i, 0);     /* x' = v */
+            dx(3 + i, 0) = u(i, 0) / mass;  /* v' = fn / m */
+            dx(6 + i, 0) = state(9 + i, 0); /* angle' = rate */
+            dx(9 + i, 0) = spin * u(3 + i, 0);
+        }
+
+        return tensor_status::SUCCESS;
+    };
+}
+
+tensor_status integrate(dormand_prince &solver, particle &p,
+                        const force_function &force, double t0,
+                        double t_final)
+{
+    if ((solver.initialize(particle_dynamics(p, force), t0, p.get_state()) !=
+         tensor_status::SUCCESS) ||
+        (solver.integrate(t_final) != tensor_status::SUCCESS))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    return p.set_state(solver.get_state());
+}
+
+/******************************************************************************
+ * Setters
+******************************************************************************/
+tensor_status dormand_prince::set_tolerances(double rtol_new, double atol_new)
+{
+    if ((rtol_new <= 0.0) || (atol_new < 0.0))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    rtol = rtol_new;
+    atol = atol_new;
+    return tensor_status::SUCCESS;
+}
+
+tensor_status dormand_prince::set_step_limits(double h_min_new,
+                                              double h_max_new)
+{
+    if ((h_min_new < 0.0) || (h_max_new < 0.0) ||
+        ((h_max_new > 0.0) && (h_max_new < h_min_new)))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    h_min = h_min_new;
+    h_max = h_max_new;
+    return tensor_status::SUCCESS;
+}
+
+tensor_status dormand_prince::set_initial_step(double h_new)
+{
+    if (h_new < 0.0)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    h_initial = h_new;
+    return tensor_status::SUCCESS;
+}
+
+/******************************************************************************
+ * UNIT TESTS
+ *****************************************************************************/
+#ifdef TESTING_INTEGRATOR
+
+#include "constants.h"
+
+/* y'' = -y as y = [position, velocity] */
+static tensor_status oscillator(double t, const tensor &y, tensor &dy)
+{
+    (void)t;
+    dy(0, 0) = y(1, 0);
+    dy(1, 0) = -y(0, 0);
+    return tensor_status::SUCCESS;
+}
+
+/* A projectile pushed along its velocity by a rail until t = 0, then
+ * coasting under point-mass gravity about the origin */
+static tensor_status launch_force(double t, const tensor &x, tensor &u,
+                                  double mass, double thrust)
+{
+    const double r = sqrt(x(0, 0) * x(0, 0) + x(1, 0) * x(1, 0) +
+                          x(2, 0) * x(2, 0));
+    const double g = -MU_EARTH * mass / (r * r * r);
+    const double v = sqrt(x(3, 0) * x(3, 0) + x(4, 0) * x(4, 0) +
+                          x(5, 0) * x(5, 0));
+    const double push = (t < 0.0) ? thrust / v : 0.0;
+
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        u(i, 0) = g * x(i, 0) + push * x(3 + i, 0);
+        u(3 + i, 0) = 0.0;
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+int main(void)
+{
+#ifdef TEST_INTEGRATOR_ACCURACY
+    {
+        cout << "TEST_INTEGRATOR_ACCURACY\r\n";
+        tensor y0(vector<vector<double>>{{1.0}, {0.0}});
+        const double t_final = 20.0 * M_PI;
+
+        for (double tol = 1e-4; tol >= 1e-12; tol *= 1e-4)
+        {
+            dormand_prince solver(2);
+            solver.set_tolerances(tol, tol);
+            solver.initialize(oscillator, 0.0, y0);
+            solver.integrate(t_final);
+            const tensor &y = solver.get_state();
+            cout << "tol = " << tol << ": steps = "
+                 << solver.get_accepted_steps() << " (+"
+                 << solver.get_rejected_steps() << " rejected), f calls = "
+                 << solver.get_evaluations() << ", |y - cos| = "
+                 << fabs(y(0, 0) - cos(t_final)) << "\r\n";
+        }
+    }
+#endif
+
+#ifdef TEST_INTEGRATOR_DENSE_OUTPUT
+    {
+        cout << "TEST_INTEGRATOR_DENSE_OUTPUT\r\n";
+        tensor y0(vector<vector<double>>{{1.0}, {0.0}});
+        dormand_prince solver(2);
+        solver.set_tolerances(1e-10, 1e-10);
+        solver.initialize(oscillator, 0.0, y0);
+
+        double max_error = 0.0;
+        unsigned int outputs = 0;
+        solver.integrate(10.0, 0.01, [&](double t, const tensor &y)
+                         {
+                             max_error = fmax(max_error,
+                                              fabs(y(0, 0) - cos(t)));
+                             outputs++;
+                         });
+        cout << outputs << " outputs from " << solver.get_accepted_steps()
+             << " steps, max |y - cos| = " << max_error << "\r\n";
+    }
+#endif
+
+#ifdef TEST_INTEGRATOR_PARTICLE
+    {
+        cout << "TEST_INTEGRATOR_PARTICLE\r\n";
+        /* 10 s on the rail from low orbital speed, then coast to 30000 s */
+        const double mass = MASS_PROJECTILE;
+        const double thrust = INIT_FORCE;
+        const double t0 = SIM_T0;
+        const double t_final = SIM_TF;
+        const double dt = SIM_DT;
+        force_function force = [=](double t, const tensor &x, tensor &u)
+        {
+            return launch_force(t, x, u, mass, thrust);
+        };
+
+        particle reference(RADIUS_EARTH, 0.0, 0.0);
+        reference.set_mass(mass);
+        tensor x0 = reference.get_state();
+        x0(4, 0) = 7800.0;
+        reference.set_state(x0);
+        particle adaptive = reference;
+        particle fixed = reference;
+
+        dormand_prince solver(STATE_SIZE);
+        solver.set_tolerances(1e-13, 1e-6);
+        integrate(solver, reference, force, t0, t_final);
+        tensor x_ref = reference.get_state();
+
+        solver.set_tolerances(1e-9, 1e-6);
+        integrate(solver, adaptive, force, t0, t_final);
+        tensor x_adaptive = adaptive.get_state();
+        cout << "adaptive: " << solver.get_accepted_steps() << " steps (+"
+             << solver.get_rejected_steps() << " rejected), "
+             << solver.get_evaluations() << " force evaluations\r\n";
+
+        /* The fixed-step zero-order hold of particle::update() */
+        fixed.set_sample_time(dt);
+        const unsigned long steps = (unsigned long)((t_final - t0) / dt);
+        tensor u(INPUT_SIZE);
+        for (unsigned long i = 0; i < steps; i++)
+        {
+            force(t0 + i * dt, fixed.get_state(), u);
+            fixed.set_u(u(0, 0), u(1, 0), u(2, 0), 0.0, 0.0, 0.0);
+            fixed.update();
+        }
+        tensor x_fixed = fixed.get_state();
+
+        double adaptive_error = 0.0;
+        double fixed_error = 0.0;
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            adaptive_error += pow(x_adaptive(i, 0) - x_ref(i, 0), 2.0);
+            fixed_error += pow(x_fixed(i, 0) - x_ref(i, 0), 2.0);
+        }
+        cout << "fixed dt = " << dt << ": " << steps << " steps\r\n";
+        cout << "position error after " << t_final << " s: adaptive = "
+             << sqrt(adaptive_error) << " m, fixed = " << sqrt(fixed_error)
+             << " m\r\n";
+    }
+#endif
+    return 0;
+}
+#endif
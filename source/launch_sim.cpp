@@ -0,0 +1,182 @@
+/**
+* @file launch_sim.cpp
+*
+* @brief A headless run of the rail-accelerator launch scenario of the Python
+* prototype (python_prototyping/launch_sim.py)
+*
+* @author Pavlo Vlastos
+*/
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "launch_sim.h"
+#include "fixed_tensor.h"
+#include <math.h>
+
+/******************************************************************************
+ * PUBLIC FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+tensor_status run_launch_scenario(const launch_scenario &scenario,
+                                  launch_result &result)
+{
+    if ((scenario.dt <= 0.0) || (scenario.mass <= 0.0) ||
+        (scenario.tl < scenario.t0) || (scenario.tf < scenario.tl))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    particle projectile(LAUNCH_X0, LAUNCH_Y0, LAUNCH_Z0);
+    if (projectile.set_mass(scenario.mass) != tensor_status::SUCCESS)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    /* The launch vector of the prototype, the position rotated by a yaw of
+     * -pi/2, i.e. along the local east */
+    const double r0[3] = {LAUNCH_X0, LAUNCH_Y0, LAUNCH_Z0};
+    fixed_tensor<3, 3> dcm;
+    double launch[3];
+    create_dcm(-M_PI / 2.0, 0.0, 0.0, dcm);
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        launch[i] = dcm(i, 0) * r0[0] + dcm(i, 1) * r0[1] + dcm(i, 2) * r0[2];
+    }
+    const double launch_norm = sqrt(launch[0] * launch[0] +
+                                    launch[1] * launch[1] +
+                                    launch[2] * launch[2]);
+
+    /* On the rail, the accelerator's push plus the rail's support against
+     * gravity, which the prototype leaves out */
+    const double mass = scenario.mass;
+    const double push = scenario.force / launch_norm;
+    const gravity_model gravity = scenario.gravity;
+    force_function accelerator = [=](double t, const tensor &x, tensor &u)
+    {
+        (void)t;
+        const double r[3] = {x(0, 0), x(1, 0), x(2, 0)};
+        double g[3];
+
+        gravity_acceleration(gravity, r, g);
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            u(i, 0) = push * launch[i] - mass * g[i];
+            u(3 + i, 0) = 0.0;
+        }
+
+        return tensor_status::SUCCESS;
+    };
+
+    orbit_propagator orbit(scenario.gravity, scenario.method, scenario.dt);
+    orbit.set_particle(projectile, scenario.t0);
+    orbit.set_force(accelerator);
+
+    result = launch_result();
+
+    /* On the rail, then released at tl. The force ends exactly at a step,
+     * so the rail imparts the full impulse force * (tl - t0). */
+    if (orbit.propagate(scenario.tl) != tensor_status::SUCCESS)
+    {
+        return tensor_status::FAILURE;
+    }
+    orbit.set_force(nullptr);
+
+    orbit.get_particle(projectile);
+    tensor x = projectile.get_state();
+    result.launch_speed = sqrt(x(3, 0) * x(3, 0) + x(4, 0) * x(4, 0) +
+                               x(5, 0) * x(5, 0));
+
+    /* Coasting */
+    const double e0 = orbit.get_specific_energy();
+    double altitude = orbit.get_radius() - RADIUS_EARTH;
+    result.max_altitude = altitude;
+    result.min_altitude = altitude;
+
+    while (orbit.get_time() < scenario.tf)
+    {
+        if (orbit.step() != tensor_status::SUCCESS)
+        {
+            return tensor_status::FAILURE;
+        }
+
+        altitude = orbit.get_radius() - RADIUS_EARTH;
+        result.max_altitude = fmax(result.max_altitude, altitude);
+        result.min_altitude = fmin(result.min_altitude, altitude);
+        result.energy_drift = fmax(result.energy_drift,
+                                   fabs(orbit.get_specific_energy() - e0) /
+                                       fabs(e0));
+
+        if (scenario.stop_at_impact && (altitude < 0.0))
+        {
+            result.impacted = true;
+            break;
+        }
+    }
+
+    result.t_end = orbit.get_time();
+    result.steps = orbit.get_steps();
+    orbit.get_particle(projectile);
+    result.final_state = projectile.get_state();
+
+    return tensor_status::SUCCESS;
+}
+
+/******************************************************************************
+ * UNIT TESTS
+ *****************************************************************************/
+#ifdef TESTING_LAUNCH_SIM
+
+#include <chrono>
+
+static void print_result(const launch_result &result, double seconds)
+{
+    cout << "launch speed = " << result.launch_speed << " m/s, "
+         << (result.impacted ? "impact" : "end") << " at t = "
+         << result.t_end << " s after " << result.steps << " steps\r\n";
+    cout << "altitude in [" << result.min_altitude << ", "
+         << result.max_altitude << "] m, max |dE / E| = "
+         << result.energy_drift << ", " << seconds << " s wall\r\n";
+}
+
+int main(void)
+{
+#ifdef TEST_LAUNCH_SIM_PROTOTYPE
+    {
+        cout << "TEST_LAUNCH_SIM_PROTOTYPE\r\n";
+        /* The prototype's defaults: 10 kN for 10 s is a short hop */
+        launch_scenario scenario;
+        launch_result result;
+        auto start = chrono::steady_clock::now();
+        run_launch_scenario(scenario, result);
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        print_result(result, elapsed.count());
+    }
+#endif
+
+#ifdef TEST_LAUNCH_SIM_ORBIT
+    {
+        cout << "TEST_LAUNCH_SIM_ORBIT\r\n";
+        /* Enough push for a low, eccentric orbit, coasting the full 30000 s
+         * (about six orbits) with each method */
+        const char *names[2] = {"velocity-Verlet", "Yoshida4"};
+        for (unsigned int m = 0; m < 2; m++)
+        {
+            launch_scenario scenario;
+            scenario.force = MASS_PROJECTILE * 8100.0 /
+                             (scenario.tl - scenario.t0);
+            scenario.method = m ? symplectic_method::YOSHIDA4
+                                : symplectic_method::VELOCITY_VERLET;
+            scenario.stop_at_impact = false;
+            launch_result result;
+            auto start = chrono::steady_clock::now();
+            run_launch_scenario(scenario, result);
+            chrono::duration<double> elapsed =
+                chrono::steady_clock::now() - start;
+            cout << names[m] << ":\r\n";
+            print_result(result, elapsed.count());
+        }
+    }
+#endif
+    return 0;
+}
+#endif
@@ -0,0 +1,399 @@
+/**
+* @file matrix_file.cpp
+*
+* @brief A versioned binary file format for a single matrix, saved and loaded
+* as raw elements, or mapped into memory as a tensor view
+*
+* @author Pavlo Vlastos
+*/
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "matrix_file.h"
+#include "file_io.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/******************************************************************************
+ * PRIVATE FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+/**
+ * @brief Read all of a buffer from an offset, however many calls pread()
+ * takes
+ */
+static tensor_status read_all(int fd, void *data, size_t size, off_t offset)
+{
+    uint8_t *bytes = static_cast<uint8_t *>(data);
+    while (size > 0)
+    {
+        ssize_t got = pread(fd, bytes, size, offset);
+        if (got <= 0)
+        {
+            return tensor_status::FAILURE;
+        }
+        bytes += got;
+        offset += got;
+        size -= (size_t)got;
+    }
+    return tensor_status::SUCCESS;
+}
+
+/**
+ * @brief Whether a header describes a matrix that fits in a file of
+ * file_size bytes
+ */
+static bool check_header(const matrix_file_header &header, size_t file_size)
+{
+    const uint32_t alignment = header.alignment;
+
+    if ((memcmp(header.magic, MATRIX_FILE_MAGIC, sizeof(header.magic)) !=
+         0) ||
+        (header.version != MATRIX_FILE_VERSION) ||
+        (header.byte_order != MATRIX_FILE_BYTE_ORDER) ||
+        (header.dtype != (uint32_t)matrix_dtype::FLOAT64) ||
+        (header.rows == 0) || (header.cols == 0) ||
+        (header.row_stride < header.cols) ||
+        (alignment < sizeof(double)) ||
+        ((alignment & (alignment - 1)) != 0) ||
+        (header.data_offset < sizeof(matrix_file_header)) ||
+        (header.data_offset % alignment != 0) ||
+        (header.data_offset > file_size))
+    {
+        return false;
+    }
+
+    /* The elements the file holds after the offset must reach the last
+     * row's columns, (rows - 1) * row_stride + cols, bounded by division
+     * so a crafted header cannot wrap the product around */
+    const uint64_t elements =
+        (file_size - header.data_offset) / sizeof(double);
+
+    if (header.cols > elements)
+    {
+        return false;
+    }
+
+    return (header.rows == 1) ||
+           ((uint64_t)(header.rows - 1) <=
+            (elements - header.cols) / header.row_stride);
+}
+
+/******************************************************************************
+ * PUBLIC FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+tensor_status save_tensor(const tensor &a, const char *path)
+{
+    if (path == nullptr)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    /* Rows are written back to back, whatever the stride of the tensor */
+    matrix_file_header header = {};
+    memcpy(header.magic, MATRIX_FILE_MAGIC, sizeof(header.magic));
+    header.version = MATRIX_FILE_VERSION;
+    header.byte_order = MATRIX_FILE_BYTE_ORDER;
+    header.dtype = (uint32_t)matrix_dtype::FLOAT64;
+    header.rows = a.m_height;
+    header.cols = a.n_width;
+    header.row_stride = a.n_width;
+    header.alignment = TENSOR_ALIGNMENT;
+    header.data_offset = sizeof(matrix_file_header);
+
+    tensor_status status = write_all(fd, &header, sizeof(header));
+
+    if (a.stride() == a.n_width)
+    { /* Contiguous: one write of every element */
+        if (status == tensor_status::SUCCESS)
+        {
+            status = write_all(fd, a.data(),
+                               (size_t)a.m_height * a.n_width *
+                                   sizeof(double));
+        }
+    }
+    else
+    {
+        for (unsigned int row = 0;
+             (status == tensor_status::SUCCESS) && (row < a.m_height); row++)
+        {
+            status = write_all(fd, &a(row, 0), a.n_width * sizeof(double));
+        }
+    }
+
+    if (::close(fd) != 0)
+    {
+        status = tensor_status::FAILURE;
+    }
+
+    return status;
+}
+
+tensor_status load_tensor(const char *path, tensor &a)
+{
+    int fd = (path != nullptr) ? ::open(path, O_RDONLY) : -1;
+    if (fd < 0)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    struct stat info;
+    matrix_file_header header;
+    if ((fstat(fd, &info) != 0) ||
+        ((size_t)info.st_size < sizeof(matrix_file_header)) ||
+        (read_all(fd, &header, sizeof(header), 0) !=
+         tensor_status::SUCCESS) ||
+        !check_header(header, (size_t)info.st_size))
+    {
+        ::close(fd);
+        return tensor_status::FAILURE;
+    }
+
+    tensor loaded(header.rows, header.cols);
+    tensor_status status = tensor_status::SUCCESS;
+
+    if (header.row_stride == header.cols)
+    { /* Contiguous: one read of every element */
+        status = read_all(fd, loaded.data(),
+                          (size_t)header.rows * header.cols * sizeof(double),
+                          header.data_offset);
+    }
+    else
+    {
+        for (unsigned int row = 0;
+             (status == tensor_status::SUCCESS) && (row < header.rows); row++)
+        {
+            status = read_all(fd, &loaded(row, 0),
+                              header.cols * sizeof(double),
+                              header.data_offset + (off_t)row *
+                                                       header.row_stride *
+                                                       sizeof(double));
+        }
+    }
+    ::close(fd);
+
+    if (status == tensor_status::SUCCESS)
+    {
+        a = move(loaded);
+    }
+
+    return status;
+}
+
+tensor_status map_tensor(const char *path, tensor &a)
+{
+    shared_ptr<void> mapping;
+    size_t size = 0;
+    if (map_file(path, sizeof(matrix_file_header), mapping, size) !=
+        tensor_status::SUCCESS)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    matrix_file_header header;
+    memcpy(&header, mapping.get(), sizeof(header));
+    if (!check_header(header, size))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    double *elements = reinterpret_cast<double *>(
+        static_cast<uint8_t *>(mapping.get()) + header.data_offset);
+    a = tensor::view(elements, header.rows, header.cols, header.row_stride,
+                     mapping);
+
+    return tensor_status::SUCCESS;
+}
+
+/******************************************************************************
+ * UNIT TESTS
+ *****************************************************************************/
+#ifdef TESTING_MATRIX_FILE
+
+#include <fstream>
+#include <time.h>
+
+int main(void)
+{
+#ifdef TEST_MATRIX_FILE_ROUNDTRIP
+    {
+        cout << "TEST_MATRIX_FILE_ROUNDTRIP\r\n";
+        const char *path = "../../simulation/matrix.bin";
+        tensor a(vector<vector<double>>{{1.0, 2.0, 3.0},
+                                        {4.0, 5.0, 6.0}});
+        if (save_tensor(a, path) != tensor_status::SUCCESS)
+        {
+            cout << "Unable to open file\r\n";
+            return 1;
+        }
+
+        tensor loaded(1);
+        tensor mapped(1);
+        tensor_status load_status = load_tensor(path, loaded);
+        tensor_status map_status = map_tensor(path, mapped);
+        cout << "load: status = " << (int)load_status << ", map: status = "
+             << (int)map_status << ", view = " << mapped.is_view()
+             << ", aligned = "
+             << ((uintptr_t)mapped.data() % TENSOR_ALIGNMENT == 0) << "\r\n";
+        loaded.print();
+        mapped.print();
+
+        /* Writing to the view leaves the file as it was */
+        mapped(0, 0) = -1.0;
+        tensor again(1);
+        load_tensor(path, again);
+        cout << "after writing the view: mapped(0, 0) = " << mapped(0, 0)
+             << ", file (0, 0) = " << again(0, 0) << "\r\n";
+
+        /* A view with a stride of its own saves as the rows it shows */
+        tensor wide(vector<vector<double>>{{1.0, 2.0, 3.0, 4.0},
+                                           {5.0, 6.0, 7.0, 8.0}});
+        tensor part = tensor::view(&wide(0, 1), 2, 2, wide.stride(), nullptr);
+        save_tensor(part, path);
+        load_tensor(path, loaded);
+        loaded.print();
+
+        /* Files that are not matrices, or cut short, fail to load */
+        {
+            ofstream bad(path, ios::binary);
+            bad << "not a matrix file, but long enough to hold a header ....";
+        }
+        cout << "bad magic fails = "
+             << (load_tensor(path, loaded) == tensor_status::FAILURE)
+             << "\r\n";
+
+        save_tensor(a, path);
+        if (truncate(path, sizeof(matrix_file_header) + 5 * sizeof(double)) ==
+            0)
+        {
+            cout << "short file fails = "
+                 << (map_tensor(path, mapped) == tensor_status::FAILURE)
+                 << "\r\n";
+        }
+
+        /* Shapes whose byte count wraps around 2^64, and offsets off the
+         * alignment, fail however long the file */
+        save_tensor(a, path);
+        matrix_file_header header;
+        {
+            ifstream in(path, ios::binary);
+            in.read(reinterpret_cast<char *>(&header), sizeof(header));
+        }
+        matrix_file_header crafted = header;
+        crafted.rows = (1u << 31) + 1;
+        crafted.cols = 1;
+        crafted.row_stride = 1u << 31;
+        {
+            fstream out(path, ios::binary | ios::in | ios::out);
+            out.write(reinterpret_cast<const char *>(&crafted),
+                      sizeof(crafted));
+        }
+        cout << "wrapping shape fails = "
+             << (map_tensor(path, mapped) == tensor_status::FAILURE)
+             << "\r\n";
+
+        crafted = header;
+        crafted.alignment = 24;
+        {
+            fstream out(path, ios::binary | ios::in | ios::out);
+            out.write(reinterpret_cast<const char *>(&crafted),
+                      sizeof(crafted));
+        }
+        cout << "alignment not a power of two fails = "
+             << (load_tensor(path, loaded) == tensor_status::FAILURE)
+             << "\r\n";
+        remove(path);
+    }
+#endif
+
+#ifdef TEST_MATRIX_FILE_STARTUP
+    {
+        cout << "TEST_MATRIX_FILE_STARTUP\r\n";
+        /* A large coefficient matrix, as text and as a matrix file */
+        const unsigned int m = 1000;
+        const unsigned int n = 1000;
+        const char *text_path = "../../simulation/matrix.txt";
+        const char *path = "../../simulation/matrix.bin";
+
+        tensor a(m, n);
+        for (unsigned int i = 0; i < m; i++)
+        {
+            for (unsigned int j = 0; j < n; j++)
+            {
+                a(i, j) = 1.0 / (1.0 + i + j);
+            }
+        }
+        {
+            ofstream text(text_path);
+            if (!text)
+            {
+                cout << "Unable to open file\r\n";
+                return 1;
+            }
+            text.precision(17);
+            for (unsigned int i = 0; i < m; i++)
+            {
+                for (unsigned int j = 0; j < n; j++)
+                {
+                    text << a(i, j) << " ";
+                }
+                text << "\n";
+            }
+        }
+        save_tensor(a, path);
+
+        /* Parsed, into a vector<vector<double>>, then copied in */
+        clock_t start = clock();
+        ifstream text(text_path);
+        vector<vector<double>> rows(m, vector<double>(n));
+        for (unsigned int i = 0; i < m; i++)
+        {
+            for (unsigned int j = 0; j < n; j++)
+            {
+                text >> rows[i][j];
+            }
+        }
+        tensor parsed(rows);
+        double parse_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        start = clock();
+        tensor loaded(1);
+        load_tensor(path, loaded);
+        double load_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        /* Mapped, then one element touched: a single page read */
+        start = clock();
+        tensor mapped(1);
+        map_tensor(path, mapped);
+        double touched = mapped(m / 2, n / 2);
+        double map_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        unsigned long mismatches = 0;
+        for (unsigned int i = 0; i < m; i++)
+        {
+            for (unsigned int j = 0; j < n; j++)
+            {
+                mismatches += (parsed(i, j) != a(i, j)) +
+                              (loaded(i, j) != a(i, j)) +
+                              (mapped(i, j) != a(i, j));
+            }
+        }
+
+        cout << m << " x " << n << ": text parse " << parse_seconds
+             << " s, load " << load_seconds << " s, map and touch one "
+             << "element " << map_seconds << " s (" << touched
+             << "), mismatches = " << mismatches << "\r\n";
+        remove(text_path);
+        remove(path);
+    }
+#endif
+    return 0;
+}
+#endif
@@ -0,0 +1,395 @@
+/**
+* @file orbit.cpp
+*
+* @brief Symplectic (velocity-Verlet and Yoshida) propagation of particles in
+* Earth's gravity field, point-mass or with the J2 oblateness term
+*
+* @author Pavlo Vlastos
+*/
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "orbit.h"
+#include <math.h>
+
+/******************************************************************************
+ * DEFINES
+ *****************************************************************************/
+/* Yoshida's fourth order composition of three velocity-Verlet steps of
+ * YOSHIDA_W1, YOSHIDA_W0 and YOSHIDA_W1 times the step size */
+#define CBRT_2 1.2599210498948731648
+#define YOSHIDA_W1 (1.0 / (2.0 - CBRT_2))
+#define YOSHIDA_W0 (-CBRT_2 / (2.0 - CBRT_2))
+
+/******************************************************************************
+ * PRIVATE FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+tensor_status orbit_propagator::accelerate(double t_eval)
+{
+    gravity_acceleration(gravity, q, a);
+    a[3] = 0.0;
+    a[4] = 0.0;
+    a[5] = 0.0;
+
+    if (force != nullptr)
+    {
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            state(i, 0) = q[i];
+            state(3 + i, 0) = v[i];
+            state(6 + i, 0) = q[3 + i];
+            state(9 + i, 0) = v[3 + i];
+        }
+
+        if (force(t_eval, state, u) != tensor_status::SUCCESS)
+        {
+            return tensor_status::FAILURE;
+        }
+
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            a[i] += u(i, 0) / mass;
+            a[3 + i] = spin * u(3 + i, 0);
+        }
+    }
+
+    a_current = true;
+    return tensor_status::SUCCESS;
+}
+
+tensor_status orbit_propagator::verlet(double t_step, double h)
+{
+    if ((!a_current) && (accelerate(t_step) != tensor_status::SUCCESS))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    const double half_h = 0.5 * h;
+
+    for (unsigned int i = 0; i < ORBIT_DOF; i++)
+    {
+        v[i] += half_h * a[i]; /* Kick */
+        q[i] += h * v[i];      /* Drift */
+    }
+
+    /* The acceleration at the end is also the next step's first */
+    if (accelerate(t_step + h) != tensor_status::SUCCESS)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    for (unsigned int i = 0; i < ORBIT_DOF; i++)
+    {
+        v[i] += half_h * a[i]; /* Kick */
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+/******************************************************************************
+ * PUBLIC FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+void gravity_acceleration(gravity_model model, const double r[3],
+                          double a[3])
+{
+    const double r_sq = r[0] * r[0] + r[1] * r[1] + r[2] * r[2];
+    const double r_norm = sqrt(r_sq);
+    const double mu_r3 = MU_EARTH / (r_sq * r_norm);
+
+    if (model == gravity_model::POINT_MASS)
+    {
+        a[0] = -mu_r3 * r[0];
+        a[1] = -mu_r3 * r[1];
+        a[2] = -mu_r3 * r[2];
+        return;
+    }
+
+    /* The gradient of -mu / r * (1 - J2 / 2 * (R / r)^2 * (3 z^2 / r^2 - 1)) */
+    const double k = 1.5 * J2_EARTH * RADIUS_EARTH * RADIUS_EARTH / r_sq;
+    const double z_sq = r[2] * r[2] / r_sq;
+    const double xy_scale = 1.0 + k * (1.0 - 5.0 * z_sq);
+    const double z_scale = 1.0 + k * (3.0 - 5.0 * z_sq);
+
+    a[0] = -mu_r3 * xy_scale * r[0];
+    a[1] = -mu_r3 * xy_scale * r[1];
+    a[2] = -mu_r3 * z_scale * r[2];
+}
+
+double gravity_potential(gravity_model model, const double r[3])
+{
+    const double r_sq = r[0] * r[0] + r[1] * r[1] + r[2] * r[2];
+    const double potential = -MU_EARTH / sqrt(r_sq);
+
+    if (model == gravity_model::POINT_MASS)
+    {
+        return potential;
+    }
+
+    const double k = 0.5 * J2_EARTH * RADIUS_EARTH * RADIUS_EARTH / r_sq;
+    return potential * (1.0 - k * (3.0 * r[2] * r[2] / r_sq - 1.0));
+}
+
+orbit_propagator::orbit_propagator(gravity_model gravity_in,
+                                   symplectic_method method_in,
+                                   double dt_in)
+    : gravity(gravity_in), method(method_in), dt(dt_in), state(STATE_SIZE),
+      u(INPUT_SIZE)
+{
+    for (unsigned int i = 0; i < ORBIT_DOF; i++)
+    {
+        q[i] = 0.0;
+        v[i] = 0.0;
+        a[i] = 0.0;
+    }
+}
+
+tensor_status orbit_propagator::set_particle(const particle &p,
+                                             double t_start)
+{
+    tensor x = p.get_state();
+
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        q[i] = x(i, 0);
+        v[i] = x(3 + i, 0);
+        q[3 + i] = x(6 + i, 0);
+        v[3 + i] = x(9 + i, 0);
+    }
+
+    mass = p.get_mass();
+    spin = p.get_radius() / p.get_moi();
+    t0 = t_start;
+    t = t_start;
+    steps = 0;
+    t0_step = 0;
+    a_current = false;
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status orbit_propagator::get_particle(particle &p) const
+{
+    tensor x(STATE_SIZE);
+
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        x(i, 0) = q[i];
+        x(3 + i, 0) = v[i];
+        x(6 + i, 0) = q[3 + i];
+        x(9 + i, 0) = v[3 + i];
+    }
+
+    return p.set_state(x);
+}
+
+tensor_status orbit_propagator::step(void)
+{
+    tensor_status status;
+
+    if (method == symplectic_method::VELOCITY_VERLET)
+    {
+        status = verlet(t, dt);
+    }
+    else
+    {
+        const double h1 = YOSHIDA_W1 * dt;
+        const double h0 = YOSHIDA_W0 * dt;
+
+        status = verlet(t, h1);
+        if (status == tensor_status::SUCCESS)
+        {
+            status = verlet(t + h1, h0);
+        }
+        if (status == tensor_status::SUCCESS)
+        {
+            status = verlet(t + h1 + h0, h1);
+        }
+    }
+
+    if (status != tensor_status::SUCCESS)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    steps++;
+    t = t0 + (steps - t0_step) * dt;
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status orbit_propagator::propagate(double t_final)
+{
+    while (t < t_final)
+    {
+        if (step() != tensor_status::SUCCESS)
+        {
+            return tensor_status::FAILURE;
+        }
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+/******************************************************************************
+ * Setters
+******************************************************************************/
+tensor_status orbit_propagator::set_force(const force_function &force_new)
+{
+    force = force_new;
+    a_current = false;
+    return tensor_status::SUCCESS;
+}
+
+tensor_status orbit_propagator::set_sample_time(double dt_new)
+{
+    if (dt_new <= 0.0)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    /* Count steps of the new size from here on */
+    t0 = t;
+    t0_step = steps;
+    dt = dt_new;
+
+    return tensor_status::SUCCESS;
+}
+
+/******************************************************************************
+ * Getters
+******************************************************************************/
+double orbit_propagator::get_radius(void) const
+{
+    return sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2]);
+}
+
+double orbit_propagator::get_specific_energy(void) const
+{
+    return 0.5 * (v[0] * v[0] + v[1] * v[1] + v[2] * v[2]) +
+           gravity_potential(gravity, q);
+}
+
+/******************************************************************************
+ * UNIT TESTS
+ *****************************************************************************/
+#ifdef TESTING_ORBIT
+
+static tensor_status j2_gravity(double t, const tensor &x, tensor &u,
+                                double mass)
+{
+    (void)t;
+    const double r[3] = {x(0, 0), x(1, 0), x(2, 0)};
+    double g[3];
+
+    gravity_acceleration(gravity_model::J2, r, g);
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        u(i, 0) = mass * g[i];
+        u(3 + i, 0) = 0.0;
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+int main(void)
+{
+#ifdef TEST_ORBIT_GRAVITY
+    {
+        cout << "TEST_ORBIT_GRAVITY\r\n";
+        /* The acceleration is minus the gradient of the potential */
+        const double r[3] = {4.0e6, -3.0e6, 5.0e6};
+        const double step = 1.0;
+        double max_error = 0.0;
+
+        for (unsigned int m = 0; m < 2; m++)
+        {
+            gravity_model model = m ? gravity_model::J2
+                                    : gravity_model::POINT_MASS;
+            double a[3];
+            gravity_acceleration(model, r, a);
+
+            for (unsigned int i = 0; i < 3; i++)
+            {
+                double r_plus[3] = {r[0], r[1], r[2]};
+                double r_minus[3] = {r[0], r[1], r[2]};
+                r_plus[i] += step;
+                r_minus[i] -= step;
+                const double gradient = (gravity_potential(model, r_plus) -
+                                         gravity_potential(model, r_minus)) /
+                                        (2.0 * step);
+                max_error = fmax(max_error, fabs(a[i] + gradient));
+            }
+        }
+        cout << "max |a + grad(potential)| = " << max_error << " m/s^2\r\n";
+    }
+#endif
+
+#ifdef TEST_ORBIT_ENERGY
+    {
+        cout << "TEST_ORBIT_ENERGY\r\n";
+        /* An inclined, eccentric orbit (7000 km perigee, e ~ 0.1) under J2,
+         * 100 orbits with a 10 s step */
+        const double r0 = 7.0e6;
+        const double v0 = 1.05 * sqrt(MU_EARTH / r0);
+        const double inclination = 0.9;
+        const double t_final = 100.0 * 2.0 * M_PI *
+                               sqrt(pow(r0 / (2.0 - 1.05 * 1.05), 3.0) /
+                                    MU_EARTH);
+
+        particle start(r0, 0.0, 0.0);
+        tensor x0 = start.get_state();
+        x0(4, 0) = v0 * cos(inclination);
+        x0(5, 0) = v0 * sin(inclination);
+        start.set_state(x0);
+
+        const char *names[2] = {"velocity-Verlet", "Yoshida4"};
+        for (unsigned int m = 0; m < 2; m++)
+        {
+            orbit_propagator orbit(gravity_model::J2,
+                                   m ? symplectic_method::YOSHIDA4
+                                     : symplectic_method::VELOCITY_VERLET,
+                                   10.0);
+            orbit.set_particle(start, 0.0);
+            const double e0 = orbit.get_specific_energy();
+            double max_drift = 0.0;
+            while (orbit.get_time() < t_final)
+            {
+                orbit.step();
+                max_drift = fmax(max_drift,
+                                 fabs(orbit.get_specific_energy() - e0));
+            }
+            cout << names[m] << ": " << orbit.get_steps()
+                 << " steps, max |dE / E| = " << max_drift / fabs(e0)
+                 << ", final |dE / E| = "
+                 << fabs(orbit.get_specific_energy() - e0) / fabs(e0)
+                 << "\r\n";
+        }
+
+        /* The adaptive, non-symplectic integrator drifts instead */
+        particle rk(r0, 0.0, 0.0);
+        rk.set_state(x0);
+        dormand_prince solver(STATE_SIZE);
+        solver.set_tolerances(1e-9, 1e-3);
+        const double mass = rk.get_mass();
+        integrate(solver, rk,
+                  [=](double t, const tensor &x, tensor &u)
+                  { return j2_gravity(t, x, u, mass); },
+                  0.0, t_final);
+        orbit_propagator check(gravity_model::J2,
+                               symplectic_method::VELOCITY_VERLET, 10.0);
+        orbit_propagator initial(gravity_model::J2,
+                                 symplectic_method::VELOCITY_VERLET, 10.0);
+        check.set_particle(rk, 0.0);
+        initial.set_particle(start, 0.0);
+        cout << "RK45 (rtol 1e-9): " << solver.get_accepted_steps()
+             << " steps, final |dE / E| = "
+             << fabs(check.get_specific_energy() -
+                     initial.get_specific_energy()) /
+                    fabs(initial.get_specific_energy())
+             << "\r\n";
+    }
+#endif
+    return 0;
+}
+#endif
@@ -0,0 +1,184 @@
+/**
+* @file parallel_stepper.cpp
+*
+* @brief Steps large particle populations across the threads of a pool
+*
+* @author Pavlo Vlastos
+*/
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "parallel_stepper.h"
+
+/******************************************************************************
+ * PUBLIC FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+tensor_status parallel_update(vector<particle> &particles, thread_pool &pool)
+{
+    atomic<bool> failed(false);
+
+    tensor_status status = pool.parallel_for(
+        0, particles.size(), PARTICLE_GRAIN,
+        [&](unsigned int begin, unsigned int end, unsigned int)
+        {
+            for (unsigned int i = begin; i < end; i++)
+            {
+                if (particles[i].update() != tensor_status::SUCCESS)
+                {
+                    failed = true;
+                }
+            }
+        });
+
+    return failed ? tensor_status::FAILURE : status;
+}
+
+tensor_status parallel_update(particle_system &system, thread_pool &pool)
+{
+    atomic<bool> failed(false);
+
+    tensor_status status = pool.parallel_for(
+        0, system.size(), PARTICLE_SYSTEM_GRAIN,
+        [&](unsigned int begin, unsigned int end, unsigned int)
+        {
+            if (system.update(begin, end) != tensor_status::SUCCESS)
+            {
+                failed = true;
+            }
+        });
+
+    return failed ? tensor_status::FAILURE : status;
+}
+
+/******************************************************************************
+ * UNIT TESTS
+ *****************************************************************************/
+#ifdef TESTING_PARALLEL_STEPPER
+
+#include <chrono>
+
+/* Fill a population with varied masses, sizes and forces */
+static void build_population(vector<particle> &particles,
+                             particle_system &system, unsigned int n)
+{
+    particles.clear();
+    particles.reserve(n);
+    system = particle_system(n);
+
+    for (unsigned int i = 0; i < n; i++)
+    {
+        particles.push_back(particle(i, 0.5 * i, -0.25 * i));
+        particles[i].set_u(1.0 + (i % 5), -2.0, 0.5, 0.1, 0.0, -0.1);
+
+        system.add_particle(i, 0.5 * i, -0.25 * i);
+        system.set_moi(i, 1.0 + (i % 7), 0.5 + (i % 3));
+        system.set_u(i, 1.0 + (i % 5), -2.0, 0.5, 0.1, 0.0, -0.1);
+    }
+}
+
+int main(void)
+{
+#ifdef TEST_PARALLEL_STEPPER_DETERMINISM
+    {
+        cout << "TEST_PARALLEL_STEPPER_DETERMINISM\r\n";
+        const unsigned int n = 5000;
+        const unsigned int steps = 20;
+
+        vector<particle> serial;
+        particle_system serial_system;
+        build_population(serial, serial_system, n);
+        for (unsigned int k = 0; k < steps; k++)
+        {
+            for (unsigned int i = 0; i < n; i++)
+            {
+                serial[i].update();
+            }
+            serial_system.update();
+        }
+
+        for (unsigned int threads = 1; threads <= 4; threads++)
+        {
+            thread_pool pool(threads);
+            vector<particle> particles;
+            particle_system system;
+            build_population(particles, system, n);
+
+            for (unsigned int k = 0; k < steps; k++)
+            {
+                parallel_update(particles, pool);
+                parallel_update(system, pool);
+            }
+
+            unsigned int mismatches = 0;
+            tensor a(STATE_SIZE);
+            tensor b(STATE_SIZE);
+            for (unsigned int i = 0; i < n; i++)
+            {
+                tensor x = particles[i].get_state();
+                tensor y = serial[i].get_state();
+                mismatches += (memcmp(x.data(), y.data(),
+                                      STATE_SIZE * sizeof(double)) != 0);
+
+                system.get_state(i, a);
+                serial_system.get_state(i, b);
+                mismatches += (memcmp(a.data(), b.data(),
+                                      STATE_SIZE * sizeof(double)) != 0);
+            }
+            cout << "threads = " << threads
+                 << ", states differing from serial = " << mismatches
+                 << "\r\n";
+        }
+    }
+#endif
+
+#ifdef TEST_PARALLEL_STEPPER_SCALING
+    {
+        cout << "TEST_PARALLEL_STEPPER_SCALING\r\n";
+        const unsigned int n = 100000;
+        const unsigned int steps = 20;
+        unsigned int max_threads = thread::hardware_concurrency();
+        max_threads = (max_threads == 0) ? 1 : max_threads;
+
+        vector<particle> particles;
+        particle_system system;
+        build_population(particles, system, n);
+
+        double base_objects = 0.0;
+        double base_system = 0.0;
+        for (unsigned int threads = 1; threads <= max_threads; threads++)
+        {
+            thread_pool pool(threads);
+
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            for (unsigned int k = 0; k < steps; k++)
+            {
+                parallel_update(particles, pool);
+            }
+            chrono::duration<double> objects =
+                chrono::steady_clock::now() - start;
+
+            start = chrono::steady_clock::now();
+            for (unsigned int k = 0; k < steps; k++)
+            {
+                parallel_update(system, pool);
+            }
+            chrono::duration<double> soa = chrono::steady_clock::now() - start;
+
+            if (threads == 1)
+            {
+                base_objects = objects.count();
+                base_system = soa.count();
+            }
+
+            cout << "threads = " << threads << ": particle objects "
+                 << objects.count() << " s (x"
+                 << base_objects / objects.count() << "), particle_system "
+                 << soa.count() << " s (x" << base_system / soa.count()
+                 << ")\r\n";
+        }
+    }
+#endif
+    return 0;
+}
+#endif
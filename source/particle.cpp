@@ -15,20 +15,120 @@
  * DEFINES
  *****************************************************************************/
 
+/******************************************************************************
+ * GLOBAL VARIABLES AND DATATYPES
+ *****************************************************************************/
+
+/******************************************************************************
+ * PRIVATE FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+void particle::propagate_attitude(const tensor &before, const tensor &after)
+{
+    /* Half the rotation vector of the step, from the mean body rates about
+     * the body x (roll), y (pitch) and z (yaw) axes */
+    const double k = 0.25 * dt;
+    const double hx = k * (before(11, 0) + after(11, 0));
+    const double hy = k * (before(10, 0) + after(10, 0));
+    const double hz = k * (before(9, 0) + after(9, 0));
+
+    rotate_attitude(hx, hy, hz);
+}
+
+void particle::rotate_attitude(double hx, double hy, double hz)
+{
+    const double h_sq = hx * hx + hy * hy + hz * hz;
+
+    /* exp(h) = (cos|h|, sin|h| / |h| * h) */
+    double c;
+    double s_over_h;
+
+    if (h_sq < ATTITUDE_SERIES_LIMIT)
+    {
+        c = 1.0 - h_sq / 2.0 * (1.0 - h_sq / 12.0 * (1.0 - h_sq / 30.0));
+        s_over_h = 1.0 - h_sq / 6.0 * (1.0 - h_sq / 20.0 * (1.0 - h_sq / 42.0));
+    }
+    else
+    {
+        const double h = sqrt(h_sq);
+        c = cos(h);
+        s_over_h = sin(h) / h;
+    }
+
+    attitude = normalize(multiply(attitude,
+                                  quaternion(c, s_over_h * hx, s_over_h * hy,
+                                             s_over_h * hz)));
+}
+
 /******************************************************************************
  * PUBLIC FUNCTION IMPLEMENTATIONS
  *****************************************************************************/
 tensor_status particle::update(void)
 {
-    tensor_status status = tensor_status::FAILURE;
+    tensor_status status = multiply_add(model->sparse_phi, state,
+                                        model->sparse_gamma, u, next_state);
 
-    state = add(multiply(phi, state), multiply(gamma, u));
+    if (status == tensor_status::SUCCESS)
+    {
+        if (mode == attitude_mode::QUATERNION)
+        {
+            propagate_attitude(state, next_state);
+        }
 
-    status = tensor_status::SUCCESS;
+        swap(state, next_state);
+        body_frame_current = false;
+    }
 
     return status;
 }
 
+tensor_status particle::advance(unsigned long k)
+{
+    if ((mode == attitude_mode::QUATERNION) &&
+        ((u(3, 0) != 0.0) || (u(4, 0) != 0.0) || (u(5, 0) != 0.0)))
+    {
+        for (unsigned long i = 0; i < k; i++)
+        {
+            if (update() != tensor_status::SUCCESS)
+            {
+                return tensor_status::FAILURE;
+            }
+        }
+        return tensor_status::SUCCESS;
+    }
+
+    /* Constant body rates, read before the jump */
+    const double rate_x = state(11, 0);
+    const double rate_y = state(10, 0);
+    const double rate_z = state(9, 0);
+
+    for (unsigned int level = 0; (k >> level) != 0; level++)
+    {
+        if (((k >> level) & 1) == 0)
+        {
+            continue;
+        }
+
+        const dynamics_jump *j = model->jump(level);
+        if ((j == nullptr) ||
+            (multiply_add(j->sparse_phi, state, j->sparse_gamma, u,
+                          next_state) != tensor_status::SUCCESS))
+        {
+            return tensor_status::FAILURE;
+        }
+
+        swap(state, next_state);
+    }
+
+    if ((mode == attitude_mode::QUATERNION) && (k > 0))
+    {
+        const double h = 0.5 * (double)k * dt;
+        rotate_attitude(h * rate_x, h * rate_y, h * rate_z);
+    }
+    body_frame_current = (body_frame_current && (k == 0));
+
+    return tensor_status::SUCCESS;
+}
+
 /******************************************************************************
  * Setters
 ******************************************************************************/
@@ -38,60 +138,193 @@ tensor_status particle::set_u(const double fnx, const double fny,
 {
     /* The components of the force normal to the surface of the sphere. These
      * components can impart linear momentum only. */
-    u.content[0][0] = fnx;
-    u.content[1][0] = fny;
-    u.content[2][0] = fnz;
+    u(0, 0) = fnx;
+    u(1, 0) = fny;
+    u(2, 0) = fnz;
 
     /* The components of the force tangent to the particle's sphere. These
      * components only create moments that can rotate the particle. */
-    u.content[3][0] = ftx;
-    u.content[4][0] = fty;
-    u.content[5][0] = ftz;
+    u(3, 0) = ftx;
+    u(4, 0) = fty;
+    u(5, 0) = ftz;
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status particle::set_model(const double dt_new)
+{
+    shared_ptr<const dynamics_model> model_new =
+        dynamics_model::intern(dt_new, mass, radius, moi);
 
+    if (model_new == nullptr)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    model = model_new;
+    dt = dt_new;
     return tensor_status::SUCCESS;
 }
 
 tensor_status particle::set_mass(const double mass)
 {
+    if (mass <= 0.0)
+    {
+        return tensor_status::FAILURE;
+    }
+
     this->mass = mass;
     moi = 2.0 * (mass * radius * radius) / 5.0; /* Moment of inertia */
-    return tensor_status::SUCCESS;
+    return set_model(dt); /* Consequently update phi and gamma */
 }
 
 tensor_status particle::set_radius(const double radius)
 {
+    if (radius <= 0.0)
+    {
+        return tensor_status::FAILURE;
+    }
+
     this->radius = radius;
     moi = 2.0 * (mass * radius * radius) / 5.0; /* Moment of inertia */
-    return tensor_status::SUCCESS;
+    return set_model(dt); /* Consequently update phi and gamma */
 }
 
 tensor_status particle::set_moi(const double mass, const double radius)
 {
-    set_mass(mass);
-    set_radius(radius);
+    if ((set_mass(mass) != tensor_status::SUCCESS) ||
+        (set_radius(radius) != tensor_status::SUCCESS))
+    {
+        return tensor_status::FAILURE;
+    }
+
     this->moi = 2.0 * (mass * radius * radius) / 5.0; /* Moment of inertia */
     return tensor_status::SUCCESS;
 }
 
 tensor_status particle::set_sample_time(double dt_new)
 {
-    if (dt_new == 0.0)
+    if (dt_new <= 0.0)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    /* Change the sample-time, and consequently phi and gamma */
+    return set_model(dt_new);
+}
+tensor_status particle::set_attitude_mode(attitude_mode mode_new)
+{
+    if (mode_new == mode)
+    {
+        return tensor_status::SUCCESS;
+    }
+
+    if (mode_new == attitude_mode::QUATERNION)
+    {
+        attitude = euler_to_quaternion(state(6, 0), state(7, 0), state(8, 0));
+    }
+    else
+    {
+        quaternion_to_euler(attitude, state(6, 0), state(7, 0), state(8, 0));
+    }
+
+    mode = mode_new;
+    body_frame_current = false;
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status particle::set_attitude(const quaternion &q)
+{
+    if ((mode != attitude_mode::QUATERNION) || (norm(q) == 0.0))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    attitude = normalize(q);
+    body_frame_current = false;
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status particle::set_state(const tensor &state_new)
+{
+    if ((state_new.m_height != STATE_SIZE) || (state_new.n_width != 1))
     {
         return tensor_status::FAILURE;
     }
 
-    dt = dt_new; /* Change the sample-time*/
-    // set_phi(dt_new);
-    // set_gamma(dt_new); /* Consequently update gamma */
+    for (unsigned int i = 0; i < STATE_SIZE; i++)
+    {
+        state(i, 0) = state_new(i, 0);
+    }
+
+    if (mode == attitude_mode::QUATERNION)
+    {
+        attitude = euler_to_quaternion(state(6, 0), state(7, 0), state(8, 0));
+    }
+    body_frame_current = false;
+
     return tensor_status::SUCCESS;
-    ;
 }
+
 /******************************************************************************
  * Getters
 ******************************************************************************/
-tensor particle::get_state(void)
+tensor particle::get_state(void) const
+{
+    tensor state_copy = copy(state);
+
+    if (mode == attitude_mode::QUATERNION)
+    { /* The state's yaw, pitch and roll are only filled in when read */
+        quaternion_to_euler(attitude, state_copy(6, 0), state_copy(7, 0),
+                            state_copy(8, 0));
+    }
+
+    return state_copy;
+}
+
+quaternion particle::get_attitude(void)
+{
+    if (mode == attitude_mode::QUATERNION)
+    {
+        return attitude;
+    }
+
+    return euler_to_quaternion(state(6, 0), state(7, 0), state(8, 0));
+}
+
+const tensor &particle::get_body_frame(void)
+{
+    if (!body_frame_current)
+    {
+        fixed_tensor<3, 3> dcm;
+
+        if (mode == attitude_mode::QUATERNION)
+        {
+            quaternion_to_dcm(attitude, dcm);
+        }
+        else
+        {
+            create_dcm(state(6, 0), state(7, 0), state(8, 0), dcm);
+        }
+
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            for (unsigned int j = 0; j < 3; j++)
+            {
+                body_frame(i, j) = dcm(i, j);
+            }
+        }
+        body_frame_current = true;
+    }
+
+    return body_frame;
+}
+
+shared_ptr<const dynamics_model> particle::get_model(void) const
 {
-    return copy(state);
+    return model;
 }
 
 void particle::print(void)
@@ -101,10 +334,15 @@ void particle::print(void)
     cout << "moment of inertia = " << moi << "\r\n";
     cout << "state (X):\r\n";
     state.print();
+    if (mode == attitude_mode::QUATERNION)
+    {
+        cout << "attitude (q):\r\n";
+        attitude.print();
+    }
     cout << "dynamics matrix (Phi):\r\n";
-    phi.print();
+    copy(model->phi).print();
     cout << "input matrix (Gamma):\r\n";
-    gamma.print();
+    copy(model->gamma).print();
     cout << "input vector (u):\r\n";
     u.print();
 }
@@ -113,6 +351,41 @@ void particle::print(void)
  *****************************************************************************/
 #ifdef TESTING_PARTICLE
 
+#ifdef TEST_PARTICLE_ALLOCATIONS
+#include <stdlib.h>
+
+/* Count every heap allocation made by the program */
+static unsigned long allocation_count = 0;
+
+void *operator new(size_t size)
+{
+    allocation_count++;
+    void *p = malloc(size ? size : 1);
+    if (p == nullptr)
+    {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+void *operator new(size_t size, align_val_t alignment)
+{
+    allocation_count++;
+    size_t a = (size_t)alignment;
+    void *p = aligned_alloc(a, ((size + a - 1) / a) * a);
+    if (p == nullptr)
+    {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete(void *p, align_val_t) noexcept { free(p); }
+void operator delete(void *p, size_t, align_val_t) noexcept { free(p); }
+#endif
+
 int main(void)
 {
 #ifdef TEST_PARTICLE_PRINT
@@ -147,6 +420,185 @@ int main(void)
         a.get_state().print();
     }
 #endif
+
+#ifdef TEST_PARTICLE_DISCRETIZATION
+    {
+        cout << "TEST_PARTICLE_DISCRETIZATION\r\n";
+        /* Under a constant force the discretization is exact, whatever the
+         * sample-time: x = x0 + f t^2 / (2 m), v = f t / m */
+        particle a(0.0, 0.0, 0.0);
+        a.set_mass(2.0);
+        a.set_u(4.0, 0.0, 0.0, 0.0, 0.0, 0.0);
+
+        double t = 0.0;
+        const double sample_times[3] = {0.001, 0.01, 0.0025};
+        for (unsigned int k = 0; k < 300; k++)
+        { /* Switch sample-times, as a variable-rate run does */
+            const double dt = sample_times[k % 3];
+            a.set_sample_time(dt);
+            a.update();
+            t += dt;
+        }
+        tensor x = a.get_state();
+        cout << "t = " << t << ": x = " << x(0, 0) << " (expected "
+             << t * t << "), v = " << x(3, 0) << " (expected " << 2.0 * t
+             << ")\r\n";
+
+        /* Particles with the same parameters share one discretization */
+        shared_ptr<const dynamics_model> d1 =
+            dynamics_model::intern(0.001, 2.0, 1.0, 0.8);
+        shared_ptr<const dynamics_model> d2 =
+            dynamics_model::intern(0.001, 2.0, 1.0, 0.8);
+        cout << "shared = " << (d1 == d2) << ", gamma:\r\n";
+        copy(d1->gamma).print();
+    }
+#endif
+
+#ifdef TEST_PARTICLE_QUATERNION
+    {
+        cout << "TEST_PARTICLE_QUATERNION\r\n";
+        particle a(0.0, 0.0, 0.0);
+        a.set_attitude_mode(attitude_mode::QUATERNION);
+
+        /* One step of torque sets the body tumbling about a fixed axis */
+        a.set_u(0.0, 0.0, 0.0, 3000.0, -2000.0, 1000.0);
+        a.update();
+        a.set_u(0.0, 0.0, 0.0, 0.0, 0.0, 0.0);
+        quaternion start = a.get_attitude();
+        tensor x = a.get_state();
+
+        const unsigned int steps = 20000;
+        for (unsigned int i = 0; i < steps; i++)
+        {
+            a.update();
+        }
+
+        /* With constant rates the attitude is start * exp(w * t / 2) */
+        const double t = steps * 0.001;
+        const double hx = 0.5 * t * x(11, 0);
+        const double hy = 0.5 * t * x(10, 0);
+        const double hz = 0.5 * t * x(9, 0);
+        const double h = sqrt(hx * hx + hy * hy + hz * hz);
+        quaternion expected = multiply(start,
+                                       quaternion(cos(h), sin(h) / h * hx,
+                                                  sin(h) / h * hy,
+                                                  sin(h) / h * hz));
+        quaternion q = a.get_attitude();
+        cout << "turned " << 2.0 * h << " rad, max |q - closed form| = "
+             << fmax(fmax(fabs(q.w - expected.w), fabs(q.x - expected.x)),
+                     fmax(fabs(q.y - expected.y), fabs(q.z - expected.z)))
+             << ", |1 - |q|| = " << fabs(1.0 - norm(q)) << "\r\n";
+
+        /* The body frame stays orthonormal through every pitch angle */
+        tensor frame = copy(a.get_body_frame());
+        tensor frame_error = multiply(frame, transpose(frame));
+        double max_error = 0.0;
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            for (unsigned int j = 0; j < 3; j++)
+            {
+                max_error = fmax(max_error, fabs(frame_error(i, j) -
+                                                 ((i == j) ? 1.0 : 0.0)));
+            }
+        }
+        cout << "max |C * C^T - I| = " << max_error << "\r\n";
+
+        /* Back to Euler angles, the body frame is rebuilt by create_dcm() */
+        a.set_attitude_mode(attitude_mode::EULER);
+        const tensor &euler_frame = a.get_body_frame();
+        max_error = 0.0;
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            for (unsigned int j = 0; j < 3; j++)
+            {
+                max_error = fmax(max_error,
+                                 fabs(euler_frame(i, j) - frame(i, j)));
+            }
+        }
+        cout << "max |euler body frame - quaternion body frame| = "
+             << max_error << "\r\n";
+    }
+#endif
+
+#ifdef TEST_PARTICLE_JUMP
+    {
+        cout << "TEST_PARTICLE_JUMP\r\n";
+        /* The impulse of TEST_PARTICLE_UPDATE, then the coast in one jump */
+        particle a(1.2, 2.5, -1.125);
+        particle b(1.2, 2.5, -1.125);
+        a.set_mass(0.001);
+        b.set_mass(0.001);
+        a.set_attitude_mode(attitude_mode::QUATERNION);
+        b.set_attitude_mode(attitude_mode::QUATERNION);
+        a.set_u(2000.0, 1000.0, 0.0, 3.0, -2.0, 1.0);
+        b.set_u(2000.0, 1000.0, 0.0, 3.0, -2.0, 1.0);
+        a.update();
+        b.update();
+        a.set_u(0.0, 0.0, 0.0, 0.0, 0.0, 0.0);
+        b.set_u(0.0, 0.0, 0.0, 0.0, 0.0, 0.0);
+
+        for (unsigned int i = 0; i < 999; i++)
+        {
+            a.update();
+        }
+        b.advance(999);
+
+        tensor xa = a.get_state();
+        tensor xb = b.get_state();
+        double max_error = 0.0;
+        for (unsigned int i = 0; i < STATE_SIZE; i++)
+        {
+            max_error = fmax(max_error, fabs(xa(i, 0) - xb(i, 0)));
+        }
+        quaternion qa = a.get_attitude();
+        quaternion qb = b.get_attitude();
+        cout << "999 steps: max |stepped - jumped| = " << max_error
+             << ", attitude " << fmax(fmax(fabs(qa.w - qb.w),
+                                           fabs(qa.x - qb.x)),
+                                      fmax(fabs(qa.y - qb.y),
+                                           fabs(qa.z - qb.z)))
+             << "\r\n";
+
+        /* Under a constant force: x = f t^2 / (2 m), v = f t / m, a billion
+         * steps ahead */
+        particle c(0.0, 0.0, 0.0);
+        c.set_mass(2.0);
+        c.set_u(4.0, 0.0, 0.0, 0.0, 0.0, 0.0);
+        const unsigned long k = 1000000000UL;
+        c.advance(k);
+        tensor x = c.get_state();
+        const double t = k * 0.001;
+        cout << "t = " << t << ": x = " << x(0, 0) << " (expected " << t * t
+             << "), v = " << x(3, 0) << " (expected " << 2.0 * t << ")\r\n";
+    }
+#endif
+
+#ifdef TEST_PARTICLE_ALLOCATIONS
+    {
+        cout << "TEST_PARTICLE_ALLOCATIONS\r\n";
+        particle a(1.2, 2.5, -1.125);
+        a.set_u(2000.0, 1000.0, 0.0, 0.0, 0.0, 0.0);
+
+        unsigned long before = allocation_count;
+        for (unsigned int i = 0; i < 1000; i++)
+        {
+            a.update();
+        }
+        cout << "heap allocations in 1000 updates = "
+             << (allocation_count - before) << "\r\n";
+
+        a.set_attitude_mode(attitude_mode::QUATERNION);
+        a.set_u(2000.0, 1000.0, 0.0, 1.0, 2.0, 3.0);
+        before = allocation_count;
+        for (unsigned int i = 0; i < 1000; i++)
+        {
+            a.update();
+        }
+        a.get_body_frame();
+        cout << "heap allocations in 1000 quaternion updates = "
+             << (allocation_count - before) << "\r\n";
+    }
+#endif
     return 0;
 }
 #endif
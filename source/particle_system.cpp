@@ -0,0 +1,473 @@
+/**
+* @file particle_system.cpp
+*
+* @brief A structure-of-arrays container that steps many particles at once
+*
+* @author Pavlo Vlastos
+*/
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "particle_system.h"
+
+/******************************************************************************
+ * DEFINES
+ *****************************************************************************/
+#define AXES 3
+
+/******************************************************************************
+ * PRIVATE FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+/**
+ * @brief Advance one axis of a double integrator for particles [begin, end):
+ * p = p + dt * v + p_gain * f, then v = v + v_gain * f. The expression order
+ * matches the rows of phi and gamma in particle::update().
+ */
+static void propagate_axis(unsigned int begin, unsigned int end, double dt,
+                           double *__restrict p, double *__restrict v,
+                           const double *__restrict f,
+                           const double *__restrict p_gain,
+                           const double *__restrict v_gain)
+{
+    for (unsigned int i = begin; i < end; i++)
+    {
+        p[i] = p[i] + dt * v[i] + p_gain[i] * f[i];
+        v[i] = v[i] + v_gain[i] * f[i];
+    }
+}
+
+/**
+ * @brief Advance one axis of a double integrator for particles [begin, end)
+ * by k steps at once. phi^k is [1 k*dt; 0 1] and the input matrix summed over
+ * the k steps is [k^2 * p_gain; k * v_gain], as dynamics_model::jump() finds
+ * by repeated squaring; here they are written out directly.
+ */
+static void jump_axis(unsigned int begin, unsigned int end, double k,
+                      double dt, double *__restrict p, double *__restrict v,
+                      const double *__restrict f,
+                      const double *__restrict p_gain,
+                      const double *__restrict v_gain)
+{
+    const double k_dt = k * dt;
+    const double k_sq = k * k;
+
+    for (unsigned int i = begin; i < end; i++)
+    {
+        p[i] = p[i] + k_dt * v[i] + k_sq * p_gain[i] * f[i];
+        v[i] = v[i] + k * v_gain[i] * f[i];
+    }
+}
+
+tensor_status particle_system::update_gains(unsigned int i)
+{
+    /* The non-zeros of the same (shared) gamma a particle steps with */
+    shared_ptr<const dynamics_model> d =
+        dynamics_model::intern(dt, masses[i], radii[i], mois[i]);
+
+    if (d == nullptr)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    linear_position_gain[i] = d->gamma(0, 0);
+    linear_velocity_gain[i] = d->gamma(3, 0);
+    angular_position_gain[i] = d->gamma(6, 3);
+    angular_velocity_gain[i] = d->gamma(9, 3);
+
+    return tensor_status::SUCCESS;
+}
+
+/******************************************************************************
+ * PUBLIC FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+void particle_system::reserve(unsigned int capacity)
+{
+    for (unsigned int s = 0; s < STATE_SIZE; s++)
+    {
+        states[s].reserve(capacity);
+    }
+    for (unsigned int s = 0; s < INPUT_SIZE; s++)
+    {
+        inputs[s].reserve(capacity);
+    }
+
+    masses.reserve(capacity);
+    radii.reserve(capacity);
+    mois.reserve(capacity);
+    linear_position_gain.reserve(capacity);
+    linear_velocity_gain.reserve(capacity);
+    angular_position_gain.reserve(capacity);
+    angular_velocity_gain.reserve(capacity);
+}
+
+unsigned int particle_system::add_particle(const double x, const double y,
+                                           const double z)
+{
+    for (unsigned int s = 0; s < STATE_SIZE; s++)
+    {
+        states[s].push_back(0.0);
+    }
+    for (unsigned int s = 0; s < INPUT_SIZE; s++)
+    {
+        inputs[s].push_back(0.0);
+    }
+
+    /* Position */
+    states[0][count] = x;
+    states[1][count] = y;
+    states[2][count] = z;
+
+    /* Same non-zero defaults as a lone particle */
+    masses.push_back(1.0);
+    radii.push_back(1.0);
+    mois.push_back(2.0 * (1.0 * 1.0 * 1.0) / 5.0);
+
+    linear_position_gain.push_back(0.0);
+    linear_velocity_gain.push_back(0.0);
+    angular_position_gain.push_back(0.0);
+    angular_velocity_gain.push_back(0.0);
+    update_gains(count);
+
+    return count++;
+}
+
+tensor_status particle_system::update(void)
+{
+    return update(0, count);
+}
+
+tensor_status particle_system::update(unsigned int begin, unsigned int end)
+{
+    if ((begin > end) || (end > count))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    for (unsigned int a = 0; a < AXES; a++)
+    {
+        /* Translation: position a, velocity a + 3, normal force a */
+        propagate_axis(begin, end, dt, states[a].data(),
+                       states[a + 3].data(), inputs[a].data(),
+                       linear_position_gain.data(),
+                       linear_velocity_gain.data());
+
+        /* Rotation: angle a + 6, rate a + 9, tangent force a + 3 */
+        propagate_axis(begin, end, dt, states[a + 6].data(),
+                       states[a + 9].data(), inputs[a + 3].data(),
+                       angular_position_gain.data(),
+                       angular_velocity_gain.data());
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status particle_system::advance(unsigned long k)
+{
+    return advance(0, count, k);
+}
+
+tensor_status particle_system::advance(unsigned int begin, unsigned int end,
+                                       unsigned long k)
+{
+    if ((begin > end) || (end > count))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    for (unsigned int a = 0; a < AXES; a++)
+    {
+        /* Translation: position a, velocity a + 3, normal force a */
+        jump_axis(begin, end, (double)k, dt, states[a].data(),
+                  states[a + 3].data(), inputs[a].data(),
+                  linear_position_gain.data(), linear_velocity_gain.data());
+
+        /* Rotation: angle a + 6, rate a + 9, tangent force a + 3 */
+        jump_axis(begin, end, (double)k, dt, states[a + 6].data(),
+                  states[a + 9].data(), inputs[a + 3].data(),
+                  angular_position_gain.data(),
+                  angular_velocity_gain.data());
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+/******************************************************************************
+ * Setters
+******************************************************************************/
+tensor_status particle_system::set_state(unsigned int i, const tensor &state)
+{
+    if ((i >= count) || (state.m_height != STATE_SIZE) ||
+        (state.n_width != 1))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    for (unsigned int s = 0; s < STATE_SIZE; s++)
+    {
+        states[s][i] = state(s, 0);
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status particle_system::set_u(unsigned int i, const double fnx,
+                                     const double fny, const double fnz,
+                                     const double ftx, const double fty,
+                                     const double ftz)
+{
+    if (i >= count)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    inputs[0][i] = fnx;
+    inputs[1][i] = fny;
+    inputs[2][i] = fnz;
+    inputs[3][i] = ftx;
+    inputs[4][i] = fty;
+    inputs[5][i] = ftz;
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status particle_system::set_mass(unsigned int i, const double mass)
+{
+    if ((i >= count) || (mass <= 0.0))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    masses[i] = mass;
+    mois[i] = 2.0 * (mass * radii[i] * radii[i]) / 5.0; /* Moment of inertia */
+
+    return update_gains(i);
+}
+
+tensor_status particle_system::set_radius(unsigned int i, const double radius)
+{
+    if ((i >= count) || (radius <= 0.0))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    radii[i] = radius;
+    mois[i] = 2.0 * (masses[i] * radius * radius) / 5.0; /* Moment of inertia */
+
+    return update_gains(i);
+}
+
+tensor_status particle_system::set_moi(unsigned int i, const double mass,
+                                       const double radius)
+{
+    if (set_mass(i, mass) != tensor_status::SUCCESS)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    return set_radius(i, radius);
+}
+
+tensor_status particle_system::set_sample_time(double dt_new)
+{
+    if (dt_new <= 0.0)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    dt = dt_new; /* Change the sample-time*/
+
+    tensor_status status = tensor_status::SUCCESS;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (update_gains(i) != tensor_status::SUCCESS)
+        {
+            status = tensor_status::FAILURE;
+        }
+    }
+
+    return status;
+}
+
+/******************************************************************************
+ * Getters
+******************************************************************************/
+tensor_status particle_system::get_state(unsigned int i, tensor &state) const
+{
+    if ((i >= count) || (state.m_height != STATE_SIZE) ||
+        (state.n_width != 1))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    for (unsigned int s = 0; s < STATE_SIZE; s++)
+    {
+        state(s, 0) = states[s][i];
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+void particle_system::print(unsigned int i) const
+{
+    if (i >= count)
+    {
+        return;
+    }
+
+    tensor state(STATE_SIZE);
+    get_state(i, state);
+
+    cout << "particle " << i << " of " << count << "\r\n";
+    cout << "radius = " << radii[i] << " meters\r\n";
+    cout << "mass = " << masses[i] << " kg\r\n";
+    cout << "moment of inertia = " << mois[i] << "\r\n";
+    cout << "state (X):\r\n";
+    state.print();
+}
+
+/******************************************************************************
+ * UNIT TESTS
+ *****************************************************************************/
+#ifdef TESTING_PARTICLE_SYSTEM
+
+#include <math.h>
+#include <time.h>
+
+int main(void)
+{
+#ifdef TEST_PARTICLE_SYSTEM_UPDATE
+    {
+        cout << "TEST_PARTICLE_SYSTEM_UPDATE\r\n";
+
+        /* The same step response as TEST_PARTICLE_UPDATE, side by side, with
+         * a torque as well */
+        particle a(1.2, 2.5, -1.125);
+        particle_system b;
+        unsigned int i = b.add_particle(1.2, 2.5, -1.125);
+        b.add_particle(0.0, 0.0, 0.0);
+
+        a.set_mass(0.001);
+        b.set_mass(i, 0.001);
+        a.set_u(2000.0, 1000.0, 0.0, 0.5, 0.0, -0.25);
+        b.set_u(i, 2000.0, 1000.0, 0.0, 0.5, 0.0, -0.25);
+        for (unsigned int k = 0; k < 1000; k++)
+        {
+            if (k == 1)
+            {
+                a.set_u(0.0, 0.0, 0.0, 0.0, 0.0, 0.0);
+                b.set_u(i, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0);
+            }
+            a.update();
+            b.update();
+        }
+
+        b.print(i);
+
+        tensor state(STATE_SIZE);
+        b.get_state(i, state);
+        tensor expected = a.get_state();
+        double max_error = 0.0;
+        for (unsigned int s = 0; s < STATE_SIZE; s++)
+        {
+            max_error = fmax(max_error, fabs(expected(s, 0) - state(s, 0)));
+        }
+        cout << "max |particle - particle_system| = " << max_error << "\r\n";
+    }
+#endif
+
+#ifdef TEST_PARTICLE_SYSTEM_THROUGHPUT
+    {
+        cout << "TEST_PARTICLE_SYSTEM_THROUGHPUT\r\n";
+        const unsigned int n = 100000;
+        const unsigned int steps = 100;
+        particle_system b(n);
+
+        for (unsigned int i = 0; i < n; i++)
+        {
+            b.add_particle((double)i, 0.0, 0.0);
+            b.set_moi(i, 1.0 + (i % 7), 0.5 + (i % 3));
+            b.set_u(i, 1.0, 0.0, 0.0, 0.0, 0.1, 0.0);
+        }
+
+        clock_t start = clock();
+        for (unsigned int k = 0; k < steps; k++)
+        {
+            b.update();
+        }
+        double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        cout << n << " particles x " << steps << " steps: " << seconds
+             << " s, " << (n * (double)steps / seconds * 1.0e-6)
+             << " million particle-steps/s\r\n";
+    }
+#endif
+
+#ifdef TEST_PARTICLE_SYSTEM_JUMP
+    {
+        cout << "TEST_PARTICLE_SYSTEM_JUMP\r\n";
+        /* A coast under constant forces, stepped and jumped */
+        const unsigned int n = 1000;
+        const unsigned long steps = 5000;
+        particle_system stepped(n);
+        particle_system jumped(n);
+        particle lone(0.0, 0.0, 0.0);
+
+        for (unsigned int i = 0; i < n; i++)
+        {
+            stepped.add_particle((double)i, 0.0, 0.0);
+            jumped.add_particle((double)i, 0.0, 0.0);
+            stepped.set_moi(i, 1.0 + (i % 7), 0.5 + (i % 3));
+            jumped.set_moi(i, 1.0 + (i % 7), 0.5 + (i % 3));
+            stepped.set_u(i, 1.0, -0.5, 0.0, 0.0, 0.1, 0.0);
+            jumped.set_u(i, 1.0, -0.5, 0.0, 0.0, 0.1, 0.0);
+        }
+        lone.set_moi(jumped.get_mass(n - 1), jumped.get_radius(n - 1));
+        tensor start_state(STATE_SIZE);
+        start_state(0, 0) = (double)(n - 1);
+        lone.set_state(start_state);
+        lone.set_u(1.0, -0.5, 0.0, 0.0, 0.1, 0.0);
+
+        clock_t start = clock();
+        for (unsigned long k = 0; k < steps; k++)
+        {
+            stepped.update();
+        }
+        double stepped_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        start = clock();
+        jumped.advance(steps);
+        double jumped_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+        lone.advance(steps);
+
+        tensor a(STATE_SIZE);
+        tensor b(STATE_SIZE);
+        double max_error = 0.0;
+        double max_value = 0.0;
+        for (unsigned int i = 0; i < n; i++)
+        {
+            stepped.get_state(i, a);
+            jumped.get_state(i, b);
+            for (unsigned int s = 0; s < STATE_SIZE; s++)
+            {
+                max_error = fmax(max_error, fabs(a(s, 0) - b(s, 0)));
+                max_value = fmax(max_value, fabs(a(s, 0)));
+            }
+        }
+        tensor c = lone.get_state();
+        double lone_error = 0.0;
+        for (unsigned int s = 0; s < STATE_SIZE; s++)
+        {
+            lone_error = fmax(lone_error, fabs(c(s, 0) - b(s, 0)));
+        }
+
+        cout << steps << " steps: stepped " << stepped_seconds
+             << " s, jumped " << jumped_seconds << " s, max |stepped - "
+             << "jumped| = " << max_error << " (of " << max_value
+             << "), max |particle - particle_system| = " << lone_error
+             << "\r\n";
+    }
+#endif
+    return 0;
+}
+#endif
@@ -0,0 +1,541 @@
+/**
+* @file quaternion.cpp
+*
+* @brief A value-type attitude quaternion, q = w + x i + y j + z k, with its
+* algebra and its conversions to and from Euler angles and Direction Cosine
+* Matrices (DCMs)
+*
+* @author Pavlo Vlastos
+*/
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "quaternion.h"
+
+/******************************************************************************
+ * DEFINES
+ *****************************************************************************/
+#define QUATERNION_MIN(a, b) (((a) < (b)) ? (a) : (b))
+
+/******************************************************************************
+ * PRIVATE FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+/**
+ * @brief The quaternion of Euler angles from the sines and cosines of the
+ * half angles
+ */
+static inline void half_angles_to_quaternion(double s_psi, double c_psi,
+                                             double s_theta, double c_theta,
+                                             double s_phi, double c_phi,
+                                             double &w, double &x, double &y,
+                                             double &z)
+{
+    const double c_theta_c_psi = c_theta * c_psi;
+    const double s_theta_s_psi = s_theta * s_psi;
+    const double s_theta_c_psi = s_theta * c_psi;
+    const double c_theta_s_psi = c_theta * s_psi;
+
+    w = c_phi * c_theta_c_psi + s_phi * s_theta_s_psi;
+    x = s_phi * c_theta_c_psi - c_phi * s_theta_s_psi;
+    y = c_phi * s_theta_c_psi + s_phi * c_theta_s_psi;
+    z = c_phi * c_theta_s_psi - s_phi * s_theta_c_psi;
+}
+
+/**
+ * @brief Write the nine DCM elements of a unit quaternion, row-major
+ */
+static inline void fill_quaternion_dcm(double w, double x, double y, double z,
+                                       double *d, unsigned int stride)
+{
+    const double ww = w * w, xx = x * x, yy = y * y, zz = z * z;
+    const double xy = x * y, xz = x * z, yz = y * z;
+    const double wx = w * x, wy = w * y, wz = w * z;
+    double *r0 = d;
+    double *r1 = d + stride;
+    double *r2 = d + 2 * stride;
+
+    r0[0] = ww + xx - yy - zz;
+    r0[1] = 2.0 * (xy + wz);
+    r0[2] = 2.0 * (xz - wy);
+
+    r1[0] = 2.0 * (xy - wz);
+    r1[1] = ww - xx + yy - zz;
+    r1[2] = 2.0 * (yz + wx);
+
+    r2[0] = 2.0 * (xz + wy);
+    r2[1] = 2.0 * (yz - wx);
+    r2[2] = ww - xx - yy + zz;
+}
+
+/******************************************************************************
+ * PUBLIC FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+tensor_status quaternion::from_tensor(const tensor &q)
+{
+    if ((q.m_height != 4) || (q.n_width != 1))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    w = q(0, 0);
+    x = q(1, 0);
+    y = q(2, 0);
+    z = q(3, 0);
+
+    return tensor_status::SUCCESS;
+}
+
+tensor quaternion::to_tensor(void) const
+{
+    tensor q(4);
+
+    q(0, 0) = w;
+    q(1, 0) = x;
+    q(2, 0) = y;
+    q(3, 0) = z;
+
+    return q;
+}
+
+void quaternion::print(void) const
+{
+    cout << "[ " << w << " " << x << " " << y << " " << z << " ]\n";
+}
+
+quaternion slerp(const quaternion &q0, const quaternion &q1, double t)
+{
+    double cos_half = q0.w * q1.w + q0.x * q1.x + q0.y * q1.y + q0.z * q1.z;
+    double sign = 1.0;
+
+    if (cos_half < 0.0)
+    { /* q1 and -q1 are the same rotation, take the shorter arc */
+        cos_half = -cos_half;
+        sign = -1.0;
+    }
+
+    double k0 = 1.0 - t;
+    double k1 = t;
+
+    if (cos_half < QUATERNION_SLERP_LINEAR_THRESHOLD)
+    {
+        const double half = acos(cos_half);
+        const double sin_half_inv = 1.0 / sin(half);
+
+        k0 = sin(k0 * half) * sin_half_inv;
+        k1 = sin(k1 * half) * sin_half_inv;
+    }
+
+    k1 *= sign;
+
+    return normalize(quaternion(k0 * q0.w + k1 * q1.w, k0 * q0.x + k1 * q1.x,
+                                k0 * q0.y + k1 * q1.y, k0 * q0.z + k1 * q1.z));
+}
+
+quaternion euler_to_quaternion(double psi, double theta, double phi)
+{
+    quaternion q;
+
+    half_angles_to_quaternion(sin(0.5 * psi), cos(0.5 * psi),
+                              sin(0.5 * theta), cos(0.5 * theta),
+                              sin(0.5 * phi), cos(0.5 * phi), q.w, q.x, q.y,
+                              q.z);
+
+    return q;
+}
+
+void quaternion_to_euler(const quaternion &q, double &psi, double &theta,
+                         double &phi)
+{
+    /* The elements of the DCM that hold the angles, see quaternion.h */
+    const double d01 = 2.0 * (q.x * q.y + q.w * q.z);
+    const double d00 = q.w * q.w + q.x * q.x - q.y * q.y - q.z * q.z;
+    const double d02 = 2.0 * (q.x * q.z - q.w * q.y);
+    const double d12 = 2.0 * (q.y * q.z + q.w * q.x);
+    const double d22 = q.w * q.w - q.x * q.x - q.y * q.y + q.z * q.z;
+
+    psi = atan2(d01, d00);
+    theta = -asin(fmax(-1.0, fmin(1.0, d02)));
+    phi = atan2(d12, d22);
+}
+
+tensor_status quaternion_to_dcm(const quaternion &q, fixed_tensor<3, 3> &dcm)
+{
+    fill_quaternion_dcm(q.w, q.x, q.y, q.z, dcm.data(), dcm.stride());
+
+    return tensor_status::SUCCESS;
+}
+
+quaternion dcm_to_quaternion(const fixed_tensor<3, 3> &dcm)
+{
+    const double trace = dcm(0, 0) + dcm(1, 1) + dcm(2, 2);
+    quaternion q;
+
+    /* Of 4w^2 = 1 + trace and 4x^2 = 1 + 2 d00 - trace (and likewise for y
+     * and z), take the square root of the largest */
+    if ((trace >= dcm(0, 0)) && (trace >= dcm(1, 1)) && (trace >= dcm(2, 2)))
+    {
+        q.w = 0.5 * sqrt(1.0 + trace);
+        const double k = 0.25 / q.w;
+        q.x = k * (dcm(1, 2) - dcm(2, 1));
+        q.y = k * (dcm(2, 0) - dcm(0, 2));
+        q.z = k * (dcm(0, 1) - dcm(1, 0));
+    }
+    else if ((dcm(0, 0) >= dcm(1, 1)) && (dcm(0, 0) >= dcm(2, 2)))
+    {
+        q.x = 0.5 * sqrt(1.0 + 2.0 * dcm(0, 0) - trace);
+        const double k = 0.25 / q.x;
+        q.w = k * (dcm(1, 2) - dcm(2, 1));
+        q.y = k * (dcm(0, 1) + dcm(1, 0));
+        q.z = k * (dcm(0, 2) + dcm(2, 0));
+    }
+    else if (dcm(1, 1) >= dcm(2, 2))
+    {
+        q.y = 0.5 * sqrt(1.0 + 2.0 * dcm(1, 1) - trace);
+        const double k = 0.25 / q.y;
+        q.w = k * (dcm(2, 0) - dcm(0, 2));
+        q.x = k * (dcm(0, 1) + dcm(1, 0));
+        q.z = k * (dcm(1, 2) + dcm(2, 1));
+    }
+    else
+    {
+        q.z = 0.5 * sqrt(1.0 + 2.0 * dcm(2, 2) - trace);
+        const double k = 0.25 / q.z;
+        q.w = k * (dcm(0, 1) - dcm(1, 0));
+        q.x = k * (dcm(0, 2) + dcm(2, 0));
+        q.y = k * (dcm(1, 2) + dcm(2, 1));
+    }
+
+    if (q.w < 0.0)
+    {
+        q = quaternion(-q.w, -q.x, -q.y, -q.z);
+    }
+
+    return q;
+}
+
+tensor_status dcm_to_quaternion(const tensor &dcm, quaternion &q)
+{
+    if ((dcm.m_height != 3) || (dcm.n_width != 3))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    q = dcm_to_quaternion(fixed_tensor<3, 3>(dcm));
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status multiply_batch(const double *pw, const double *px,
+                             const double *py, const double *pz,
+                             const double *qw, const double *qx,
+                             const double *qy, const double *qz,
+                             unsigned int n, double *rw, double *rx,
+                             double *ry, double *rz)
+{
+    for (unsigned int i = 0; i < n; i++)
+    {
+        const double a = pw[i] * qw[i] - px[i] * qx[i] - py[i] * qy[i] -
+                         pz[i] * qz[i];
+        const double b = pw[i] * qx[i] + px[i] * qw[i] + py[i] * qz[i] -
+                         pz[i] * qy[i];
+        const double c = pw[i] * qy[i] - px[i] * qz[i] + py[i] * qw[i] +
+                         pz[i] * qx[i];
+        const double d = pw[i] * qz[i] + px[i] * qy[i] - py[i] * qx[i] +
+                         pz[i] * qw[i];
+
+        /* Written last, so r may be p or q */
+        rw[i] = a;
+        rx[i] = b;
+        ry[i] = c;
+        rz[i] = d;
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status normalize_batch(double *w, double *x, double *y, double *z,
+                              unsigned int n)
+{
+    for (unsigned int i = 0; i < n; i++)
+    {
+        const double scale = 1.0 / sqrt(w[i] * w[i] + x[i] * x[i] +
+                                        y[i] * y[i] + z[i] * z[i]);
+
+        w[i] *= scale;
+        x[i] *= scale;
+        y[i] *= scale;
+        z[i] *= scale;
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status euler_to_quaternion_batch(const double *psi,
+                                        const double *theta,
+                                        const double *phi, unsigned int n,
+                                        double *w, double *x, double *y,
+                                        double *z)
+{
+    double half[ROTATION_BLOCK];
+    double s_psi[ROTATION_BLOCK], c_psi[ROTATION_BLOCK];
+    double s_theta[ROTATION_BLOCK], c_theta[ROTATION_BLOCK];
+    double s_phi[ROTATION_BLOCK], c_phi[ROTATION_BLOCK];
+
+    for (unsigned int i0 = 0; i0 < n; i0 += ROTATION_BLOCK)
+    {
+        const unsigned int nb = QUATERNION_MIN(ROTATION_BLOCK, n - i0);
+
+        for (unsigned int i = 0; i < nb; i++)
+        {
+            half[i] = 0.5 * psi[i0 + i];
+        }
+        sincos_batch(half, nb, s_psi, c_psi);
+
+        for (unsigned int i = 0; i < nb; i++)
+        {
+            half[i] = 0.5 * theta[i0 + i];
+        }
+        sincos_batch(half, nb, s_theta, c_theta);
+
+        for (unsigned int i = 0; i < nb; i++)
+        {
+            half[i] = 0.5 * phi[i0 + i];
+        }
+        sincos_batch(half, nb, s_phi, c_phi);
+
+        for (unsigned int i = 0; i < nb; i++)
+        {
+            half_angles_to_quaternion(s_psi[i], c_psi[i], s_theta[i],
+                                      c_theta[i], s_phi[i], c_phi[i],
+                                      w[i0 + i], x[i0 + i], y[i0 + i],
+                                      z[i0 + i]);
+        }
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status quaternion_to_dcm_batch(const double *w, const double *x,
+                                      const double *y, const double *z,
+                                      unsigned int n, double *dcms)
+{
+    for (unsigned int i = 0; i < n; i++)
+    {
+        fill_quaternion_dcm(w[i], x[i], y[i], z[i],
+                            dcms + (size_t)i * DCM_SIZE, 3);
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+/******************************************************************************
+ * UNIT TESTS
+ *****************************************************************************/
+#ifdef TESTING_QUATERNION
+
+#include <time.h>
+
+/* Largest element-wise difference between two 3x3 DCMs */
+static double dcm_difference(const fixed_tensor<3, 3> &a,
+                             const fixed_tensor<3, 3> &b)
+{
+    double max_error = 0.0;
+
+    for (unsigned int e = 0; e < DCM_SIZE; e++)
+    {
+        max_error = fmax(max_error, fabs(a.elements[e] - b.elements[e]));
+    }
+
+    return max_error;
+}
+
+int main(void)
+{
+#ifdef TEST_QUATERNION_ALGEBRA
+    {
+        cout << "TEST_QUATERNION_ALGEBRA\r\n";
+        quaternion p = euler_to_quaternion(0.3, -0.2, 0.1);
+        quaternion q = euler_to_quaternion(-1.1, 0.4, 2.0);
+
+        cout << "p * conjugate(p) = ";
+        multiply(p, conjugate(p)).print();
+
+        /* dcm(p * q) = dcm(q) * dcm(p) */
+        fixed_tensor<3, 3> dcm_p, dcm_q, dcm_pq;
+        quaternion_to_dcm(p, dcm_p);
+        quaternion_to_dcm(q, dcm_q);
+        quaternion_to_dcm(multiply(p, q), dcm_pq);
+        cout << "max |dcm(p * q) - dcm(q) * dcm(p)| = "
+             << dcm_difference(dcm_pq, multiply(dcm_q, dcm_p)) << "\r\n";
+
+        /* Rotating a vector without a matrix */
+        double v[3] = {1.0, -2.0, 0.5};
+        double r[3];
+        rotate(p, v, r);
+        double max_error = 0.0;
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            const double expected = dcm_p(i, 0) * v[0] + dcm_p(i, 1) * v[1] +
+                                    dcm_p(i, 2) * v[2];
+            max_error = fmax(max_error, fabs(r[i] - expected));
+        }
+        cout << "max |rotate(p, v) - dcm(p) * v| = " << max_error << "\r\n";
+
+        quaternion drifted(1.000000001 * p.w, 1.000000001 * p.x,
+                           1.000000001 * p.y, 1.000000001 * p.z);
+        cout << "|1 - |normalize(drifted)|| = "
+             << fabs(1.0 - norm(normalize(drifted))) << "\r\n";
+
+        /* Composition through quaternions against 4x1 tensors and multiply */
+        const unsigned int n = 100000;
+        quaternion step = euler_to_quaternion(0.001, 0.0005, -0.0002);
+        quaternion attitude;
+        clock_t start = clock();
+        for (unsigned int i = 0; i < n; i++)
+        {
+            attitude = multiply(attitude, step);
+        }
+        double quaternion_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        tensor attitude_tensor = quaternion().to_tensor();
+        start = clock();
+        for (unsigned int i = 0; i < n; i++)
+        { /* Left-multiplication matrix of the attitude times the step */
+            const tensor &a = attitude_tensor;
+            tensor left(vector<vector<double>>{
+                {a(0, 0), -a(1, 0), -a(2, 0), -a(3, 0)},
+                {a(1, 0), a(0, 0), -a(3, 0), a(2, 0)},
+                {a(2, 0), a(3, 0), a(0, 0), -a(1, 0)},
+                {a(3, 0), -a(2, 0), a(1, 0), a(0, 0)}});
+            attitude_tensor = multiply(left, step.to_tensor());
+        }
+        double tensor_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        cout << "max |quaternion - tensor composition| = "
+             << fmax(fmax(fabs(attitude.w - attitude_tensor(0, 0)),
+                          fabs(attitude.x - attitude_tensor(1, 0))),
+                     fmax(fabs(attitude.y - attitude_tensor(2, 0)),
+                          fabs(attitude.z - attitude_tensor(3, 0))))
+             << "\r\n";
+        cout << n << " compositions: quaternion " << quaternion_seconds
+             << " s, tensor " << tensor_seconds << " s\r\n";
+    }
+#endif
+
+#ifdef TEST_QUATERNION_CONVERSIONS
+    {
+        cout << "TEST_QUATERNION_CONVERSIONS\r\n";
+        /* Angles reaching every branch of Shepperd's method */
+        const double angles[][3] = {{0.3, -0.2, 0.1},
+                                    {0.1, 0.2, 3.0},
+                                    {2.9, 0.1, 0.2},
+                                    {1.6, 0.3, 3.1},
+                                    {-3.0, -1.2, -2.5}};
+        double max_dcm = 0.0, max_round_trip = 0.0, max_euler = 0.0;
+
+        for (unsigned int i = 0; i < 5; i++)
+        {
+            const double psi = angles[i][0];
+            const double theta = angles[i][1];
+            const double phi = angles[i][2];
+            quaternion q = euler_to_quaternion(psi, theta, phi);
+            fixed_tensor<3, 3> from_euler, from_quaternion;
+
+            create_dcm(psi, theta, phi, from_euler);
+            quaternion_to_dcm(q, from_quaternion);
+            max_dcm = fmax(max_dcm, dcm_difference(from_euler,
+                                                   from_quaternion));
+
+            quaternion back = dcm_to_quaternion(from_euler);
+            const double sign = (q.w < 0.0) ? -1.0 : 1.0;
+            max_round_trip = fmax(max_round_trip,
+                                  fmax(fmax(fabs(back.w - sign * q.w),
+                                            fabs(back.x - sign * q.x)),
+                                       fmax(fabs(back.y - sign * q.y),
+                                            fabs(back.z - sign * q.z))));
+
+            double psi_out, theta_out, phi_out;
+            quaternion_to_euler(q, psi_out, theta_out, phi_out);
+            max_euler = fmax(max_euler,
+                             fmax(fabs(psi_out - psi),
+                                  fmax(fabs(theta_out - theta),
+                                       fabs(phi_out - phi))));
+        }
+        cout << "max |dcm(euler) - dcm(quaternion)| = " << max_dcm << "\r\n";
+        cout << "max |dcm -> quaternion round trip| = " << max_round_trip
+             << "\r\n";
+        cout << "max |quaternion -> euler round trip| = " << max_euler
+             << "\r\n";
+
+        /* The tensor-based API */
+        tensor q_tensor(4);
+        tensor dcm(3, 3);
+        euler_to_quaternion(0.3, -0.2, 0.1, q_tensor);
+        quaternion_to_dcm(q_tensor, dcm);
+        q_tensor.print();
+        dcm.print();
+    }
+#endif
+
+#ifdef TEST_QUATERNION_SLERP
+    {
+        cout << "TEST_QUATERNION_SLERP\r\n";
+        quaternion q0 = euler_to_quaternion(0.0, 0.0, 0.0);
+        quaternion q1 = euler_to_quaternion(1.0, 0.0, 0.0);
+
+        for (unsigned int i = 0; i <= 4; i++)
+        {
+            double psi, theta, phi;
+            quaternion_to_euler(slerp(q0, q1, 0.25 * i), psi, theta, phi);
+            cout << "t = " << 0.25 * i << ", yaw = " << psi << "\r\n";
+        }
+
+        /* -q1 is the same rotation, so the path must not go the long way */
+        quaternion q1_negated(-q1.w, -q1.x, -q1.y, -q1.z);
+        double psi, theta, phi;
+        quaternion_to_euler(slerp(q0, q1_negated, 0.5), psi, theta, phi);
+        cout << "t = 0.5 towards -q1, yaw = " << psi << "\r\n";
+    }
+#endif
+
+#ifdef TEST_QUATERNION_BATCH
+    {
+        cout << "TEST_QUATERNION_BATCH\r\n";
+        const unsigned int n = 10000;
+        vector<double> psi(n), theta(n), phi(n);
+        vector<double> w(n), x(n), y(n), z(n), dcms(DCM_SIZE * n);
+        for (unsigned int i = 0; i < n; i++)
+        {
+            psi[i] = 0.0007 * i;
+            theta[i] = 0.4 * sin(0.01 * i);
+            phi[i] = -0.0011 * i;
+        }
+
+        euler_to_quaternion_batch(psi.data(), theta.data(), phi.data(), n,
+                                  w.data(), x.data(), y.data(), z.data());
+        multiply_batch(w.data(), x.data(), y.data(), z.data(), w.data(),
+                       x.data(), y.data(), z.data(), n, w.data(), x.data(),
+                       y.data(), z.data());
+        normalize_batch(w.data(), x.data(), y.data(), z.data(), n);
+        quaternion_to_dcm_batch(w.data(), x.data(), y.data(), z.data(), n,
+                                dcms.data());
+
+        double max_error = 0.0;
+        for (unsigned int i = 0; i < n; i++)
+        {
+            quaternion q = euler_to_quaternion(psi[i], theta[i], phi[i]);
+            fixed_tensor<3, 3> dcm;
+            quaternion_to_dcm(normalize(multiply(q, q)), dcm);
+            for (unsigned int e = 0; e < DCM_SIZE; e++)
+            {
+                max_error = fmax(max_error, fabs(dcms[DCM_SIZE * i + e] -
+                                                 dcm.elements[e]));
+            }
+        }
+        cout << "max |batch - scalar| = " << max_error << "\r\n";
+    }
+#endif
+    return 0;
+}
+#endif
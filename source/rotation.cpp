@@ -0,0 +1,620 @@
+/**
+* @file rotation.cpp
+*
+* @brief Batched construction of Direction Cosine Matrices (DCMs) and rotation
+* of large point sets, for moving whole sensor frames between body and
+* inertial axes at once
+*
+* The sines and cosines come from one shared polynomial evaluation per angle:
+* the angle is reduced by the nearest multiple of pi/2 (Cody-Waite, in three
+* parts), both minimax polynomials are evaluated on the remainder, and the
+* quadrant picks and signs the results. The AVX2/FMA kernels do four angles or
+* points per instruction and are picked at run time, like gemm().
+*
+* @author Pavlo Vlastos
+*/
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "rotation.h"
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ROTATION_HAVE_X86
+#endif
+
+/******************************************************************************
+ * DEFINES
+ *****************************************************************************/
+#define ROTATION_MIN(a, b) (((a) < (b)) ? (a) : (b))
+
+#define TWO_OVER_PI 0.636619772367581343076
+#define ROUND_MAGIC 6755399441055744.0 /* 1.5 * 2^52, rounds on addition */
+
+/* pi/2 split so that j * PIO2_1 and j * PIO2_2 are exact for moderate j */
+#define PIO2_1 1.57079625129699707031e0
+#define PIO2_2 7.54978941586159635335e-8
+#define PIO2_3 5.39030285815811905290e-15
+
+/* Minimax polynomials on [-pi/4, pi/4] (Cephes):
+ * sin(r) = r + r^3 * S(r^2), cos(r) = 1 - r^2 / 2 + r^4 * C(r^2) */
+#define SIN_0 1.58962301576546568060e-10
+#define SIN_1 -2.50507477628578072866e-8
+#define SIN_2 2.75573136213857245213e-6
+#define SIN_3 -1.98412698295895385996e-4
+#define SIN_4 8.33333333332211858878e-3
+#define SIN_5 -1.66666666666666307295e-1
+
+#define COS_0 -1.13585365213876817300e-11
+#define COS_1 2.08757008419747316778e-9
+#define COS_2 -2.75573141792967388112e-7
+#define COS_3 2.48015872888517045348e-5
+#define COS_4 -1.38888888888730564116e-3
+#define COS_5 4.16666666666665929218e-2
+
+/******************************************************************************
+ * PRIVATE DATATYPES
+ *****************************************************************************/
+typedef void (*sincos_kernel)(const double *x, unsigned int n, double *s,
+                              double *c);
+
+typedef void (*rotate_kernel)(const double *d, const double *x,
+                              const double *y, const double *z, unsigned int n,
+                              double *rx, double *ry, double *rz);
+
+typedef void (*rotate_many_kernel)(const double *dcms, const unsigned int *k,
+                                   const double *x, const double *y,
+                                   const double *z, unsigned int n,
+                                   double *rx, double *ry, double *rz);
+
+/******************************************************************************
+ * PRIVATE FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+/**
+ * @brief sincos of one angle with the same reduction and polynomials as the
+ * vector kernel, so both paths agree to rounding
+ */
+static inline void sincos_scalar(double x, double &s, double &c)
+{
+    if (!(fabs(x) <= SINCOS_MAX_ARGUMENT))
+    { /* Huge (or NaN) angles go to the C library */
+        s = sin(x);
+        c = cos(x);
+        return;
+    }
+
+    const double shifted = x * TWO_OVER_PI + ROUND_MAGIC;
+    const double j = shifted - ROUND_MAGIC;
+    int64_t bits;
+    memcpy(&bits, &shifted, sizeof(bits));
+    const unsigned int quadrant = (unsigned int)(bits & 3);
+
+    const double r = ((x - j * PIO2_1) - j * PIO2_2) - j * PIO2_3;
+    const double z = r * r;
+
+    const double sin_r = r + r * z * (((((SIN_0 * z + SIN_1) * z + SIN_2) * z +
+                                        SIN_3) * z + SIN_4) * z + SIN_5);
+    const double cos_r = 1.0 - 0.5 * z +
+                         z * z * (((((COS_0 * z + COS_1) * z + COS_2) * z +
+                                    COS_3) * z + COS_4) * z + COS_5);
+
+    /* Quadrants 0..3: (s, c), (c, -s), (-s, -c), (-c, s) */
+    const double s_abs = (quadrant & 1) ? cos_r : sin_r;
+    const double c_abs = (quadrant & 1) ? sin_r : cos_r;
+
+    s = (quadrant & 2) ? -s_abs : s_abs;
+    c = ((quadrant + 1) & 2) ? -c_abs : c_abs;
+}
+
+static void sincos_kernel_scalar(const double *x, unsigned int n, double *s,
+                                 double *c)
+{
+    for (unsigned int i = 0; i < n; i++)
+    {
+        sincos_scalar(x[i], s[i], c[i]);
+    }
+}
+
+static void rotate_kernel_scalar(const double *d, const double *x,
+                                 const double *y, const double *z,
+                                 unsigned int n, double *rx, double *ry,
+                                 double *rz)
+{
+    for (unsigned int j = 0; j < n; j++)
+    {
+        rx[j] = d[0] * x[j] + d[1] * y[j] + d[2] * z[j];
+        ry[j] = d[3] * x[j] + d[4] * y[j] + d[5] * z[j];
+        rz[j] = d[6] * x[j] + d[7] * y[j] + d[8] * z[j];
+    }
+}
+
+/* k maps the nine coefficients of the product onto offsets into each DCM, so
+ * the same loop handles both directions */
+static void rotate_many_kernel_scalar(const double *dcms,
+                                      const unsigned int *k, const double *x,
+                                      const double *y, const double *z,
+                                      unsigned int n, double *rx, double *ry,
+                                      double *rz)
+{
+    for (unsigned int j = 0; j < n; j++)
+    {
+        const double *d = dcms + (size_t)j * DCM_SIZE;
+
+        rx[j] = d[k[0]] * x[j] + d[k[1]] * y[j] + d[k[2]] * z[j];
+        ry[j] = d[k[3]] * x[j] + d[k[4]] * y[j] + d[k[5]] * z[j];
+        rz[j] = d[k[6]] * x[j] + d[k[7]] * y[j] + d[k[8]] * z[j];
+    }
+}
+
+#ifdef ROTATION_HAVE_X86
+__attribute__((target("avx2,fma"))) static inline __m256d
+polynomial_avx2(__m256d z, double p0, double p1, double p2, double p3,
+                double p4, double p5)
+{
+    __m256d p = _mm256_set1_pd(p0);
+
+    p = _mm256_fmadd_pd(p, z, _mm256_set1_pd(p1));
+    p = _mm256_fmadd_pd(p, z, _mm256_set1_pd(p2));
+    p = _mm256_fmadd_pd(p, z, _mm256_set1_pd(p3));
+    p = _mm256_fmadd_pd(p, z, _mm256_set1_pd(p4));
+
+    return _mm256_fmadd_pd(p, z, _mm256_set1_pd(p5));
+}
+
+/* Four angles per iteration, any huge angles redone by the scalar path */
+__attribute__((target("avx2,fma"))) static void
+sincos_kernel_avx2(const double *x, unsigned int n, double *s, double *c)
+{
+    const __m256d two_over_pi = _mm256_set1_pd(TWO_OVER_PI);
+    const __m256d magic = _mm256_set1_pd(ROUND_MAGIC);
+    const __m256d max_argument = _mm256_set1_pd(SINCOS_MAX_ARGUMENT);
+    const __m256d abs_mask =
+        _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+    const __m256i one = _mm256_set1_epi64x(1);
+    const __m256i two = _mm256_set1_epi64x(2);
+    unsigned int i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m256d xv = _mm256_loadu_pd(x + i);
+        const __m256d shifted = _mm256_fmadd_pd(xv, two_over_pi, magic);
+        const __m256d j = _mm256_sub_pd(shifted, magic);
+        const __m256i quadrant = _mm256_castpd_si256(shifted);
+
+        __m256d r = _mm256_fnmadd_pd(j, _mm256_set1_pd(PIO2_1), xv);
+        r = _mm256_fnmadd_pd(j, _mm256_set1_pd(PIO2_2), r);
+        r = _mm256_fnmadd_pd(j, _mm256_set1_pd(PIO2_3), r);
+        const __m256d z = _mm256_mul_pd(r, r);
+
+        const __m256d sin_r = _mm256_fmadd_pd(
+            _mm256_mul_pd(r, z),
+            polynomial_avx2(z, SIN_0, SIN_1, SIN_2, SIN_3, SIN_4, SIN_5), r);
+        const __m256d cos_r = _mm256_fmadd_pd(
+            _mm256_mul_pd(z, z),
+            polynomial_avx2(z, COS_0, COS_1, COS_2, COS_3, COS_4, COS_5),
+            _mm256_fnmadd_pd(_mm256_set1_pd(0.5), z, _mm256_set1_pd(1.0)));
+
+        /* Odd quadrants swap sine and cosine, bit 1 of j (j + 1) flips the
+         * sign of the sine (cosine) */
+        const __m256d swap = _mm256_castsi256_pd(_mm256_cmpeq_epi64(
+            _mm256_and_si256(quadrant, one), one));
+        const __m256d s_abs = _mm256_blendv_pd(sin_r, cos_r, swap);
+        const __m256d c_abs = _mm256_blendv_pd(cos_r, sin_r, swap);
+        const __m256d s_sign = _mm256_castsi256_pd(
+            _mm256_slli_epi64(_mm256_and_si256(quadrant, two), 62));
+        const __m256d c_sign = _mm256_castsi256_pd(_mm256_slli_epi64(
+            _mm256_and_si256(_mm256_add_epi64(quadrant, one), two), 62));
+
+        _mm256_storeu_pd(s + i, _mm256_xor_pd(s_abs, s_sign));
+        _mm256_storeu_pd(c + i, _mm256_xor_pd(c_abs, c_sign));
+
+        /* NaN compares false, so it is redone as well */
+        const __m256d in_range = _mm256_cmp_pd(_mm256_and_pd(xv, abs_mask),
+                                               max_argument, _CMP_LE_OQ);
+        if (_mm256_movemask_pd(in_range) != 0xF)
+        {
+            sincos_kernel_scalar(x + i, 4, s + i, c + i);
+        }
+    }
+
+    sincos_kernel_scalar(x + i, n - i, s + i, c + i);
+}
+
+__attribute__((target("avx2,fma"))) static void
+rotate_kernel_avx2(const double *d, const double *x, const double *y,
+                   const double *z, unsigned int n, double *rx, double *ry,
+                   double *rz)
+{
+    __m256d dv[DCM_SIZE];
+    unsigned int j = 0;
+
+    for (unsigned int k = 0; k < DCM_SIZE; k++)
+    {
+        dv[k] = _mm256_set1_pd(d[k]);
+    }
+
+    for (; j + 4 <= n; j += 4)
+    {
+        const __m256d xv = _mm256_loadu_pd(x + j);
+        const __m256d yv = _mm256_loadu_pd(y + j);
+        const __m256d zv = _mm256_loadu_pd(z + j);
+
+        _mm256_storeu_pd(rx + j, _mm256_fmadd_pd(dv[2], zv,
+                         _mm256_fmadd_pd(dv[1], yv, _mm256_mul_pd(dv[0], xv))));
+        _mm256_storeu_pd(ry + j, _mm256_fmadd_pd(dv[5], zv,
+                         _mm256_fmadd_pd(dv[4], yv, _mm256_mul_pd(dv[3], xv))));
+        _mm256_storeu_pd(rz + j, _mm256_fmadd_pd(dv[8], zv,
+                         _mm256_fmadd_pd(dv[7], yv, _mm256_mul_pd(dv[6], xv))));
+    }
+
+    rotate_kernel_scalar(d, x + j, y + j, z + j, n - j, rx + j, ry + j,
+                         rz + j);
+}
+
+/* Four points per iteration, gathering each coefficient of four DCMs */
+__attribute__((target("avx2,fma"))) static void
+rotate_many_kernel_avx2(const double *dcms, const unsigned int *k,
+                        const double *x, const double *y, const double *z,
+                        unsigned int n, double *rx, double *ry, double *rz)
+{
+    const __m128i offsets = _mm_setr_epi32(0, DCM_SIZE, 2 * DCM_SIZE,
+                                           3 * DCM_SIZE);
+    const __m256d all_lanes = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+    unsigned int j = 0;
+
+    for (; j + 4 <= n; j += 4)
+    {
+        const double *d = dcms + (size_t)j * DCM_SIZE;
+        const __m256d xv = _mm256_loadu_pd(x + j);
+        const __m256d yv = _mm256_loadu_pd(y + j);
+        const __m256d zv = _mm256_loadu_pd(z + j);
+        __m256d dv[DCM_SIZE];
+
+        for (unsigned int e = 0; e < DCM_SIZE; e++)
+        {
+            dv[e] = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), d + k[e],
+                                             offsets, all_lanes, 8);
+        }
+
+        _mm256_storeu_pd(rx + j, _mm256_fmadd_pd(dv[2], zv,
+                         _mm256_fmadd_pd(dv[1], yv, _mm256_mul_pd(dv[0], xv))));
+        _mm256_storeu_pd(ry + j, _mm256_fmadd_pd(dv[5], zv,
+                         _mm256_fmadd_pd(dv[4], yv, _mm256_mul_pd(dv[3], xv))));
+        _mm256_storeu_pd(rz + j, _mm256_fmadd_pd(dv[8], zv,
+                         _mm256_fmadd_pd(dv[7], yv, _mm256_mul_pd(dv[6], xv))));
+    }
+
+    rotate_many_kernel_scalar(dcms + (size_t)j * DCM_SIZE, k, x + j, y + j,
+                              z + j, n - j, rx + j, ry + j, rz + j);
+}
+#endif
+
+/**
+ * @brief Whether this CPU can run the AVX2/FMA kernels
+ */
+static bool select_avx2(void)
+{
+#ifdef ROTATION_HAVE_X86
+    __builtin_cpu_init();
+    return (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"));
+#else
+    return false;
+#endif
+}
+
+static bool use_avx2(void)
+{
+    static const bool avx2 = select_avx2();
+    return avx2;
+}
+
+static sincos_kernel select_sincos_kernel(void)
+{
+#ifdef ROTATION_HAVE_X86
+    if (use_avx2())
+    {
+        return sincos_kernel_avx2;
+    }
+#endif
+    return sincos_kernel_scalar;
+}
+
+static rotate_kernel select_rotate_kernel(void)
+{
+#ifdef ROTATION_HAVE_X86
+    if (use_avx2())
+    {
+        return rotate_kernel_avx2;
+    }
+#endif
+    return rotate_kernel_scalar;
+}
+
+static rotate_many_kernel select_rotate_many_kernel(void)
+{
+#ifdef ROTATION_HAVE_X86
+    if (use_avx2())
+    {
+        return rotate_many_kernel_avx2;
+    }
+#endif
+    return rotate_many_kernel_scalar;
+}
+
+/**
+ * @brief Check a 3 x n point block and its distinct 3 x n destination
+ */
+static bool check_points(const tensor &points, const tensor &rotated)
+{
+    return ((points.m_height == 3) && (rotated.m_height == 3) &&
+            (points.n_width == rotated.n_width) &&
+            (points.data() != rotated.data()));
+}
+
+/******************************************************************************
+ * PUBLIC FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+void sincos_batch(const double *x, unsigned int n, double *s, double *c)
+{
+    static const sincos_kernel kernel = select_sincos_kernel();
+
+    kernel(x, n, s, c);
+}
+
+tensor_status create_dcm_batch(const double *psi, const double *theta,
+                               const double *phi, unsigned int n,
+                               double *dcms)
+{
+    double s_psi[ROTATION_BLOCK], c_psi[ROTATION_BLOCK];
+    double s_theta[ROTATION_BLOCK], c_theta[ROTATION_BLOCK];
+    double s_phi[ROTATION_BLOCK], c_phi[ROTATION_BLOCK];
+
+    if ((n > 0) && ((psi == NULL) || (theta == NULL) || (phi == NULL) ||
+                    (dcms == NULL)))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    for (unsigned int i0 = 0; i0 < n; i0 += ROTATION_BLOCK)
+    {
+        const unsigned int nb = ROTATION_MIN(ROTATION_BLOCK, n - i0);
+
+        sincos_batch(psi + i0, nb, s_psi, c_psi);
+        sincos_batch(theta + i0, nb, s_theta, c_theta);
+        sincos_batch(phi + i0, nb, s_phi, c_phi);
+
+        for (unsigned int i = 0; i < nb; i++)
+        {
+            double *d = dcms + (size_t)(i0 + i) * DCM_SIZE;
+
+            /* The same matrix as create_dcm(), with the products shared */
+            const double cpsi_stheta = c_psi[i] * s_theta[i];
+            const double spsi_stheta = s_psi[i] * s_theta[i];
+
+            d[0] = c_psi[i] * c_theta[i];
+            d[1] = s_psi[i] * c_theta[i];
+            d[2] = -s_theta[i];
+
+            d[3] = cpsi_stheta * s_phi[i] - s_psi[i] * c_phi[i];
+            d[4] = spsi_stheta * s_phi[i] + c_psi[i] * c_phi[i];
+            d[5] = c_theta[i] * s_phi[i];
+
+            d[6] = cpsi_stheta * c_phi[i] + s_psi[i] * s_phi[i];
+            d[7] = spsi_stheta * c_phi[i] - c_psi[i] * s_phi[i];
+            d[8] = c_theta[i] * c_phi[i];
+        }
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status rotate_points(const fixed_tensor<3, 3> &dcm,
+                            const tensor &points, tensor &rotated,
+                            bool inverse)
+{
+    static const rotate_kernel kernel = select_rotate_kernel();
+
+    if (!check_points(points, rotated))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    const fixed_tensor<3, 3> d = inverse ? transpose(dcm) : dcm;
+    const double *p = points.data();
+    double *r = rotated.data();
+
+    kernel(d.data(), p, p + points.stride(), p + 2 * (size_t)points.stride(),
+           points.n_width, r, r + rotated.stride(),
+           r + 2 * (size_t)rotated.stride());
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status rotate_points(const tensor &dcm, const tensor &points,
+                            tensor &rotated, bool inverse)
+{
+    if ((dcm.m_height != 3) || (dcm.n_width != 3))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    return rotate_points(fixed_tensor<3, 3>(dcm), points, rotated, inverse);
+}
+
+tensor_status rotate_points(const double *dcms, const tensor &points,
+                            tensor &rotated, bool inverse)
+{
+    static const rotate_many_kernel kernel = select_rotate_many_kernel();
+    static const unsigned int forward[DCM_SIZE] = {0, 1, 2, 3, 4, 5, 6, 7, 8};
+    static const unsigned int backward[DCM_SIZE] = {0, 3, 6, 1, 4, 7, 2, 5, 8};
+
+    if ((dcms == NULL) || !check_points(points, rotated))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    const double *p = points.data();
+    double *r = rotated.data();
+
+    kernel(dcms, inverse ? backward : forward, p, p + points.stride(),
+           p + 2 * (size_t)points.stride(), points.n_width, r,
+           r + rotated.stride(), r + 2 * (size_t)rotated.stride());
+
+    return tensor_status::SUCCESS;
+}
+
+/******************************************************************************
+ * UNIT TESTS
+ *****************************************************************************/
+#ifdef TESTING_ROTATION
+
+#include <time.h>
+
+int main(void)
+{
+#ifdef TEST_ROTATION_SINCOS
+    {
+        cout << "TEST_ROTATION_SINCOS\r\n";
+        const unsigned int n = 100003;
+        vector<double> x(n), s(n), c(n);
+        for (unsigned int i = 0; i < n; i++)
+        {
+            x[i] = -50.0 + 100.0 * i / (n - 1);
+        }
+        x[0] = 1.0e7; /* Handed to the C library */
+
+        sincos_batch(x.data(), n, s.data(), c.data());
+
+        double max_error = 0.0;
+        for (unsigned int i = 0; i < n; i++)
+        {
+            max_error = fmax(max_error, fabs(s[i] - sin(x[i])));
+            max_error = fmax(max_error, fabs(c[i] - cos(x[i])));
+        }
+        cout << "max |error| against sin/cos = " << max_error << "\r\n";
+    }
+#endif
+
+#ifdef TEST_ROTATION_DCM_BATCH
+    {
+        cout << "TEST_ROTATION_DCM_BATCH\r\n";
+        const unsigned int n = 20000;
+        vector<double> psi(n), theta(n), phi(n), dcms(DCM_SIZE * n);
+        for (unsigned int i = 0; i < n; i++)
+        {
+            psi[i] = 0.001 * i;
+            theta[i] = 0.5 * sin(0.01 * i);
+            phi[i] = -0.0003 * i;
+        }
+
+        clock_t start = clock();
+        create_dcm_batch(psi.data(), theta.data(), phi.data(), n,
+                         dcms.data());
+        double batch_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        tensor dcm(3, 3);
+        double max_error = 0.0;
+        start = clock();
+        for (unsigned int i = 0; i < n; i++)
+        {
+            create_dcm(psi[i], theta[i], phi[i], dcm);
+            for (unsigned int e = 0; e < DCM_SIZE; e++)
+            {
+                max_error = fmax(max_error, fabs(dcms[DCM_SIZE * i + e] -
+                                                 dcm(e / 3, e % 3)));
+            }
+        }
+        double single_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        cout << "max |batch - create_dcm| = " << max_error << "\r\n";
+        cout << n << " DCMs: batch " << batch_seconds << " s, one at a time "
+             << single_seconds << " s\r\n";
+    }
+#endif
+
+#ifdef TEST_ROTATION_POINTS
+    {
+        cout << "TEST_ROTATION_POINTS\r\n";
+        const unsigned int n = 50000;
+        tensor points(3, n);
+        tensor rotated(3, n);
+        tensor restored(3, n);
+        for (unsigned int j = 0; j < n; j++)
+        {
+            points(0, j) = cos(0.01 * j);
+            points(1, j) = sin(0.02 * j);
+            points(2, j) = 0.001 * j;
+        }
+
+        /* One DCM against the general multiply */
+        tensor dcm(3, 3);
+        create_dcm(0.3, -0.2, 0.1, dcm);
+
+        clock_t start = clock();
+        rotate_points(dcm, points, rotated);
+        double kernel_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        start = clock();
+        tensor expected = multiply(dcm, points);
+        double multiply_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        rotate_points(dcm, rotated, restored, true);
+        double max_error = 0.0;
+        double max_round_trip = 0.0;
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            for (unsigned int j = 0; j < n; j++)
+            {
+                max_error = fmax(max_error,
+                                 fabs(rotated(i, j) - expected(i, j)));
+                max_round_trip = fmax(max_round_trip,
+                                      fabs(restored(i, j) - points(i, j)));
+            }
+        }
+        cout << "one DCM: max |kernel - multiply| = " << max_error
+             << ", max |round trip| = " << max_round_trip << "\r\n";
+        cout << "rotate " << n << " points: kernel " << kernel_seconds
+             << " s, multiply " << multiply_seconds << " s\r\n";
+
+        /* One DCM per point */
+        vector<double> psi(n), theta(n), phi(n), dcms(DCM_SIZE * n);
+        for (unsigned int j = 0; j < n; j++)
+        {
+            psi[j] = 0.0001 * j;
+            theta[j] = 0.2;
+            phi[j] = -0.0002 * j;
+        }
+        create_dcm_batch(psi.data(), theta.data(), phi.data(), n,
+                         dcms.data());
+        rotate_points(dcms.data(), points, rotated);
+        rotate_points(dcms.data(), rotated, restored, true);
+
+        max_error = 0.0;
+        max_round_trip = 0.0;
+        tensor point(3);
+        for (unsigned int j = 0; j < n; j++)
+        {
+            create_dcm(psi[j], theta[j], phi[j], dcm);
+            for (unsigned int i = 0; i < 3; i++)
+            {
+                point(i, 0) = points(i, j);
+            }
+            tensor one = multiply(dcm, point);
+            for (unsigned int i = 0; i < 3; i++)
+            {
+                max_error = fmax(max_error, fabs(rotated(i, j) - one(i, 0)));
+                max_round_trip = fmax(max_round_trip,
+                                      fabs(restored(i, j) - points(i, j)));
+            }
+        }
+        cout << "per-point DCMs: max |kernel - multiply| = " << max_error
+             << ", max |round trip| = " << max_round_trip << "\r\n";
+        cout << "aliased status = " << (int)rotate_points(dcm, points, points)
+             << "\r\n";
+    }
+#endif
+    return 0;
+}
+#endif
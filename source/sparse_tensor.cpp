@@ -0,0 +1,280 @@
+/**
+* @file sparse_tensor.cpp
+*
+* @brief A compressed sparse row (CSR) tensor, for structured dynamics models
+* that are mostly zeros
+*
+* @author Pavlo Vlastos
+*/
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "sparse_tensor.h"
+
+/******************************************************************************
+ * PRIVATE FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+/**
+ * @brief Dot product of one sparse row with a strided dense column
+ */
+static inline double sparse_dot(const sparse_tensor &a, unsigned int row,
+                                const double *x, unsigned int x_stride)
+{
+    double sum = 0.0;
+
+    for (unsigned int k = a.row_start[row]; k < a.row_start[row + 1]; k++)
+    {
+        sum += a.values[k] * x[(size_t)a.columns[k] * x_stride];
+    }
+
+    return sum;
+}
+
+/******************************************************************************
+ * PUBLIC FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+tensor_status sparse_tensor::from_tensor(const tensor &a)
+{
+    m_height = a.m_height;
+    n_width = a.n_width;
+
+    row_start.assign(m_height + 1, 0);
+    columns.clear();
+    values.clear();
+
+    for (unsigned int i = 0; i < m_height; i++)
+    {
+        for (unsigned int j = 0; j < n_width; j++)
+        {
+            if (a(i, j) != 0.0)
+            {
+                columns.push_back(j);
+                values.push_back(a(i, j));
+            }
+        }
+        row_start[i + 1] = (unsigned int)values.size();
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+tensor sparse_tensor::to_tensor(void) const
+{
+    tensor a(m_height, n_width);
+
+    for (unsigned int i = 0; i < m_height; i++)
+    {
+        for (unsigned int k = row_start[i]; k < row_start[i + 1]; k++)
+        {
+            a(i, columns[k]) = values[k];
+        }
+    }
+
+    return a;
+}
+
+void sparse_tensor::print(void) const
+{
+    to_tensor().print();
+    cout << "Non-zeros: " << non_zeros() << "\n";
+}
+
+tensor multiply(const sparse_tensor &a, const tensor &b)
+{
+    tensor c(a.m_height, b.n_width);
+
+    multiply(a, b, c);
+
+    return c;
+}
+
+tensor_status multiply(const sparse_tensor &a, const tensor &b, tensor &c)
+{
+    /* Check tensor dimensions and that c is not also the operand b */
+    if ((a.n_width != b.m_height) || (c.m_height != a.m_height) ||
+        (c.n_width != b.n_width) || (c.data() == b.data()))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    for (unsigned int i = 0; i < a.m_height; i++)
+    {
+        double *c_row = c.data() + (size_t)i * c.stride();
+
+        for (unsigned int j = 0; j < c.n_width; j++)
+        {
+            c_row[j] = 0.0;
+        }
+
+        /* Accumulate one row of b per non-zero of row i of a */
+        for (unsigned int k = a.row_start[i]; k < a.row_start[i + 1]; k++)
+        {
+            const double a_ik = a.values[k];
+            const double *b_row = b.data() + (size_t)a.columns[k] * b.stride();
+
+            for (unsigned int j = 0; j < c.n_width; j++)
+            {
+                c_row[j] += a_ik * b_row[j];
+            }
+        }
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+tensor add(const sparse_tensor &a, const tensor &b)
+{
+    tensor c(a.m_height, a.n_width);
+
+    add(a, b, c);
+
+    return c;
+}
+
+tensor_status add(const sparse_tensor &a, const tensor &b, tensor &c)
+{
+    /* Check tensor dimensions */
+    if ((a.n_width != b.n_width) || (a.m_height != b.m_height) ||
+        (c.n_width != b.n_width) || (c.m_height != b.m_height))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    if (c.data() != b.data())
+    {
+        for (unsigned int i = 0; i < b.m_height; i++)
+        {
+            memcpy(c.data() + (size_t)i * c.stride(),
+                   b.data() + (size_t)i * b.stride(),
+                   b.n_width * sizeof(double));
+        }
+    }
+
+    for (unsigned int i = 0; i < a.m_height; i++)
+    {
+        for (unsigned int k = a.row_start[i]; k < a.row_start[i + 1]; k++)
+        {
+            c(i, a.columns[k]) += a.values[k];
+        }
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status multiply_add(const sparse_tensor &a, const tensor &x,
+                           const sparse_tensor &b, const tensor &u,
+                           tensor &y)
+{
+    /* Check tensor dimensions and that y is not also an operand */
+    if ((a.n_width != x.m_height) || (b.n_width != u.m_height) ||
+        (a.m_height != b.m_height) || (x.n_width != 1) ||
+        (u.n_width != 1) || (y.m_height != a.m_height) ||
+        (y.n_width != 1) || (y.data() == x.data()) ||
+        (y.data() == u.data()))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    for (unsigned int i = 0; i < a.m_height; i++)
+    {
+        const double ax = sparse_dot(a, i, x.data(), x.stride());
+        const double bu = sparse_dot(b, i, u.data(), u.stride());
+
+        y.data()[(size_t)i * y.stride()] = ax + bu;
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+/******************************************************************************
+ * UNIT TESTS
+ *****************************************************************************/
+#ifdef TESTING_SPARSE_TENSOR
+
+#include <math.h>
+#include <time.h>
+
+int main(void)
+{
+#ifdef TEST_SPARSE_TENSOR_CONVERSION
+    {
+        cout << "TEST_SPARSE_TENSOR_CONVERSION\r\n";
+        tensor a(vector<vector<double>>{{1, 0, 0, 2}, {0, 0, 0, 0}, {0, 3, 0, 4}});
+        sparse_tensor b(a);
+
+        b.print();
+        cout << "row_start: ";
+        for (unsigned int i = 0; i < b.row_start.size(); i++)
+        {
+            cout << b.row_start[i] << " ";
+        }
+        cout << "\r\ncolumns: ";
+        for (unsigned int i = 0; i < b.columns.size(); i++)
+        {
+            cout << b.columns[i] << " ";
+        }
+        cout << "\r\n";
+    }
+#endif
+
+#ifdef TEST_SPARSE_TENSOR_MULTIPLY
+    {
+        cout << "TEST_SPARSE_TENSOR_MULTIPLY\r\n";
+        tensor a(vector<vector<double>>{{1, 0, 0, 2}, {0, 0, 0, 0}, {0, 3, 0, 4}});
+        tensor x(vector<vector<double>>{{1, 2}, {3, 4}, {5, 6}, {7, 8}});
+        sparse_tensor b(a);
+
+        cout << "dense:\r\n";
+        multiply(a, x).print();
+        cout << "sparse:\r\n";
+        multiply(b, x).print();
+
+        tensor c(vector<vector<double>>{{1, 1, 1, 1}, {1, 1, 1, 1}, {1, 1, 1, 1}});
+        cout << "sparse + dense:\r\n";
+        add(b, c).print();
+
+        /* A banded 1000 x 1000 model with five diagonals */
+        const unsigned int n = 1000;
+        tensor d(n, n);
+        tensor v(n);
+        for (unsigned int i = 0; i < n; i++)
+        {
+            v(i, 0) = sin(0.01 * i);
+            for (unsigned int j = (i > 2) ? (i - 2) : 0; (j < n) && (j <= i + 2); j++)
+            {
+                d(i, j) = 1.0 / (1.0 + i + j);
+            }
+        }
+        sparse_tensor e(d);
+        tensor y_dense(n);
+        tensor y_sparse(n);
+
+        clock_t start = clock();
+        for (unsigned int k = 0; k < 100; k++)
+        {
+            gemv(1.0, d, v, 0.0, y_dense);
+        }
+        double dense_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        start = clock();
+        for (unsigned int k = 0; k < 100; k++)
+        {
+            multiply(e, v, y_sparse);
+        }
+        double sparse_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        double max_error = 0.0;
+        for (unsigned int i = 0; i < n; i++)
+        {
+            max_error = fmax(max_error, fabs(y_dense(i, 0) - y_sparse(i, 0)));
+        }
+        cout << "non-zeros = " << e.non_zeros() << ", max |dense - sparse| = "
+             << max_error << "\r\n";
+        cout << "100 products: dense " << dense_seconds << " s, sparse "
+             << sparse_seconds << " s\r\n";
+    }
+#endif
+    return 0;
+}
+#endif
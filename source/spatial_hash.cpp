@@ -0,0 +1,342 @@
+/**
+* @file spatial_hash.cpp
+*
+* @brief Contact detection between spherical particles: a spatial-hash grid
+* as the broad phase and sphere-sphere tests as the narrow phase
+*
+* @author Pavlo Vlastos
+*/
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "spatial_hash.h"
+#include <math.h>
+
+/******************************************************************************
+ * PRIVATE FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+unsigned long spatial_hash::query_range(unsigned int begin, unsigned int end,
+                                        vector<contact> &found) const
+{
+    unsigned long tested = 0;
+
+    for (unsigned int i = begin; i < end; i++)
+    {
+        const int64_t *ci = &cells[3 * i];
+
+        for (int64_t dx = -1; dx <= 1; dx++)
+        {
+            for (int64_t dy = -1; dy <= 1; dy++)
+            {
+                for (int64_t dz = -1; dz <= 1; dz++)
+                {
+                    const int64_t cx = ci[0] + dx;
+                    const int64_t cy = ci[1] + dy;
+                    const int64_t cz = ci[2] + dz;
+                    const uint64_t b = bucket(cx, cy, cz);
+
+                    for (unsigned int k = bucket_start[b];
+                         k < bucket_start[b + 1]; k++)
+                    {
+                        const unsigned int j = sorted[k];
+                        const int64_t *cj = &cells[3 * j];
+
+                        /* Once per pair, and only bodies of this very cell
+                         * (others may share its bucket) */
+                        if ((j <= i) || (cj[0] != cx) || (cj[1] != cy) ||
+                            (cj[2] != cz))
+                        {
+                            continue;
+                        }
+
+                        tested++;
+                        const double ex = x[j] - x[i];
+                        const double ey = y[j] - y[i];
+                        const double ez = z[j] - z[i];
+                        const double d_sq = ex * ex + ey * ey + ez * ez;
+                        const double reach = r[i] + r[j];
+
+                        if (d_sq < reach * reach)
+                        {
+                            found.push_back({i, j, reach - sqrt(d_sq)});
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return tested;
+}
+
+/******************************************************************************
+ * PUBLIC FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+tensor_status spatial_hash::build(const double *x_in, const double *y_in,
+                                  const double *z_in, const double *r_in,
+                                  unsigned int n_in)
+{
+    if ((n_in > 0) && ((x_in == nullptr) || (y_in == nullptr) ||
+                       (z_in == nullptr) || (r_in == nullptr)))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    x = x_in;
+    y = y_in;
+    z = z_in;
+    r = r_in;
+    n = n_in;
+
+    /* Cells as wide as the largest sphere, at least */
+    double r_max = 0.0;
+    for (unsigned int i = 0; i < n; i++)
+    {
+        if (!(r[i] >= 0.0))
+        {
+            return tensor_status::FAILURE;
+        }
+        r_max = fmax(r_max, r[i]);
+    }
+
+    cell_in_use = fmax(cell_size, 2.0 * r_max);
+    if (cell_in_use <= 0.0)
+    {
+        cell_in_use = 1.0;
+    }
+    const double inverse = 1.0 / cell_in_use;
+
+    uint64_t buckets = 1;
+    while (buckets < (uint64_t)SPATIAL_HASH_LOAD * n)
+    {
+        buckets <<= 1;
+    }
+    mask = buckets - 1;
+
+    /* Counting sort of the bodies by bucket: count, prefix sum, scatter */
+    cells.resize(3 * (size_t)n);
+    body_bucket.resize(n);
+    bucket_start.assign(buckets + 1, 0);
+    sorted.resize(n);
+
+    for (unsigned int i = 0; i < n; i++)
+    {
+        int64_t *c = &cells[3 * (size_t)i];
+        c[0] = (int64_t)floor(x[i] * inverse);
+        c[1] = (int64_t)floor(y[i] * inverse);
+        c[2] = (int64_t)floor(z[i] * inverse);
+        body_bucket[i] = bucket(c[0], c[1], c[2]);
+        bucket_start[body_bucket[i] + 1]++;
+    }
+
+    for (uint64_t b = 0; b < buckets; b++)
+    {
+        bucket_start[b + 1] += bucket_start[b];
+    }
+
+    for (unsigned int i = 0; i < n; i++)
+    { /* Stable: each bucket lists its bodies in increasing order */
+        sorted[bucket_start[body_bucket[i]]++] = i;
+    }
+
+    /* The scatter advanced every start to the next bucket's */
+    for (uint64_t b = buckets; b > 0; b--)
+    {
+        bucket_start[b] = bucket_start[b - 1];
+    }
+    bucket_start[0] = 0;
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status spatial_hash::build(const particle_system &system)
+{
+    return build(system.state_component(0), system.state_component(1),
+                 system.state_component(2), system.radius_component(),
+                 system.size());
+}
+
+tensor_status spatial_hash::query(vector<contact> &contacts,
+                                  thread_pool *pool)
+{
+    contacts.clear();
+    candidates = 0;
+
+    if (n == 0)
+    {
+        return tensor_status::SUCCESS;
+    }
+
+    if (pool == nullptr)
+    {
+        candidates = query_range(0, n, contacts);
+        return tensor_status::SUCCESS;
+    }
+
+    /* Chunks fill their own lists, joined in order afterwards */
+    const unsigned int chunks = (n + SPATIAL_HASH_GRAIN - 1) /
+                                SPATIAL_HASH_GRAIN;
+    vector<unsigned long> tested(chunks, 0);
+    chunk_contacts.resize(chunks);
+
+    tensor_status status = pool->parallel_for(
+        0, n, SPATIAL_HASH_GRAIN,
+        [&](unsigned int begin, unsigned int end, unsigned int)
+        {
+            const unsigned int chunk = begin / SPATIAL_HASH_GRAIN;
+            chunk_contacts[chunk].clear();
+            tested[chunk] = query_range(begin, end, chunk_contacts[chunk]);
+        });
+
+    if (status != tensor_status::SUCCESS)
+    {
+        return status;
+    }
+
+    for (unsigned int c = 0; c < chunks; c++)
+    {
+        candidates += tested[c];
+        contacts.insert(contacts.end(), chunk_contacts[c].begin(),
+                        chunk_contacts[c].end());
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+/******************************************************************************
+ * Setters
+******************************************************************************/
+tensor_status spatial_hash::set_cell_size(double cell_size_new)
+{
+    if (cell_size_new < 0.0)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    cell_size = cell_size_new;
+    return tensor_status::SUCCESS;
+}
+
+/******************************************************************************
+ * UNIT TESTS
+ *****************************************************************************/
+#ifdef TESTING_SPATIAL_HASH
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+/* n spheres of radius [0.5, 1.5] scattered through a cube of the given edge */
+static void build_debris(particle_system &system, unsigned int n,
+                         double edge, unsigned int seed)
+{
+    mt19937 generator(seed);
+    uniform_real_distribution<double> position(0.0, edge);
+    uniform_real_distribution<double> radius(0.5, 1.5);
+
+    system = particle_system(n);
+    for (unsigned int i = 0; i < n; i++)
+    {
+        system.add_particle(position(generator), position(generator),
+                            position(generator));
+        system.set_radius(i, radius(generator));
+    }
+}
+
+int main(void)
+{
+#ifdef TEST_SPATIAL_HASH_CORRECTNESS
+    {
+        cout << "TEST_SPATIAL_HASH_CORRECTNESS\r\n";
+        const unsigned int n = 5000;
+        particle_system system;
+        build_debris(system, n, 100.0, 1);
+
+        /* Every pair, checked directly */
+        const double *x = system.state_component(0);
+        const double *y = system.state_component(1);
+        const double *z = system.state_component(2);
+        const double *r = system.radius_component();
+        vector<pair<unsigned int, unsigned int>> expected;
+        for (unsigned int i = 0; i < n; i++)
+        {
+            for (unsigned int j = i + 1; j < n; j++)
+            {
+                const double d_sq = pow(x[j] - x[i], 2.0) +
+                                    pow(y[j] - y[i], 2.0) +
+                                    pow(z[j] - z[i], 2.0);
+                if (d_sq < pow(r[i] + r[j], 2.0))
+                {
+                    expected.push_back(make_pair(i, j));
+                }
+            }
+        }
+
+        spatial_hash grid;
+        vector<contact> contacts;
+        grid.build(system);
+        grid.query(contacts);
+
+        vector<pair<unsigned int, unsigned int>> found;
+        for (const contact &c : contacts)
+        {
+            found.push_back(make_pair(c.a, c.b));
+        }
+        sort(found.begin(), found.end());
+
+        cout << "all pairs: " << (unsigned long)n * (n - 1) / 2
+             << ", candidates: " << grid.get_candidates()
+             << ", contacts: " << contacts.size() << " (expected "
+             << expected.size() << "), same pairs = "
+             << (found == expected) << "\r\n";
+    }
+#endif
+
+#ifdef TEST_SPATIAL_HASH_THROUGHPUT
+    {
+        cout << "TEST_SPATIAL_HASH_THROUGHPUT\r\n";
+        const unsigned int n = 200000;
+        particle_system system;
+        build_debris(system, n, 600.0, 2);
+
+        spatial_hash grid;
+        vector<contact> serial;
+        auto start = chrono::steady_clock::now();
+        grid.build(system);
+        chrono::duration<double> build_time =
+            chrono::steady_clock::now() - start;
+        start = chrono::steady_clock::now();
+        grid.query(serial);
+        chrono::duration<double> query_time =
+            chrono::steady_clock::now() - start;
+        cout << n << " particles: build " << build_time.count()
+             << " s, query " << query_time.count() << " s, "
+             << grid.get_candidates() << " candidates, " << serial.size()
+             << " contacts\r\n";
+
+        for (unsigned int threads = 2; threads <= 4; threads++)
+        {
+            thread_pool pool(threads);
+            vector<contact> parallel;
+            start = chrono::steady_clock::now();
+            grid.query(parallel, &pool);
+            chrono::duration<double> elapsed =
+                chrono::steady_clock::now() - start;
+
+            bool same = (parallel.size() == serial.size());
+            for (size_t c = 0; same && (c < serial.size()); c++)
+            {
+                same = (parallel[c].a == serial[c].a) &&
+                       (parallel[c].b == serial[c].b) &&
+                       (parallel[c].depth == serial[c].depth);
+            }
+            cout << "threads = " << threads << ": query " << elapsed.count()
+                 << " s, same contacts in the same order = " << same
+                 << "\r\n";
+        }
+    }
+#endif
+    return 0;
+}
+#endif
@@ -8,12 +8,22 @@
 */
 
 #include "tensor.h"
+#include "fixed_tensor.h"
+#include "gemm.h"
+#include "factorization.h"
+#include "quaternion.h"
+#include <charconv>
 #include <math.h>
 using namespace std;
 
 #define DIM 3
 #define QUATERNION_HEIGHT 4
 #define QUATERNION_WIDTH 1
+#define GNUPLOT_VALUE_CHARS 352 /* Fixed 6 decimals of any double */
+
+/* Largest 1-norm for which the degree 13 Pade approximant of e^a is accurate
+ * to double precision without scaling */
+#define EXPM_THETA_13 5.371920351148152
 
 /******************************************************************************
  * PUBLIC FUNCTION IMPLEMENTATIONS
@@ -25,7 +35,7 @@ tensor_status tensor::set_tensor_element(const unsigned int row,
     tensor_status status = tensor_status::SUCCESS;
     if ((row < m_height) && (col < n_width))
     {
-        content[row][col] = value;
+        (*this)(row, col) = value;
     }
     else
     {
@@ -45,7 +55,7 @@ tensor_status tensor::set_tensor_content(const vector<vector<double>> &vv)
         {
             for (unsigned int col = 0; col < n_width; col++)
             {
-                content[row][col] = vv[row][col];
+                (*this)(row, col) = vv[row][col];
             }
         }
         status = tensor_status::SUCCESS;
@@ -61,23 +71,8 @@ tensor multiply(const tensor &a, const tensor &b)
     /* Check tensor dimensions */
     if (a.n_width == b.m_height)
     {
-
-        /* Iterate through rows in tensor c */
-        for (unsigned int i = 0; i < a.m_height; i++)
-        {
-            /* Iterate through columns in tensor b */
-            for (unsigned int j = 0; j < b.n_width; j++)
-            {
-                c.content[i][j] = 0.0;
-
-                /* Iterate through elements in row of tensor a, and column
-                 * of tensor b, respectively */
-                for (unsigned int k = 0; k < b.m_height; k++)
-                {
-                    c.content[i][j] += (a.content[i][k] * b.content[k][j]);
-                }
-            }
-        }
+        gemm(a.m_height, b.n_width, a.n_width, 1.0, a.data(), a.stride(),
+             b.data(), b.stride(), 0.0, c.data(), c.stride());
     }
     return c;
 }
@@ -92,21 +87,140 @@ tensor add(const tensor &a, const tensor &b) {
         /* Iterate through rows in tensor c */
         for (unsigned int i = 0; i < a.m_height; i++)
         {
+            const double *a_row = a.data() + (size_t)i * a.stride();
+            const double *b_row = b.data() + (size_t)i * b.stride();
+            double *c_row = c.data() + (size_t)i * c.stride();
+
             /* Iterate through columns in tensor b */
             for (unsigned int j = 0; j < a.n_width; j++)
             {
-                c.content[i][j] = a.content[i][j] + b.content[i][j];
+                c_row[j] = a_row[j] + b_row[j];
             }
         }
     }
     return c;
 }
 
+tensor_status multiply(const tensor &a, const tensor &b, tensor &c)
+{
+    /* Check tensor dimensions and that c is not also an operand */
+    if ((a.n_width != b.m_height) || (c.m_height != a.m_height) ||
+        (c.n_width != b.n_width) || (c.data() == a.data()) ||
+        (c.data() == b.data()))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    gemm(a.m_height, b.n_width, a.n_width, 1.0, a.data(), a.stride(),
+         b.data(), b.stride(), 0.0, c.data(), c.stride());
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status add(const tensor &a, const tensor &b, tensor &c)
+{
+    /* Check tensor dimensions */
+    if ((a.n_width != b.n_width) || (a.m_height != b.m_height) ||
+        (c.n_width != a.n_width) || (c.m_height != a.m_height))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    for (unsigned int i = 0; i < a.m_height; i++)
+    {
+        const double *a_row = a.data() + (size_t)i * a.stride();
+        const double *b_row = b.data() + (size_t)i * b.stride();
+        double *c_row = c.data() + (size_t)i * c.stride();
+
+        for (unsigned int j = 0; j < a.n_width; j++)
+        {
+            c_row[j] = a_row[j] + b_row[j];
+        }
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+/**
+ * @brief Dot product of a contiguous row with a strided column
+ */
+static inline double dot_column(const double *row, const double *col,
+                                unsigned int col_stride, unsigned int n)
+{
+    double x = 0.0;
+
+    for (unsigned int k = 0; k < n; k++)
+    {
+        x += row[k] * col[(size_t)k * col_stride];
+    }
+
+    return x;
+}
+
+tensor_status gemv(double alpha, const tensor &a, const tensor &x,
+                   double beta, tensor &y)
+{
+    /* Check tensor dimensions and that y is not also the operand x */
+    if ((a.n_width != x.m_height) || (y.m_height != a.m_height) ||
+        (y.n_width != x.n_width) || (y.data() == x.data()))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    if (x.n_width != 1)
+    {
+        gemm(a.m_height, x.n_width, a.n_width, alpha, a.data(), a.stride(),
+             x.data(), x.stride(), beta, y.data(), y.stride());
+        return tensor_status::SUCCESS;
+    }
+
+    for (unsigned int i = 0; i < a.m_height; i++)
+    {
+        const double ax = dot_column(a.data() + (size_t)i * a.stride(),
+                                     x.data(), x.stride(), a.n_width);
+        double *y_i = y.data() + (size_t)i * y.stride();
+
+        *y_i = (alpha * ax) + ((beta == 0.0) ? 0.0 : (beta * (*y_i)));
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status multiply_add(const tensor &a, const tensor &x, const tensor &b,
+                           const tensor &u, tensor &y)
+{
+    /* Check tensor dimensions and that y is not also an operand */
+    if ((a.n_width != x.m_height) || (b.n_width != u.m_height) ||
+        (a.m_height != b.m_height) || (x.n_width != 1) ||
+        (u.n_width != 1) || (y.m_height != a.m_height) ||
+        (y.n_width != 1) || (y.data() == x.data()) ||
+        (y.data() == u.data()))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    for (unsigned int i = 0; i < a.m_height; i++)
+    {
+        const double ax = dot_column(a.data() + (size_t)i * a.stride(),
+                                     x.data(), x.stride(), a.n_width);
+        const double bu = dot_column(b.data() + (size_t)i * b.stride(),
+                                     u.data(), u.stride(), b.n_width);
+
+        y.data()[(size_t)i * y.stride()] = ax + bu;
+    }
+
+    return tensor_status::SUCCESS;
+}
+
 tensor copy(const tensor &a)
 {
     tensor b(a.m_height, a.n_width);
 
-    b.set_tensor_content(a.content);
+    for (unsigned int i = 0; i < a.m_height; i++)
+    {
+        memcpy(b.data() + (size_t)i * b.stride(),
+               a.data() + (size_t)i * a.stride(), a.n_width * sizeof(double));
+    }
 
     return b;
 }
@@ -119,7 +233,7 @@ tensor transpose(const tensor &a)
     {
         for (unsigned int j = 0; j < b.n_width; j++)
         {
-            b.content[i][j] = a.content[j][i];
+            b(i, j) = a(j, i);
         }
     }
 
@@ -128,131 +242,140 @@ tensor transpose(const tensor &a)
 
 tensor_status invert(const tensor &a, tensor &a_inv)
 {
-    tensor_status status = tensor_status::FAILURE;
-    tensor aug = augment_width(a, eye(a.m_height, a.n_width));
-
-    double pivot = 0.0;
-    unsigned int pivot_row = 0;
-    unsigned int pivot_col = 0;
-    unsigned int pivot_dia = 0;
-    double x = 0.0;
-    unsigned int target_row = 0;
+    /* Factor with partial pivoting, then solve against the identity. A
+     * singular (or non-square) a leaves a_inv as it was. */
+    lu_factorization lu(a);
 
-    // Perform Gaussian elimination down to get the upper triangular form
-    for (pivot_col = 0; pivot_col < a.n_width; pivot_col++, pivot_dia++)
+    if (lu.is_singular() || (a_inv.m_height != a.m_height) ||
+        (a_inv.n_width != a.n_width))
     {
+        return tensor_status::FAILURE;
+    }
 
-        // Find the first pivot
-        for (pivot_row = pivot_dia, pivot = aug.content[pivot_row][pivot_col];
-             (pivot_row < aug.m_height) && (pivot == 0.0);
-             pivot = aug.content[pivot_row][pivot_col], pivot_row++)
-            ;
+    return lu.inverse(a_inv);
+}
 
-        // If all elements in the column are zero, return with failure status
-        if (pivot == 0.0)
+/**
+ * @brief c = sum of x[k] * terms[k] (plus x_eye on the diagonal), over
+ * same-sized square tensors
+ */
+static void linear_combination(const tensor *const *terms, const double *x,
+                               unsigned int n_terms, double x_eye, tensor &c)
+{
+    for (unsigned int i = 0; i < c.m_height; i++)
+    {
+        for (unsigned int j = 0; j < c.n_width; j++)
         {
-            return status;
-        }
+            double sum = (i == j) ? x_eye : 0.0;
 
-        // If the pivot row is not at the top of the matrix, make it so
-        if (pivot_row != pivot_dia)
-        {
-            if (aug.swap_rows(pivot_dia, pivot_row) == tensor_status::SUCCESS)
-            {
-                pivot_row = pivot_dia;
-            }
-            else
+            for (unsigned int k = 0; k < n_terms; k++)
             {
-                return status;
+                sum += x[k] * (*terms[k])(i, j);
             }
+            c(i, j) = sum;
         }
+    }
+}
 
-        /*
-         * Find the next row with a non-zero pivot element, if the pivot row is
-         * the target row, just scale it to one
-        */
-        if (pivot_row != (a.m_height - 1))
-        {
-            for (target_row = pivot_dia; target_row < a.m_height;
-                 target_row++)
-            {
-                if ((aug.content[target_row][pivot_col] != 0.0) && (target_row > pivot_row))
-                {
-                    x = aug.content[pivot_row][pivot_col];
-                    x /= aug.content[target_row][pivot_col];
-                    break;
-                }
-            }
+tensor_status expm(const tensor &a, tensor &e_a)
+{
+    static const double pade[14] = {
+        64764752532480000.0, 32382376266240000.0, 7771770303897600.0,
+        1187353796428800.0, 129060195264000.0, 10559470521600.0,
+        670442572800.0, 33522128640.0, 1323241920.0, 40840800.0, 960960.0,
+        16380.0, 182.0, 1.0};
+    const unsigned int n = a.m_height;
+
+    /* Normalized so b0 = 1: the identity part of the solve below is then
+     * exact, and e^a of a nilpotent a (e.g. a discretized integrator) keeps
+     * an exact unit diagonal */
+    double b[14];
+    for (unsigned int k = 0; k < 14; k++)
+    {
+        b[k] = pade[k] / pade[0];
+    }
 
-            // Scale the target row
-            for (unsigned int i = 0; i < aug.n_width; i++)
-            {
-                aug.content[target_row][i] *= x;
-            }
+    if ((a.n_width != n) || (e_a.m_height != n) || (e_a.n_width != n))
+    {
+        return tensor_status::FAILURE;
+    }
 
-            // Apply the subtraction
-            for (unsigned int i = 0; i < aug.n_width; i++)
-            {
-                aug.content[target_row][i] -= aug.content[pivot_row][i];
-            }
-        }
-        else if (pivot_row == (a.m_height - 1))
+    /* Scale a by 2^-s so its 1-norm is within reach of the approximant */
+    double norm_1 = 0.0;
+    for (unsigned int j = 0; j < n; j++)
+    {
+        double column_sum = 0.0;
+        for (unsigned int i = 0; i < n; i++)
         {
-            target_row = pivot_row;
-            x = 1.0 / aug.content[target_row][pivot_col];
-
-            // Scale the target row
-            for (unsigned int i = 0; i < aug.n_width; i++)
-            {
-                aug.content[target_row][i] *= x;
-            }
+            column_sum += fabs(a(i, j));
         }
+        norm_1 = fmax(norm_1, column_sum);
     }
 
-    // By this point, the upper triangle form is achieved
-
-    // Perform Gaussian elimination back up, to get the identity matrix
-    pivot_row = a.m_height - 1;
-    pivot_col = a.n_width - 1;
-    for (int p = 0; p < ((int)a.m_height - 1); p++, pivot_row--, pivot_col--)
+    int s = 0;
+    if (norm_1 > EXPM_THETA_13)
     {
+        s = (int)ceil(log2(norm_1 / EXPM_THETA_13));
+    }
 
-        if (pivot_row > 0)
+    tensor a1 = copy(a);
+    const double scale = ldexp(1.0, -s);
+    for (unsigned int i = 0; i < n; i++)
+    {
+        for (unsigned int j = 0; j < n; j++)
         {
-            for (int q = 0, target_row = pivot_row - 1;
-                 q < (int)pivot_row; q++, target_row--)
-            {
-
-                if (aug.content[target_row][pivot_col] != 0.0)
-                {
-                    if (aug.content[target_row][pivot_col] != 0.0)
-                    {
-                        x = aug.content[target_row][pivot_col];
-
-                        // Apply the subtraction
-                        for (unsigned int i = 0; i < aug.n_width; i++)
-                        {
-                            aug.content[target_row][i] -=
-                                (x * aug.content[pivot_row][i]);
-                        }
-                    }
-                }
-            }
+            a1(i, j) *= scale;
         }
     }
 
-    // Tranfer conents of augmented section of the original matrix
-    for (unsigned int i = 0; i < a.m_height; i++)
+    tensor a2 = multiply(a1, a1);
+    tensor a4 = multiply(a2, a2);
+    tensor a6 = multiply(a4, a2);
+    tensor w(n, n);
+    tensor z(n, n);
+    tensor u(n, n);
+    tensor v(n, n);
+
+    /* u = a1 * (a6 * (b13 a6 + b11 a4 + b9 a2) + b7 a6 + b5 a4 + b3 a2 + b1)
+     * v = a6 * (b12 a6 + b10 a4 + b8 a2) + b6 a6 + b4 a4 + b2 a2 + b0 */
+    const tensor *const powers[3] = {&a6, &a4, &a2};
+    const double odd_high[3] = {b[13], b[11], b[9]};
+    const double odd_low[3] = {b[7], b[5], b[3]};
+    const double even_high[3] = {b[12], b[10], b[8]};
+    const double even_low[3] = {b[6], b[4], b[2]};
+
+    linear_combination(powers, odd_high, 3, 0.0, z);
+    multiply(a6, z, w);
+    linear_combination(powers, odd_low, 3, b[1], z);
+    add(w, z, w);
+    multiply(a1, w, u);
+
+    linear_combination(powers, even_high, 3, 0.0, z);
+    multiply(a6, z, w);
+    linear_combination(powers, even_low, 3, b[0], z);
+    add(w, z, v);
+
+    /* r = (v - u)^-1 * (v + u) */
+    const tensor *const parts[2] = {&v, &u};
+    const double minus[2] = {1.0, -1.0};
+    const double plus[2] = {1.0, 1.0};
+    linear_combination(parts, minus, 2, 0.0, w);
+    linear_combination(parts, plus, 2, 0.0, z);
+
+    lu_factorization lu(w);
+    if (lu.solve(z, e_a) != tensor_status::SUCCESS)
     {
-        for (unsigned int j = 0; j < a.n_width; j++)
-        {
-            a_inv.content[i][j] = aug.content[i][a.n_width + j];
-        }
+        return tensor_status::FAILURE;
     }
 
-    status = tensor_status::SUCCESS;
+    /* Undo the scaling: e^a = (e^(a / 2^s))^(2^s) */
+    for (int k = 0; k < s; k++)
+    {
+        multiply(e_a, e_a, w);
+        swap(e_a, w);
+    }
 
-    return status;
+    return tensor_status::SUCCESS;
 }
 
 tensor augment_width(const tensor &a, const tensor &b)
@@ -267,11 +390,11 @@ tensor augment_width(const tensor &a, const tensor &b)
             {
                 if (j < a.n_width)
                 {
-                    c.content[i][j] = a.content[i][j];
+                    c(i, j) = a(i, j);
                 }
                 else if ((j >= a.n_width) && (j < c.n_width))
                 {
-                    c.content[i][j] = b.content[i][j - a.n_width];
+                    c(i, j) = b(i, j - a.n_width);
                 }
             }
         }
@@ -292,11 +415,11 @@ tensor augment_height(const tensor &a, const tensor &b)
             {
                 if (i < a.m_height)
                 {
-                    c.content[i][j] = a.content[i][j];
+                    c(i, j) = a(i, j);
                 }
                 else if ((i >= a.m_height) && (i < c.m_height))
                 {
-                    c.content[i][j] = b.content[i - a.n_width][j];
+                    c(i, j) = b(i - a.n_width, j);
                 }
             }
         }
@@ -315,7 +438,7 @@ tensor eye(unsigned int m, unsigned int n)
         {
             if (i == j)
             {
-                a.content[i][j] = 1.0;
+                a(i, j) = 1.0;
             }
         }
     }
@@ -330,12 +453,15 @@ tensor_status tensor::swap_rows(int row_a, int row_b)
 
     if ((row_a >= 0) && (row_b >= 0) && (row_a != row_b))
     {
+        double *a_row = data() + (size_t)row_a * row_stride;
+        double *b_row = data() + (size_t)row_b * row_stride;
+
         /* Copy the row to be swapped and begin swapping each element */
         for (unsigned int j = 0; j < n_width; j++)
         {
-            temp_element = content[row_a][j];
-            content[row_a][j] = content[row_b][j];
-            content[row_b][j] = temp_element;
+            temp_element = a_row[j];
+            a_row[j] = b_row[j];
+            b_row[j] = temp_element;
         }
 
         status = tensor_status::SUCCESS;
@@ -358,7 +484,7 @@ double norm(const tensor &a)
 
     for (unsigned int i = 0; i < a.m_height; i++)
     {
-        x += (a.content[i][0] * a.content[i][0]);
+        x += (a(i, 0) * a(i, 0));
     }
 
     return sqrtf(x);
@@ -369,7 +495,7 @@ double norm(const tensor &a, const double p)
 
     for (unsigned int i = 0; i < a.m_height; i++)
     {
-        x += powf(a.content[i][0], p);
+        x += powf(a(i, 0), p);
     }
 
     return powf(x, (double)(1.0 / p));
@@ -383,10 +509,10 @@ tensor_status tensor::rotate_quaternion(double angle)
 
     if ((m_height == QUATERNION_HEIGHT) && (n_width == QUATERNION_WIDTH))
     {
-        content[0][0] = cos(angle / 2.0);
-        content[1][0] *= q_scale;
-        content[2][0] *= q_scale;
-        content[3][0] *= q_scale;
+        (*this)(0, 0) = cos(angle / 2.0);
+        (*this)(1, 0) *= q_scale;
+        (*this)(2, 0) *= q_scale;
+        (*this)(3, 0) *= q_scale;
 
         status = tensor_status::SUCCESS;
     }
@@ -394,6 +520,38 @@ tensor_status tensor::rotate_quaternion(double angle)
     return status;
 }
 
+/**
+ * @brief Write the nine DCM elements into row-major storage
+ * @param d The first element of the DCM
+ * @param stride The number of elements between rows of d
+ */
+static void fill_dcm(double psi, double theta, double phi, double *d,
+                     unsigned int stride)
+{
+    double *r0 = d;
+    double *r1 = d + stride;
+    double *r2 = d + 2 * stride;
+
+    /* Each angle's sine and cosine once, and their shared products */
+    const double s_psi = sin(psi), c_psi = cos(psi);
+    const double s_theta = sin(theta), c_theta = cos(theta);
+    const double s_phi = sin(phi), c_phi = cos(phi);
+    const double cpsi_stheta = c_psi * s_theta;
+    const double spsi_stheta = s_psi * s_theta;
+
+    r0[0] = c_psi * c_theta;
+    r0[1] = s_psi * c_theta;
+    r0[2] = -s_theta;
+
+    r1[0] = cpsi_stheta * s_phi - s_psi * c_phi;
+    r1[1] = spsi_stheta * s_phi + c_psi * c_phi;
+    r1[2] = c_theta * s_phi;
+
+    r2[0] = cpsi_stheta * c_phi + s_psi * s_phi;
+    r2[1] = spsi_stheta * c_phi - c_psi * s_phi;
+    r2[2] = c_theta * c_phi;
+}
+
 tensor_status create_dcm(double psi, double theta, double phi, tensor &dcm)
 {
     if ((dcm.m_height != DIM) || (dcm.n_width != DIM))
@@ -401,17 +559,51 @@ tensor_status create_dcm(double psi, double theta, double phi, tensor &dcm)
         return tensor_status::FAILURE;
     }
 
-    dcm.content[0][0] = cos(psi) * cos(theta);
-    dcm.content[0][1] = sin(psi) * cos(theta);
-    dcm.content[0][2] = -sin(theta);
+    fill_dcm(psi, theta, phi, dcm.data(), dcm.stride());
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status create_dcm(double psi, double theta, double phi,
+                         fixed_tensor<DIM, DIM> &dcm)
+{
+    fill_dcm(psi, theta, phi, dcm.data(), dcm.stride());
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status euler_to_quaternion(double psi, double theta, double phi,
+                                  tensor &q)
+{
+    if ((q.m_height != QUATERNION_HEIGHT) || (q.n_width != QUATERNION_WIDTH))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    q = euler_to_quaternion(psi, theta, phi).to_tensor();
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status quaternion_to_dcm(const tensor &q, tensor &dcm)
+{
+    quaternion p;
+    fixed_tensor<DIM, DIM> d;
 
-    dcm.content[1][0] = cos(psi) * sin(theta) * sin(phi) - sin(psi) * cos(phi);
-    dcm.content[1][1] = sin(psi) * sin(theta) * sin(phi) + cos(psi) * cos(phi);
-    dcm.content[1][2] = cos(theta) * sin(phi);
+    if ((dcm.m_height != DIM) || (dcm.n_width != DIM) ||
+        (p.from_tensor(q) != tensor_status::SUCCESS))
+    {
+        return tensor_status::FAILURE;
+    }
 
-    dcm.content[2][0] = cos(psi) * sin(theta) * cos(phi) + sin(psi) * sin(phi);
-    dcm.content[2][1] = sin(psi) * sin(theta) * cos(phi) - cos(psi) * sin(phi);
-    dcm.content[2][2] = cos(theta) * cos(phi);
+    quaternion_to_dcm(p, d);
+    for (unsigned int i = 0; i < DIM; i++)
+    {
+        for (unsigned int j = 0; j < DIM; j++)
+        {
+            dcm(i, j) = d(i, j);
+        }
+    }
 
     return tensor_status::SUCCESS;
 }
@@ -423,7 +615,7 @@ void tensor::print(void)
         cout << "[ ";
         for (unsigned int col = 0; col < n_width; col++)
         {
-            cout << content[row][col] << " ";
+            cout << (*this)(row, col) << " ";
         }
         cout << "]\n";
     }
@@ -433,44 +625,58 @@ void tensor::print(void)
 /******************************************************************************
  * Conversion Functions for Plotting with GNU with .dat files
  *****************************************************************************/
-tensor_status tensor_to_gnuplot_dot(tensor &a, string &d)
+/**
+ * @brief Append the n elements of a column [n x 1] or row [1 x n] tensor to
+ * a string, each to 6 decimals and followed by a space, then "\r\n"
+ */
+static tensor_status append_gnuplot_line(const tensor &a, unsigned int n,
+                                         string &s)
 {
-    d.clear();
-    if ((a.m_height != DIM) && (a.n_width != DIM))
+    const bool column = (a.m_height == n) && (a.n_width == 1);
+    const bool row = (a.m_height == 1) && (a.n_width == n);
+
+    if (!column && !row)
     {
         return tensor_status::FAILURE;
     }
-    else if ((a.m_height == DIM) && (a.n_width == 1))
-    {
-        for (uint8_t i = 0; i < DIM; i++)
-        {
-            d += to_string(a.content[i][0]);
-            d += " ";
-        }
-        d += "\r\n";
-    }
-    else if ((a.m_height == 1) && (a.n_width == DIM))
+
+    char text[GNUPLOT_VALUE_CHARS];
+    for (unsigned int i = 0; i < n; i++)
     {
-        for (uint8_t i = 0; i < DIM; i++)
+        const double value = column ? a(i, 0) : a(0, i);
+        to_chars_result end = to_chars(text, text + sizeof(text), value,
+                                       chars_format::fixed, 6);
+        if (end.ec != errc())
         {
-            d += to_string(a.content[0][i]);
-            d += " ";
+            return tensor_status::FAILURE;
         }
-        d += "\r\n";
-    }
-    else
-    {
-        return tensor_status::FAILURE;
+        s.append(text, end.ptr - text);
+        s += ' ';
     }
+    s += "\r\n";
+
     return tensor_status::SUCCESS;
 }
 
+tensor_status tensor_to_gnuplot_dot(tensor &a, string &d)
+{
+    d.clear();
+    return append_gnuplot_line(a, DIM, d);
+}
+
+tensor_status tensor_to_gnuplot_vec(tensor &a, string &v)
+{
+    v.clear();
+    return append_gnuplot_line(a, SPLOT_VEC_SIZE, v);
+}
+
 /******************************************************************************
  * UNIT TESTS
  *****************************************************************************/
 #ifdef TESTING_TENSOR
 
 #include <fstream>
+#include <time.h>
 
 int main(void)
 {
@@ -492,6 +698,31 @@ int main(void)
     }
 #endif
 
+#ifdef TEST_TENSOR_STORAGE
+    {
+        cout << "TEST_TENSOR_STORAGE\r\n";
+        tensor a(vector<vector<double>>{{1, 2, 3}, {4, 5, 6}});
+        a.print();
+
+        cout << "stride = " << a.stride() << "\r\n";
+        cout << "aligned = "
+             << (((uintptr_t)a.data() % TENSOR_ALIGNMENT) == 0) << "\r\n";
+
+        cout << "row-major walk: ";
+        for (unsigned int i = 0; i < a.m_height; i++)
+        {
+            for (unsigned int j = 0; j < a.n_width; j++)
+            {
+                cout << a.data()[i * a.stride() + j] << " ";
+            }
+        }
+        cout << "\r\n";
+
+        a(1, 2) = 60.0;
+        cout << "a(1, 2) = " << a(1, 2) << "\r\n";
+    }
+#endif
+
 #ifdef TEST_TENSOR_MULTIPLICATION
     {
         cout << "TEST_TENSOR_MULTIPLICATION\r\n";
@@ -602,6 +833,36 @@ int main(void)
         a_inv.print();
     }
 #endif
+#ifdef TEST_TENSOR_EXPM
+    {
+        cout << "TEST_TENSOR_EXPM\r\n";
+        /* e^(t J) of the rotation generator J is a rotation by t */
+        const double t = 20.0;
+        tensor a(vector<vector<double>>{{0.0, -t}, {t, 0.0}});
+        tensor e_a(2, 2);
+        expm(a, e_a);
+        e_a.print();
+        cout << "cos(t) = " << cos(t) << ", sin(t) = " << sin(t) << "\r\n";
+
+        /* A double integrator, e^(A dt) = [[1, dt], [0, 1]] */
+        tensor b(vector<vector<double>>{{0.0, 0.1}, {0.0, 0.0}});
+        tensor e_b(2, 2);
+        expm(b, e_b);
+        e_b.print();
+
+        /* Moler and Van Loan's example, e^c = V diag(e^-1, e^-17) V^-1 with
+         * V = [[1, 3], [2, 4]] */
+        tensor c(vector<vector<double>>{{-49.0, 24.0}, {-64.0, 31.0}});
+        tensor e_c(2, 2);
+        expm(c, e_c);
+        e_c.print();
+        const double e1 = exp(-1.0);
+        const double e17 = exp(-17.0);
+        cout << "expected [ " << -2.0 * e1 + 3.0 * e17 << " "
+             << 1.5 * e1 - 1.5 * e17 << " ] [ " << -4.0 * e1 + 4.0 * e17
+             << " " << 3.0 * e1 - 2.0 * e17 << " ]\r\n";
+    }
+#endif
 #ifdef TEST_TENSOR_NORM
     {
         cout << "TEST_TENSOR_NORM\r\n";
@@ -683,6 +944,135 @@ int main(void)
 
         b.print();
     }
+#endif
+#ifdef TEST_TENSOR_FIXED
+    {
+        cout << "TEST_TENSOR_FIXED\r\n";
+        fixed_tensor<2, 3> a({{1, 2, 0}, {2, 1, 0}});
+        fixed_tensor<3, 1> b({{1}, {2}, {3}});
+
+        cout << "first operand tensor:\r\n";
+        a.print();
+
+        cout << "second operand tensor:\r\n";
+        b.print();
+
+        fixed_tensor<2, 1> c = multiply(a, b);
+        c.print();
+
+        /* multiply(a, a) would not compile: inner dimensions 3 != 2 */
+        add(a, a).print();
+        transpose(a).print();
+
+        /* Round trip through the dynamic tensor */
+        tensor d = multiply(a.to_tensor(), b.to_tensor());
+        fixed_tensor<2, 1> e(d);
+        e.print();
+        cout << "from_tensor status on mismatch = "
+             << (int)e.from_tensor(a.to_tensor()) << "\r\n";
+
+        fixed_tensor<3, 3> dcm;
+        fixed_tensor<3, 1> x({{1.0}, {0.0}, {0.0}});
+        create_dcm(30.0 * M_PI / 180.0, 0.0, 0.0, dcm);
+        multiply(dcm, x).print();
+    }
+#endif
+#ifdef TEST_TENSOR_GEMM
+    {
+        cout << "TEST_TENSOR_GEMM\r\n";
+        cout << "AVX2/FMA micro-kernel: " << gemm_uses_avx2() << "\r\n";
+
+        /* Odd sizes exercise every edge tile and a partial KC panel */
+        const unsigned int m = 257, k = 301, n = 131;
+        tensor a(m, k);
+        tensor b(k, n);
+
+        for (unsigned int i = 0; i < m; i++)
+        {
+            for (unsigned int j = 0; j < k; j++)
+            {
+                a(i, j) = sin(0.1 * i + 0.37 * j);
+            }
+        }
+        for (unsigned int i = 0; i < k; i++)
+        {
+            for (unsigned int j = 0; j < n; j++)
+            {
+                b(i, j) = cos(0.23 * i - 0.05 * j);
+            }
+        }
+
+        tensor c = multiply(a, b);
+
+        double max_error = 0.0;
+        for (unsigned int i = 0; i < m; i++)
+        {
+            for (unsigned int j = 0; j < n; j++)
+            {
+                double x = 0.0;
+                for (unsigned int p = 0; p < k; p++)
+                {
+                    x += a(i, p) * b(p, j);
+                }
+                max_error = fmax(max_error, fabs(x - c(i, j)));
+            }
+        }
+        cout << "max |naive - gemm| = " << max_error << "\r\n";
+
+        /* Large square product, timed */
+        const unsigned int big = 1000;
+        tensor d(big, big);
+        tensor e(big, big);
+        for (unsigned int i = 0; i < big; i++)
+        {
+            for (unsigned int j = 0; j < big; j++)
+            {
+                d(i, j) = (double)((i * 7 + j * 3) % 11) - 5.0;
+                e(i, j) = (double)((i * 5 + j * 2) % 13) - 6.0;
+            }
+        }
+
+        clock_t start = clock();
+        tensor f = multiply(d, e);
+        double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        double x = 0.0;
+        for (unsigned int p = 0; p < big; p++)
+        {
+            x += d(123, p) * e(p, 456);
+        }
+        cout << "1000x1000: f(123, 456) = " << f(123, 456)
+             << ", expected " << x << "\r\n";
+        cout << "1000x1000: " << seconds << " s, "
+             << (2.0 * big * big * big / seconds * 1.0e-9) << " GFLOP/s\r\n";
+    }
+#endif
+#ifdef TEST_TENSOR_IN_PLACE
+    {
+        cout << "TEST_TENSOR_IN_PLACE\r\n";
+        tensor a(vector<vector<double>>{{1, 2, 0}, {2, 1, 0}});
+        tensor b(vector<vector<double>>{{1, 0}, {0, 3}});
+        tensor x(vector<vector<double>>{{1}, {2}, {3}});
+        tensor u(vector<vector<double>>{{10}, {20}});
+        tensor y(vector<vector<double>>{{100}, {200}});
+
+        /* y = 2 * a * x - y */
+        cout << "status = " << (int)gemv(2.0, a, x, -1.0, y) << "\r\n";
+        y.print();
+
+        /* y = a * x + b * u */
+        cout << "status = " << (int)multiply_add(a, x, b, u, y) << "\r\n";
+        y.print();
+
+        /* Writing over an operand is refused */
+        cout << "aliased status = " << (int)gemv(1.0, b, u, 0.0, u)
+             << "\r\n";
+
+        tensor c(2, 1);
+        multiply(a, x, c);
+        add(c, y, c);
+        c.print();
+    }
 #endif
     return 0;
 }
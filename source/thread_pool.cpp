@@ -0,0 +1,238 @@
+/**
+* @file thread_pool.cpp
+*
+* @brief A work-stealing thread pool for running index ranges in parallel
+*
+* @author Pavlo Vlastos
+*/
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "thread_pool.h"
+
+/******************************************************************************
+ * PRIVATE FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+bool thread_pool::pop(unsigned int worker, range &r)
+{
+    worker_queue &q = *queues[worker];
+    lock_guard<mutex> guard(q.lock);
+
+    if (q.ranges.empty())
+    {
+        return false;
+    }
+
+    r = q.ranges.back();
+    q.ranges.pop_back();
+    return true;
+}
+
+bool thread_pool::steal(unsigned int thief, range &r)
+{
+    const unsigned int n = size();
+
+    /* Start with the neighbour, so thieves spread over the victims */
+    for (unsigned int k = 1; k < n; k++)
+    {
+        worker_queue &q = *queues[(thief + k) % n];
+        lock_guard<mutex> guard(q.lock);
+
+        if (!q.ranges.empty())
+        {
+            r = q.ranges.front();
+            q.ranges.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void thread_pool::drain(unsigned int worker)
+{
+    range r;
+
+    while (pop(worker, r) || steal(worker, r))
+    {
+        try
+        {
+            (*r.task)(r.begin, r.end, worker);
+        }
+        catch (...)
+        {
+            task_failed = true;
+        }
+
+        if (--remaining_ranges == 0)
+        {
+            lock_guard<mutex> guard(job_lock);
+            job_done.notify_all();
+        }
+    }
+}
+
+void thread_pool::worker_loop(unsigned int worker)
+{
+    unsigned long seen_generation = 0;
+
+    while (true)
+    {
+        {
+            unique_lock<mutex> lock(job_lock);
+            job_ready.wait(lock, [&]
+                           { return stopping ||
+                                    (job_generation != seen_generation); });
+
+            if (stopping)
+            {
+                return;
+            }
+            seen_generation = job_generation;
+        }
+
+        drain(worker);
+    }
+}
+
+/******************************************************************************
+ * PUBLIC FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+thread_pool::thread_pool(unsigned int n_threads)
+    : remaining_ranges(0), task_failed(false)
+{
+    if (n_threads == 0)
+    {
+        n_threads = thread::hardware_concurrency();
+    }
+    if (n_threads == 0)
+    { /* hardware_concurrency() may not be computable */
+        n_threads = 1;
+    }
+
+    for (unsigned int i = 0; i < n_threads; i++)
+    {
+        queues.push_back(unique_ptr<worker_queue>(new worker_queue));
+    }
+
+    /* Worker 0 is whichever thread calls parallel_for() */
+    for (unsigned int i = 1; i < n_threads; i++)
+    {
+        workers.push_back(thread(&thread_pool::worker_loop, this, i));
+    }
+}
+
+thread_pool::~thread_pool(void)
+{
+    {
+        lock_guard<mutex> guard(job_lock);
+        stopping = true;
+    }
+    job_ready.notify_all();
+
+    for (unsigned int i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+    }
+}
+
+tensor_status thread_pool::parallel_for(unsigned int begin, unsigned int end,
+                                        unsigned int grain,
+                                        const range_task &task)
+{
+    if (begin > end)
+    {
+        return tensor_status::FAILURE;
+    }
+    if (begin == end)
+    {
+        return tensor_status::SUCCESS;
+    }
+    if (grain < 1)
+    {
+        grain = 1;
+    }
+
+    const unsigned int n = size();
+    const unsigned int chunks = (end - begin + grain - 1) / grain;
+
+    task_failed = false;
+    remaining_ranges = chunks;
+
+    /* Deal the chunks out in contiguous runs, one run per worker, so each
+     * worker starts on memory next to its own previous chunk */
+    for (unsigned int c = 0; c < chunks; c++)
+    {
+        range r;
+        r.begin = begin + c * grain;
+        r.end = ((end - r.begin) > grain) ? (r.begin + grain) : end;
+        r.task = &task;
+
+        worker_queue &q = *queues[(unsigned int)(((unsigned long)c * n) /
+                                                 chunks)];
+        lock_guard<mutex> guard(q.lock);
+        q.ranges.push_front(r);
+    }
+
+    {
+        lock_guard<mutex> guard(job_lock);
+        job_generation++;
+    }
+    job_ready.notify_all();
+
+    drain(0);
+
+    /* Other workers may still be finishing stolen chunks */
+    {
+        unique_lock<mutex> lock(job_lock);
+        job_done.wait(lock, [&]
+                      { return remaining_ranges == 0; });
+    }
+
+    return task_failed ? tensor_status::FAILURE : tensor_status::SUCCESS;
+}
+
+/******************************************************************************
+ * UNIT TESTS
+ *****************************************************************************/
+#ifdef TESTING_THREAD_POOL
+
+int main(void)
+{
+#ifdef TEST_THREAD_POOL_PARALLEL_FOR
+    {
+        cout << "TEST_THREAD_POOL_PARALLEL_FOR\r\n";
+
+        for (unsigned int threads = 1; threads <= 4; threads++)
+        {
+            thread_pool pool(threads);
+            vector<unsigned int> hits(10007, 0);
+
+            for (unsigned int pass = 0; pass < 3; pass++)
+            {
+                pool.parallel_for(0, hits.size(), 64,
+                                  [&](unsigned int b, unsigned int e,
+                                      unsigned int)
+                                  {
+                                      for (unsigned int i = b; i < e; i++)
+                                      {
+                                          hits[i]++;
+                                      }
+                                  });
+            }
+
+            unsigned int wrong = 0;
+            for (unsigned int i = 0; i < hits.size(); i++)
+            {
+                wrong += (hits[i] != 3);
+            }
+            cout << "threads = " << pool.size()
+                 << ", indices not visited exactly 3 times = " << wrong
+                 << "\r\n";
+        }
+    }
+#endif
+    return 0;
+}
+#endif
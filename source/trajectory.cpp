@@ -0,0 +1,550 @@
+/**
+* @file trajectory.cpp
+*
+* @brief A chunked, columnar binary format for recording particle
+* trajectories, written by large buffered writes and read back through a
+* memory map as zero-copy tensor views
+*
+* @author Pavlo Vlastos
+*/
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+#include "trajectory.h"
+#include "file_io.h"
+#include <fcntl.h>
+#include <fstream>
+#include <unistd.h>
+
+/******************************************************************************
+ * DEFINES
+ *****************************************************************************/
+#define DIM 3
+
+/******************************************************************************
+ * PRIVATE FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+/**
+ * @brief Round a row count up to a multiple of TRAJECTORY_ROW_ALIGN
+ */
+static uint64_t pad_rows(uint64_t rows)
+{
+    return (rows + TRAJECTORY_ROW_ALIGN - 1) / TRAJECTORY_ROW_ALIGN *
+           TRAJECTORY_ROW_ALIGN;
+}
+
+/**
+ * @brief The bytes of a chunk's columns, of padded_rows rows each
+ */
+static uint64_t column_bytes(uint64_t padded_rows)
+{
+    return padded_rows * ((1 + STATE_SIZE) * sizeof(double) +
+                          sizeof(uint32_t));
+}
+
+double *trajectory_writer::time_column(void)
+{
+    return reinterpret_cast<double *>(chunk.data() +
+                                      sizeof(trajectory_chunk_header));
+}
+
+double *trajectory_writer::state_column(unsigned int s)
+{
+    return time_column() + (size_t)(1 + s) * capacity;
+}
+
+uint32_t *trajectory_writer::id_column(void)
+{
+    return reinterpret_cast<uint32_t *>(state_column(STATE_SIZE));
+}
+
+tensor_status trajectory_writer::flush_chunk(void)
+{
+    if (rows == 0)
+    {
+        return tensor_status::SUCCESS;
+    }
+
+    /* A part-filled chunk is packed down to its own padded length first,
+     * its padding rows zeroed */
+    const uint64_t padded = pad_rows(rows);
+    if (rows < capacity)
+    {
+        double *columns = time_column();
+        for (unsigned int c = 1; c <= STATE_SIZE; c++)
+        {
+            memmove(columns + c * padded, columns + c * capacity,
+                    rows * sizeof(double));
+        }
+        uint32_t *ids = reinterpret_cast<uint32_t *>(
+            columns + (1 + STATE_SIZE) * padded);
+        memmove(ids, id_column(), rows * sizeof(uint32_t));
+
+        for (unsigned int c = 0; c <= STATE_SIZE; c++)
+        {
+            memset(columns + c * padded + rows, 0,
+                   (padded - rows) * sizeof(double));
+        }
+        memset(ids + rows, 0, (padded - rows) * sizeof(uint32_t));
+    }
+
+    trajectory_chunk_header header = {};
+    header.rows = rows;
+    header.padded_rows = padded;
+    memcpy(chunk.data(), &header, sizeof(header));
+
+    if (write_all(fd, chunk.data(),
+                  sizeof(header) + column_bytes(padded)) !=
+        tensor_status::SUCCESS)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    total_rows += rows;
+    chunks++;
+    rows = 0;
+
+    return tensor_status::SUCCESS;
+}
+
+/******************************************************************************
+ * PUBLIC FUNCTION IMPLEMENTATIONS
+ *****************************************************************************/
+trajectory_writer::~trajectory_writer(void)
+{
+    close();
+}
+
+tensor_status trajectory_writer::open(const char *path,
+                                      unsigned long chunk_rows)
+{
+    if ((path == nullptr) || (chunk_rows == 0) ||
+        (close() != tensor_status::SUCCESS))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    capacity = pad_rows(chunk_rows);
+    chunk.assign(sizeof(trajectory_chunk_header) + column_bytes(capacity), 0);
+    rows = 0;
+    total_rows = 0;
+    chunks = 0;
+
+    /* The row and chunk counts are left zero until close() */
+    trajectory_header header = {};
+    memcpy(header.magic, TRAJECTORY_MAGIC, sizeof(header.magic));
+    header.version = TRAJECTORY_VERSION;
+    header.state_size = STATE_SIZE;
+
+    return write_all(fd, &header, sizeof(header));
+}
+
+tensor_status trajectory_writer::close(void)
+{
+    if (fd < 0)
+    {
+        return tensor_status::SUCCESS;
+    }
+
+    tensor_status status = flush_chunk();
+
+    trajectory_header header = {};
+    memcpy(header.magic, TRAJECTORY_MAGIC, sizeof(header.magic));
+    header.version = TRAJECTORY_VERSION;
+    header.state_size = STATE_SIZE;
+    header.rows = total_rows;
+    header.chunks = chunks;
+
+    if (pwrite(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header))
+    {
+        status = tensor_status::FAILURE;
+    }
+
+    if (::close(fd) != 0)
+    {
+        status = tensor_status::FAILURE;
+    }
+
+    fd = -1;
+    chunk = byte_buffer();
+
+    return status;
+}
+
+tensor_status trajectory_writer::record(double t, uint32_t id,
+                                        const double *state)
+{
+    if ((fd < 0) || (state == nullptr))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    time_column()[rows] = t;
+    for (unsigned int s = 0; s < STATE_SIZE; s++)
+    {
+        state_column(s)[rows] = state[s];
+    }
+    id_column()[rows] = id;
+
+    if (++rows == capacity)
+    {
+        return flush_chunk();
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status trajectory_writer::record(double t, uint32_t id,
+                                        const particle &p)
+{
+    tensor state = p.get_state();
+    return record(t, id, state.data());
+}
+
+tensor_status trajectory_writer::record(double t,
+                                        const double *const *columns,
+                                        unsigned int n)
+{
+    if ((fd < 0) || (columns == nullptr))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    /* Copy runs of the columns, as long as the chunk has room */
+    for (unsigned int i = 0; i < n;)
+    {
+        const unsigned int run = (unsigned int)min<unsigned long>(
+            n - i, capacity - rows);
+
+        double *times = time_column() + rows;
+        uint32_t *ids = id_column() + rows;
+        for (unsigned int k = 0; k < run; k++)
+        {
+            times[k] = t;
+            ids[k] = i + k;
+        }
+
+        for (unsigned int s = 0; s < STATE_SIZE; s++)
+        {
+            memcpy(state_column(s) + rows, columns[s] + i,
+                   run * sizeof(double));
+        }
+
+        rows += run;
+        i += run;
+
+        if ((rows == capacity) && (flush_chunk() != tensor_status::SUCCESS))
+        {
+            return tensor_status::FAILURE;
+        }
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+tensor_status trajectory_writer::record(double t,
+                                        const particle_system &system)
+{
+    /* The system's state arrays are columns already */
+    const double *columns[STATE_SIZE];
+    for (unsigned int s = 0; s < STATE_SIZE; s++)
+    {
+        columns[s] = system.state_component(s);
+    }
+
+    return record(t, columns, system.size());
+}
+
+tensor_status trajectory_reader::open(const char *path)
+{
+    close();
+
+    if (map_file(path, sizeof(trajectory_header), mapping, mapped_size) !=
+        tensor_status::SUCCESS)
+    {
+        return tensor_status::FAILURE;
+    }
+
+    void *address = mapping.get();
+    const size_t size = mapped_size;
+
+    trajectory_header header;
+    memcpy(&header, address, sizeof(header));
+    if ((memcmp(header.magic, TRAJECTORY_MAGIC, sizeof(header.magic)) != 0) ||
+        (header.version != TRAJECTORY_VERSION) ||
+        (header.state_size != STATE_SIZE))
+    {
+        close();
+        return tensor_status::FAILURE;
+    }
+
+    /* Walk the chunks rather than trust the header's counts, which are
+     * zero in a file that was never closed */
+    uint8_t *bytes = static_cast<uint8_t *>(address);
+    size_t offset = sizeof(trajectory_header);
+
+    while (offset + sizeof(trajectory_chunk_header) <= size)
+    {
+        trajectory_chunk_header chunk_header;
+        memcpy(&chunk_header, bytes + offset, sizeof(chunk_header));
+
+        const uint64_t padded = chunk_header.padded_rows;
+        if ((chunk_header.rows == 0) || (padded < chunk_header.rows) ||
+            (padded % TRAJECTORY_ROW_ALIGN != 0) ||
+            (column_bytes(padded) >
+             size - offset - sizeof(trajectory_chunk_header)))
+        {
+            break; /* A chunk cut short */
+        }
+
+        chunk_info c;
+        c.columns = bytes + offset + sizeof(trajectory_chunk_header);
+        c.rows = chunk_header.rows;
+        c.padded_rows = padded;
+        chunks.push_back(c);
+        total_rows += c.rows;
+
+        offset += sizeof(trajectory_chunk_header) + column_bytes(padded);
+    }
+
+    return tensor_status::SUCCESS;
+}
+
+void trajectory_reader::close(void)
+{
+    mapping.reset();
+    mapped_size = 0;
+    chunks.clear();
+    total_rows = 0;
+}
+
+tensor trajectory_reader::time(unsigned int c) const
+{
+    return tensor::view(reinterpret_cast<double *>(chunks[c].columns),
+                        chunks[c].rows, 1, 1, mapping);
+}
+
+tensor trajectory_reader::states(unsigned int c) const
+{
+    double *columns = reinterpret_cast<double *>(chunks[c].columns);
+
+    return tensor::view(columns + chunks[c].padded_rows, STATE_SIZE,
+                        chunks[c].rows, chunks[c].padded_rows, mapping);
+}
+
+const uint32_t *trajectory_reader::ids(unsigned int c) const
+{
+    const double *columns = reinterpret_cast<double *>(chunks[c].columns);
+
+    return reinterpret_cast<const uint32_t *>(
+        columns + (1 + STATE_SIZE) * chunks[c].padded_rows);
+}
+
+tensor_status trajectory_to_gnuplot(const char *binary_path,
+                                    const char *dat_path,
+                                    unsigned int precision)
+{
+    trajectory_reader reader;
+    dat_emitter dat;
+
+    if ((reader.open(binary_path) != tensor_status::SUCCESS) ||
+        (dat.set_precision(precision) != tensor_status::SUCCESS) ||
+        (dat.open(dat_path) != tensor_status::SUCCESS))
+    {
+        return tensor_status::FAILURE;
+    }
+
+    for (unsigned int c = 0; c < reader.get_chunks(); c++)
+    {
+        /* The first three state rows are the x, y and z columns */
+        tensor states = reader.states(c);
+        if (dat.emit_dots(&states(0, 0), &states(1, 0), &states(2, 0),
+                          states.n_width) != tensor_status::SUCCESS)
+        {
+            return tensor_status::FAILURE;
+        }
+    }
+
+    return dat.close();
+}
+
+/******************************************************************************
+ * UNIT TESTS
+ *****************************************************************************/
+#ifdef TESTING_TRAJECTORY
+
+#include <time.h>
+
+/* A system of n particles in a slow spin about the z-axis */
+static void build_cloud(particle_system &system, unsigned int n)
+{
+    system = particle_system(n);
+    for (unsigned int i = 0; i < n; i++)
+    {
+        system.add_particle((double)i, 0.5 * i, 0.0);
+        system.set_u(i, 1.0, -2.0, 0.5, 0.0, 0.0, 0.01 * (i % 5));
+    }
+}
+
+int main(void)
+{
+#ifdef TEST_TRAJECTORY_ROUNDTRIP
+    {
+        cout << "TEST_TRAJECTORY_ROUNDTRIP\r\n";
+        const unsigned int n = 1000;
+        const unsigned int steps = 250;
+        const char *path = "../../simulation/trajectory.bin";
+        particle_system system;
+        build_cloud(system, n);
+
+        /* Small chunks, so runs split across them and the last is partial */
+        trajectory_writer writer;
+        if (writer.open(path, 3000) != tensor_status::SUCCESS)
+        {
+            cout << "Unable to open file\r\n";
+            return 1;
+        }
+        vector<double> expected; /* x of particle 7 after each step */
+        for (unsigned int k = 0; k < steps; k++)
+        {
+            system.update();
+            writer.record(k * system.get_sample_time(), system);
+            expected.push_back(system.state_component(0)[7]);
+        }
+        writer.close();
+
+        trajectory_reader reader;
+        reader.open(path);
+        uint64_t row = 0;
+        unsigned int mismatches = 0;
+        bool aligned = true;
+        for (unsigned int c = 0; c < reader.get_chunks(); c++)
+        {
+            tensor t = reader.time(c);
+            tensor x = reader.states(c);
+            const uint32_t *id = reader.ids(c);
+            aligned = aligned && t.is_view() && x.is_view() &&
+                      ((uintptr_t)x.data() % TENSOR_ALIGNMENT == 0);
+
+            for (unsigned int r = 0; r < x.n_width; r++, row++)
+            {
+                const unsigned int k = row / n;
+                const unsigned int i = row % n;
+                mismatches += (id[r] != i) ||
+                              (t(r, 0) != k * system.get_sample_time()) ||
+                              ((i == 7) && (x(0, r) != expected[k]));
+            }
+        }
+
+        /* The last row is the system's final state */
+        tensor last = reader.states(reader.get_chunks() - 1);
+        tensor final_state(STATE_SIZE);
+        system.get_state(n - 1, final_state);
+        double max_error = 0.0;
+        for (unsigned int s = 0; s < STATE_SIZE; s++)
+        {
+            max_error = fmax(max_error, fabs(last(s, last.n_width - 1) -
+                                             final_state(s, 0)));
+        }
+
+        /* Copying a view gives an ordinary tensor that outlives the reader */
+        tensor copied = reader.time(0);
+        tensor owned = copied;
+        reader.close();
+        cout << "rows = " << row << " (expected " << n * steps << "), chunks = "
+             << reader.get_chunks() << " after close, mismatches = "
+             << mismatches << ", max |last row - state| = " << max_error
+             << "\r\n";
+        cout << "views aligned = " << aligned << ", view copy is a view = "
+             << owned.is_view() << ", view outlives reader = "
+             << (copied(1, 0) == 0.0) << "\r\n";
+
+        trajectory_to_gnuplot(path, "../../simulation/trajectory.dat");
+        ifstream dat("../../simulation/trajectory.dat");
+        string line;
+        getline(dat, line);
+        cout << "first .dat line: " << line << "\r\n";
+    }
+#endif
+
+#ifdef TEST_TRAJECTORY_THROUGHPUT
+    {
+        cout << "TEST_TRAJECTORY_THROUGHPUT\r\n";
+        const unsigned int n = 10000;
+        const unsigned int steps = 100;
+        const char *path = "../../simulation/trajectory.bin";
+        particle_system system;
+        build_cloud(system, n);
+
+        trajectory_writer writer;
+        if (writer.open(path) != tensor_status::SUCCESS)
+        {
+            cout << "Unable to open file\r\n";
+            return 1;
+        }
+        double step_seconds = 0.0;
+        double record_seconds = 0.0;
+        for (unsigned int k = 0; k < steps; k++)
+        {
+            clock_t start = clock();
+            system.update();
+            step_seconds += (double)(clock() - start) / CLOCKS_PER_SEC;
+
+            start = clock();
+            writer.record(k * system.get_sample_time(), system);
+            record_seconds += (double)(clock() - start) / CLOCKS_PER_SEC;
+        }
+        clock_t start = clock();
+        writer.close();
+        record_seconds += (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        /* The same positions formatted as text, the only output before */
+        start = clock();
+        tensor position(DIM);
+        string dot;
+        size_t text_bytes = 0;
+        for (unsigned int i = 0; i < n; i++)
+        {
+            for (unsigned int a = 0; a < DIM; a++)
+            {
+                position(a, 0) = system.state_component(a)[i];
+            }
+            tensor_to_gnuplot_dot(position, dot);
+            text_bytes += dot.size();
+        }
+        double text_seconds = (double)(clock() - start) / CLOCKS_PER_SEC *
+                              steps;
+
+        start = clock();
+        trajectory_reader reader;
+        reader.open(path);
+        double sum = 0.0;
+        for (unsigned int c = 0; c < reader.get_chunks(); c++)
+        {
+            tensor x = reader.states(c);
+            for (unsigned int r = 0; r < x.n_width; r++)
+            {
+                sum += x(0, r);
+            }
+        }
+        double read_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        cout << n << " particles x " << steps << " steps: stepping "
+             << step_seconds << " s, binary recording " << record_seconds
+             << " s, text formatting (positions only, estimated) "
+             << text_seconds << " s\r\n";
+        cout << reader.get_rows() << " rows read back in " << read_seconds
+             << " s (sum of x = " << sum << "), text would be about "
+             << text_bytes * steps / 1000000 << " MB\r\n";
+    }
+#endif
+    return 0;
+}
+#endif